@@ -0,0 +1,150 @@
+/**
+ * jsonata-cpp is the JSONata C++ reference port
+ *
+ * Copyright Dashjoin GmbH. https://dashjoin.com
+ * Copyright Robert Yokota
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "jsonata/Parser.h"
+
+namespace jsonata {
+
+// Forward declarations
+class Frame;
+class Jsonata;
+
+namespace vm {
+
+/**
+ * Instructions of the stack machine. Operands live in Instruction::a/b and
+ * index into the Program tables; jump offsets are relative to the next
+ * instruction. Path steps and filters run as loops: a loop instruction
+ * starts iterating a sequence, Next makes its next item the context item
+ * (or leaves the loop), and Loop jumps back to that Next.
+ */
+enum class Op : uint8_t {
+    PushConst,      // push constants[a]
+    PushUndefined,  // push undefined
+    LoadContext,    // push the context item ($)
+    LoadVariable,   // push the binding of Frame::Slot a
+    LoadFree,       // push the free variable Frame::Slot a of parse b
+    LoadField,      // push field names[a] of the context item
+    Pop,            // discard the top of stack
+    Binary,         // pop rhs, lhs; push nodes[a] applied to them
+    Negate,         // pop operand; push its negation (nodes[a] for errors)
+    And,            // pop; if false push false and skip a instructions
+    Or,             // pop; if true push true and skip a instructions
+    ToBoolean,      // pop; push its boolean value
+    JumpIfFalse,    // pop; skip a instructions if false
+    JumpIfEmpty,    // skip a instructions if the top is undefined or []
+    Jump,           // skip a instructions
+    Loop,           // go back a instructions
+    EnterScope,     // evaluate in a child frame until ExitScope
+    ExitScope,      // return to the enclosing frame
+    Bind,           // bind Frame::Slot a to the top of stack (which stays)
+    CheckFunction,  // throw T1006 if the top of stack is undefined
+    Call,           // pop b arguments and a procedure; call nodes[a]
+    Lambda,         // push a closure of nodes[a] whose body starts at b
+    FieldPath,      // walk the name-only path nodes[a] from the context
+    PathInput,      // push the context item as the input sequence of a path
+    EnterContext,   // pop; make it the context item until ExitContext
+    ExitContext,    // restore the context item
+    StepBegin,      // loop over the input of a path's steps (a: source,
+                    // b: stop at the first match), collecting results
+    Spread,         // pop; loop over the items a step hands on to the next
+    Next,           // next item of the innermost loop; skip a when done
+    Collect,        // pop; add to the results of the loop a levels out
+    EndLoop,        // leave the innermost loop
+    StepEnd,        // leave a StepBegin loop; push its flattened results
+    FilterIndex,    // pop; push the items the number predicate nodes[a]
+                    // picks
+    FilterBegin,    // pop; loop over its items, scanning up to the stop
+                    // in constants[a] (undefined when unbounded)
+    FilterTest,     // pop the predicate result; keep the current item
+    FilterEnd,      // leave a FilterBegin loop; push the kept items
+    KeepSingleton,  // mark the top as an array that stays one ([])
+    Finish,         // unwrap singleton/empty sequences as every node does,
+                    // keeping singletons when a is set (keepArray)
+    Evaluate,       // push the tree walker's result for nodes[a]
+    Return          // pop and return the top of stack
+};
+
+struct Instruction {
+    Op op;
+    uint32_t a = 0;
+    uint32_t b = 0;
+};
+
+/**
+ * Bytecode for one expression.
+ */
+struct Program {
+    std::vector<Instruction> code;
+    std::vector<std::any> constants;
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<Parser::Symbol>> nodes;
+    uint32_t entry = 0;
+};
+
+/**
+ * Lowers a processed AST into a Program. Node kinds without a dedicated
+ * instruction sequence (object and array constructors, sorts, tuple steps,
+ * group-by, transforms, and nodes the optimizer rewrote into invariants or
+ * hash joins) compile to Op::Evaluate, so every expression compiles.
+ * Lambda bodies get entry points of their own; the closures carry them, so
+ * they run as bytecode wherever they are called from.
+ */
+std::shared_ptr<const Program> compile(
+    const std::shared_ptr<Parser::Symbol>& ast);
+
+// Runs program from code[entry] on the instance's helpers; same result as
+// the tree walker
+std::any execute(const std::shared_ptr<const Program>& program,
+                 uint32_t entry, Jsonata& instance, const std::any& input,
+                 std::shared_ptr<Frame> environment);
+
+}  // namespace vm
+
+/**
+ * An expression lowered to bytecode by Jsonata::compile(). Shares the
+ * environment (and so any registered functions or assigned bindings) of
+ * the Jsonata instance it was compiled from.
+ */
+class CompiledExpression {
+  public:
+    CompiledExpression(std::shared_ptr<Jsonata> instance,
+                       std::shared_ptr<const vm::Program> program);
+
+    nlohmann::ordered_json run(const nlohmann::ordered_json& input,
+                               std::shared_ptr<Frame> bindings = nullptr);
+    nlohmann::json run(const nlohmann::json& input,
+                       std::shared_ptr<Frame> bindings = nullptr);
+
+    const vm::Program& getProgram() const { return *program_; }
+
+  private:
+    std::shared_ptr<Jsonata> instance_;
+    std::shared_ptr<const vm::Program> program_;
+};
+
+}  // namespace jsonata
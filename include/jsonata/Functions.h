@@ -35,6 +35,7 @@ namespace jsonata {
 class Parser;
 class Jsonata;
 class Frame;
+struct EvalContext;
 
 /**
  * Built-in function library for JSONata expressions.
@@ -83,7 +84,8 @@ class Functions {
     // Type checking functions moved to Utils
 
     // Function application infrastructure
-    static std::any funcApply(const std::any& func, const Utils::JList& args);
+    static std::any funcApply(const std::any& func, const Utils::JList& args,
+                              const EvalContext& context);
     static Utils::JList hofFuncArgs(const std::any& func, const std::any& arg1,
                                     const std::any& arg2, const std::any& arg3);
     static int64_t getFunctionArity(const std::any& func);
@@ -91,21 +93,26 @@ class Functions {
     static std::optional<bool> not_(const std::any& arg);
 
     // Higher-order functions
-    static std::any map(const Utils::JList& args);
-    static std::any filter(const Utils::JList& args);
-    static std::any foldLeft(const Utils::JList& args);
-    static std::any single(const Utils::JList& args);
+    static std::any map(const Utils::JList& args, const EvalContext& context);
+    static std::any filter(const Utils::JList& args,
+                           const EvalContext& context);
+    static std::any foldLeft(const Utils::JList& args,
+                             const EvalContext& context);
+    static std::any single(const Utils::JList& args,
+                           const EvalContext& context);
 
     // Advanced object/array functions
     static std::any merge(const Utils::JList& args);
     static std::any append(const Utils::JList& args);
+    // target = append(target, value), extending target's items in place
+    // instead of copying them
+    static void appendTo(std::any& target, const std::any& value);
     static std::any spread(const Utils::JList& args);
-    static std::any sift(const Utils::JList& args);
+    static std::any sift(const Utils::JList& args, const EvalContext& context);
 
     // Context-aware sort function for lambda comparator support
     static std::any sortWithContext(const Utils::JList& args,
-                                    const std::any& input,
-                                    std::shared_ptr<Frame> environment);
+                                    const EvalContext& context);
 
     // Helper function for default comparison logic
     static bool defaultComparator(const std::any& a, const std::any& b);
@@ -122,12 +129,14 @@ class Functions {
     static std::optional<std::string> replace(const std::string& str,
                                               const std::any& pattern,
                                               const std::any& replacement,
-                                              int64_t limit = -1);
+                                              int64_t limit,
+                                              const EvalContext& context);
     static std::optional<double> number(const std::any& arg);
     static std::any zip(const Utils::JList& args);
     static Utils::JList keys(const std::any& arg);
     static bool exists(const std::any& arg);
-    static std::any each(const std::any& obj, const std::any& func);
+    static std::any each(const std::any& obj, const std::any& func,
+                         const EvalContext& context);
     static double random();
     static std::optional<std::string> pad(const std::string& str, int64_t width,
                                           const std::string& char_ = " ");
@@ -167,7 +176,8 @@ class Functions {
 
     // Advanced functions
     static std::any functionEval(const std::string& expr,
-                                 const std::any& focus);
+                                 const std::any& focus,
+                                 const EvalContext& context);
     static std::string now(const std::string& picture = "",
                            const std::string& timezone = "UTC");
     static int64_t millis();
@@ -186,22 +196,36 @@ class Functions {
 
     // Function registry and application
     using FunctionImpl = std::function<std::any(const Utils::JList&)>;
+    // Functions that call back into the evaluator (HOFs, $eval, $sort)
+    using ContextFunctionImpl =
+        std::function<std::any(const Utils::JList&, const EvalContext&)>;
 
     struct FunctionEntry {
         FunctionImpl implementation;
+        ContextFunctionImpl contextImplementation;
         std::string signature;
 
         FunctionEntry(FunctionImpl impl, const std::string& sig)
             : implementation(impl), signature(sig) {}
+        FunctionEntry(ContextFunctionImpl impl, const std::string& sig)
+            : contextImplementation(impl), signature(sig) {}
+
+        std::any call(const Utils::JList& args,
+                      const EvalContext& context) const {
+            return contextImplementation ? contextImplementation(args, context)
+                                         : implementation(args);
+        }
     };
 
     static nlohmann::ordered_map<std::string, FunctionEntry>
     getFunctionRegistry();
     static std::any applyFunction(const std::string& name,
-                                  const Utils::JList& args);
+                                  const Utils::JList& args,
+                                  const EvalContext& context);
     // Backward compatibility overload for std::vector<std::any>
     static std::any applyFunction(const std::string& name,
-                                  const std::vector<std::any>& args);
+                                  const std::vector<std::any>& args,
+                                  const EvalContext& context);
 
   private:
     // Internal helper functions
@@ -232,7 +256,8 @@ class Functions {
                                         const std::string& replacement);
     static std::string safeReplaceAllFn(const std::string& str,
                                         const std::regex& pattern,
-                                        const std::any& func);
+                                        const std::any& func,
+                                        const EvalContext& context);
     static nlohmann::ordered_map<std::string, std::any> toJsonataMatch(
         const std::smatch& match);
     static std::string encodeURI(const std::string& uri);
@@ -29,11 +29,14 @@
 #include <chrono>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "jsonata/Compiler.h"
 #include "jsonata/Parser.h"
 
 // Forward declarations
@@ -51,25 +54,120 @@ namespace jsonata {
 
 // Forward declaration for callback types
 class Frame;
+class Jsonata;
+struct Tuple;
 using EntryCallback = std::function<void(
     std::shared_ptr<Parser::Symbol>, const std::any&, std::shared_ptr<Frame>)>;
 using ExitCallback =
     std::function<void(std::shared_ptr<Parser::Symbol>, const std::any&,
                        std::shared_ptr<Frame>, const std::any&)>;
+// Runs the tasks of a parallel order-by sort, for example on the host's
+// thread pool, and returns once all of them have finished. The tasks only
+// compare precomputed keys and catch their own exceptions
+using SortExecutor =
+    std::function<void(const std::vector<std::function<void()>>&)>;
+
+/**
+ * Receives a call before and after every node the evaluator visits.
+ * Installed on a Frame (see Frame::addObserver) and seen by the frames
+ * created beneath it, which look it up through their parent chain, so
+ * evaluation without observers costs a short pointer walk per node.
+ */
+class EvaluationObserver {
+  public:
+    virtual ~EvaluationObserver() = default;
+    virtual void onEvaluateEntry(const std::shared_ptr<Parser::Symbol>& expr,
+                                 const std::any& input,
+                                 const std::shared_ptr<Frame>& environment) = 0;
+    virtual void onEvaluateExit(const std::shared_ptr<Parser::Symbol>& expr,
+                                const std::any& input,
+                                const std::shared_ptr<Frame>& environment,
+                                const std::any& result) = 0;
+};
+
+// Allocates from an EvaluationArena and keeps it alive (for allocate_shared)
+template <class T>
+class ArenaAllocator {
+  public:
+    using value_type = T;
+
+    explicit ArenaAllocator(std::shared_ptr<EvaluationArena> arena)
+        : arena_(std::move(arena)) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        arena_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+    const std::shared_ptr<EvaluationArena>& arena() const { return arena_; }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena_ == other.arena();
+    }
+    template <class U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena_ != other.arena();
+    }
+
+  private:
+    std::shared_ptr<EvaluationArena> arena_;
+};
 
 /**
  * Frame class for variable bindings and scope management
  */
 class Frame {
+  public:
+    // A binding name interned to a process-wide integer id; Parser resolves
+    // every $variable to its slot so lookups compare integers only
+    using Slot = uint32_t;
+    static constexpr Slot kNoSlot = UINT32_MAX;
+    // Keyed by the node itself, which keeps ASTs parsed during the
+    // evaluation ($eval) alive so their addresses are not reused
+    using InvariantValues =
+        std::unordered_map<std::shared_ptr<Parser::Symbol>, std::any>;
+
   private:
+    // Declared first so it outlives the binding storage allocated from it
+    std::shared_ptr<EvaluationArena> arena_;
     std::shared_ptr<Frame> parent_;
-    nlohmann::ordered_map<std::string, std::any> bindings_;
-    std::chrono::time_point<std::chrono::steady_clock> timestamp_;
+    // Bindings in insertion order; frames with many bindings (the static
+    // builtin frame) also keep a slot -> position index, sized by the
+    // frame's own bindings rather than by the interned slot ids
+    std::pmr::vector<std::pair<Slot, std::any>> slots_;
+    std::pmr::unordered_map<Slot, size_t> index_;
+    // Bindings made by name (bind(const std::string&, ...)) for names no
+    // parsed expression uses, so that host-chosen names do not grow the
+    // process-wide slot table; found by name once an expression uses them
+    std::vector<std::pair<std::string, std::any>> named_;
+    // Slots interned before the first of those bindings was made cannot
+    // name one of them
+    Slot namedFrom_ = 0;
     int64_t timeout_;
     int64_t recursionDepth_;
-    EntryCallback entryCallback_;
-    ExitCallback exitCallback_;
+    // The observer(s) installed on this frame with addObserver(); frames
+    // without one see their nearest ancestor's, resolved on each access
+    EvaluationObserver* observer_ = nullptr;
+    std::vector<EvaluationObserver*> observers_;
+    std::unique_ptr<EvaluationObserver> observerChain_;
+    std::unique_ptr<EvaluationObserver> callbacks_;
     std::unique_ptr<class Timebox> timebox_;
+    // Frame whose observers this one also sees when neither it nor its
+    // ancestors install any; see observeFrom()
+    std::shared_ptr<const Frame> observerSource_;
+    // Root frame of the evaluation this frame belongs to, inherited from the
+    // parent (see makeRoot()). It holds the values of invariant
+    // subexpressions (Parser::Symbol::invariant), and variables the
+    // evaluated expression never binds are looked up from it
+    Frame* root_ = nullptr;
+    uint32_t scope_ = 0;
+    std::unique_ptr<InvariantValues> invariants_;
+    // Bindings read in place; see borrowTuple()
+    const Tuple* tuple_ = nullptr;
 
   public:
     bool isParallelCall = false;
@@ -78,10 +176,28 @@ class Frame {
     // Constructors
     Frame();
     Frame(std::shared_ptr<Frame> parent);
+    // A frame allocated from arena; its descendants share the arena
+    Frame(std::shared_ptr<Frame> parent,
+          std::shared_ptr<EvaluationArena> arena);
+    ~Frame();
 
     // Variable binding and lookup
     void bind(const std::string& name, const std::any& value);
     std::any lookup(const std::string& name) const;
+    void bind(Slot slot, const std::any& value);
+    std::any lookup(Slot slot) const;
+    // Lookup of a variable the expression parsed as scope never binds
+    // (Parser::Symbol::freeVariable). Only the evaluation's root and the
+    // frames above it can bind such a name, so the search starts there when
+    // this frame evaluates that expression; otherwise it is lookup(slot)
+    std::any lookupFree(Slot slot, uint32_t scope) const;
+
+    // Slot interning; slotOf() registers unknown names, findSlot() does not.
+    // The parser interns the names an expression uses; bind() by name does
+    // not register new ones
+    static Slot slotOf(const std::string& name);
+    static Slot findSlot(const std::string& name);
+    static const std::string& nameOf(Slot slot);
 
     // Runtime bounds
     void setRuntimeBounds(int64_t timeout, int64_t maxRecursionDepth);
@@ -90,13 +206,89 @@ class Frame {
     void setEvaluateEntryCallback(EntryCallback callback);
     void setEvaluateExitCallback(ExitCallback callback);
 
+    // Evaluation observers; the observer is not owned by the frame
+    void addObserver(EvaluationObserver* observer);
+    void removeObserver(EvaluationObserver* observer);
+    // The observer of this frame or of its nearest ancestor that has one
+    EvaluationObserver* getObserver() const;
+    // Makes the frame see source's observers (e.g. those of the bindings
+    // passed to Jsonata::evaluate) when it has none of its own
+    void observeFrom(std::shared_ptr<const Frame> source);
+
+    // Makes this frame the root of an evaluation of the expression parsed
+    // as scope (Parser::Symbol::scope): it holds the invariant values of the
+    // evaluations beneath it, and the expression's free variables are
+    // looked up from it
+    void makeRoot(uint32_t scope) {
+        root_ = this;
+        scope_ = scope;
+    }
+    // nullptr outside an evaluation started by Jsonata::evaluate
+    InvariantValues* getInvariants();
+
+    // Makes the frame read the bindings of tuple (a tuple stream item) in
+    // place, in addition to its own, which are cleared. The tuple must
+    // outlive the frame, or the frame must adopt its bindings first
+    void borrowTuple(const Tuple* tuple);
+    // Copies the borrowed tuple's bindings into the frame
+    void adoptTuple();
+
     // Parent access
     std::shared_ptr<Frame> getParent() const { return parent_; }
+    // The frame binding slot, searching up from this one (nullptr if none)
+    const Frame* bindingFrame(Slot slot) const;
 
     // Bindings access
-    const nlohmann::ordered_map<std::string, std::any>& getBindings() const {
-        return bindings_;
+    nlohmann::ordered_map<std::string, std::any> getBindings() const;
+    const std::pmr::vector<std::pair<Slot, std::any>>& getSlots() const {
+        return slots_;
     }
+    // Copies the bindings made in other itself into this frame
+    void bindAll(const Frame& other);
+    const std::shared_ptr<EvaluationArena>& getArena() const { return arena_; }
+
+  private:
+    static constexpr size_t kNoPosition = SIZE_MAX;
+
+    const std::any* find(Slot slot) const;
+    const std::any* findNamed(const std::string& name) const;
+    const std::any* findLocal(Slot slot) const;
+    std::any* findLocal(Slot slot);
+    // Index of slot's binding in slots_, or kNoPosition
+    size_t position(Slot slot) const;
+    void updateObserver();
+};
+
+/**
+ * An item of a tuple stream, the sequence a path evaluates through when its
+ * steps bind focus (@$v), index (#$i) or ancestor (%) variables: the step's
+ * context item (@) and the variables bound for it, by Frame::Slot. Values
+ * are shared, so a tuple derived from another for each of a step's results
+ * copies pointers rather than the values themselves.
+ */
+struct Tuple {
+    using Value = std::shared_ptr<std::any>;
+
+    Value context;
+    std::vector<std::pair<Frame::Slot, Value>> bindings;
+
+    const std::any* find(Frame::Slot slot) const;
+    // Replaces the slot's value, or adds it
+    void bind(Frame::Slot slot, Value value);
+};
+
+/**
+ * The evaluation state a function call runs in: the evaluating instance and
+ * the input and environment at the call site. Built on the caller's stack
+ * and passed by reference, so nothing is copied per call.
+ */
+struct EvalContext {
+    Jsonata& instance;
+    const std::any& input;
+    const std::shared_ptr<Frame>& environment;
+    // Leading items of the result the call's predicate can select; 0 when it
+    // may read all of them. $sort only orders that many items
+    size_t limit = 0;
 };
 
 /**
@@ -104,15 +296,13 @@ class Frame {
  */
 class JFunction {
   public:
-    std::function<std::any(const Utils::JList&, const std::any&,
-                           std::shared_ptr<Frame>)>
+    std::function<std::any(const Utils::JList&, const EvalContext&)>
         implementation;
     std::shared_ptr<utils::Signature> signature;
 
     JFunction() = default;
-    JFunction(std::function<std::any(const Utils::JList&, const std::any&,
-                                     std::shared_ptr<Frame>)>
-                  impl)
+    JFunction(
+        std::function<std::any(const Utils::JList&, const EvalContext&)> impl)
         : implementation(impl) {}
 
     virtual ~JFunction() = default;
@@ -126,6 +316,9 @@ class Jsonata {
     // Constructors
     Jsonata();
     Jsonata(const std::string& jsonataExpression);
+    // optimize selects the constant-folding pass (see Optimizer.h), which
+    // the single-argument constructor runs
+    Jsonata(const std::string& jsonataExpression, bool optimize);
     Jsonata(const Jsonata& other);  // Copy constructor for per-thread instances
 
     // Main evaluation methods (ordered JSON variants)
@@ -161,6 +354,9 @@ class Jsonata {
     // Parse expression
     std::shared_ptr<Parser::Symbol> parse(const std::string& expression);
 
+    // Lower the parsed expression to bytecode for repeated evaluation
+    CompiledExpression compile() const;
+
     // Debug helper
     std::shared_ptr<Parser::Symbol> getExpression() const {
         return expression_;
@@ -194,18 +390,10 @@ class Jsonata {
 
     std::shared_ptr<Frame> environment_;
     static thread_local std::shared_ptr<class Parser> currentParser_;
-    static thread_local std::any tls_input_;
-    static thread_local std::shared_ptr<Frame> tls_environment_;
     static Jsonata* getCurrentInstance();
     static std::shared_ptr<class Parser> getCurrentParser();
     Jsonata* getPerThreadInstance();
 
-    // Public accessors for thread-local context (used by Functions)
-    const std::any& getCurrentInput() const { return tls_input_; }
-    std::shared_ptr<Frame> getCurrentEnvironment() const {
-        return tls_environment_;
-    }
-
     // Missing public API methods from Java
     void assign(const std::string& name, const std::any& value);
     void registerFunction(const std::string& name,
@@ -244,6 +432,13 @@ class Jsonata {
     bool isValidateInput() const;
     void setValidateInput(bool validateInput);
 
+    // Parallel sorting: order-by inputs of 65536 items or more are split
+    // into maxWorkers (at most kMaxSortWorkers) chunks, sorted and merged
+    // as tasks run by executor. Without an executor, or with fewer than two
+    // workers, every sort runs on the evaluating thread; that is the default
+    static constexpr size_t kMaxSortWorkers = 64;
+    void setSortExecutor(SortExecutor executor, size_t maxWorkers);
+
     // Error handling
     std::vector<std::exception_ptr> getErrors() const;
 
@@ -261,6 +456,8 @@ class Jsonata {
     std::shared_ptr<Parser::Symbol> expression_;
 
     bool validateInput_ = false;
+    SortExecutor sortExecutor_;
+    size_t sortWorkers_ = 0;
     std::vector<std::exception_ptr> errors_;
     int64_t timestamp_ = 0;
 
@@ -272,13 +469,27 @@ class Jsonata {
         size_t exprIndex;
     };
 
+    // Shared driver for the JSON evaluate() overloads and
+    // CompiledExpression::run(); runs the tree walker when program is null
+    std::any evaluateInput(const std::any& input,
+                           std::shared_ptr<Frame> bindings,
+                           const std::shared_ptr<const vm::Program>& program);
+
     // Core evaluation method
     std::any _evaluate(std::shared_ptr<Parser::Symbol> expr,
                        const std::any& input,
                        std::shared_ptr<Frame> environment);
+    // Sequence unwrapping applied to the result of every node
+    static std::any finishResult(std::any result, bool keepArray);
 
     // Expression evaluation methods
     std::any evaluateLiteral(std::shared_ptr<Parser::Symbol> expr);
+    std::any evaluateFoldedLiteral(std::shared_ptr<Parser::Symbol> expr,
+                                   const std::any& input,
+                                   std::shared_ptr<Frame> environment);
+    std::any evaluateInvariant(const std::shared_ptr<Parser::Symbol>& expr,
+                               const std::any& input,
+                               const std::shared_ptr<Frame>& environment);
     std::any evaluateName(std::shared_ptr<Parser::Symbol> expr,
                           const std::any& input,
                           std::shared_ptr<Frame> environment);
@@ -288,9 +499,13 @@ class Jsonata {
     std::any evaluateBinary(std::shared_ptr<Parser::Symbol> expr,
                             const std::any& input,
                             std::shared_ptr<Frame> environment);
+    std::any evaluateBinaryOperator(std::shared_ptr<Parser::Symbol> expr,
+                                    const std::any& lhs, const std::any& rhs);
     std::any evaluateUnary(std::shared_ptr<Parser::Symbol> expr,
                            const std::any& input,
                            std::shared_ptr<Frame> environment);
+    std::any evaluateNegation(std::shared_ptr<Parser::Symbol> expr,
+                              const std::any& operand);
     std::any evaluateFunction(std::shared_ptr<Parser::Symbol> expr,
                               const std::any& input,
                               std::shared_ptr<Frame> environment);
@@ -298,18 +513,60 @@ class Jsonata {
                                          const std::any& input,
                                          std::shared_ptr<Frame> environment,
                                          const std::any& applytoContext);
+    // limit is passed on in EvalContext::limit. The arguments are handed
+    // over, so signature validation can move them instead of copying
+    std::any invokeFunction(std::shared_ptr<Parser::Symbol> expr,
+                            const std::any& proc, Utils::JList&& evaluatedArgs,
+                            const std::any& input,
+                            std::shared_ptr<Frame> environment,
+                            size_t limit = 0);
     std::any evaluateRegex(std::shared_ptr<Parser::Symbol> expr,
                            const std::any& input,
                            std::shared_ptr<Frame> environment);
     std::any evaluateWildcard(std::shared_ptr<Parser::Symbol> expr,
                               const std::any& input);
-    std::any flatten(const std::any& arg, Utils::JList* flattened = nullptr);
+    // Appends the non-array leaves of arg to flattened
+    void flatten(const std::any& arg, Utils::JList& flattened);
+    // stop, when set, bounds the scan to the matches a constant index
+    // after the filter can select (see filterStop)
     std::any evaluateFilter(std::shared_ptr<Parser::Symbol> predicate,
                             const std::any& input,
-                            std::shared_ptr<Frame> environment);
+                            std::shared_ptr<Frame> environment,
+                            std::optional<int64_t> stop = std::nullopt);
+    // How many times a filter keeps item index of size items for which its
+    // predicate gave res: once when res is truthy, or once per number in res
+    // that picks index (negative numbers count from the end)
+    static size_t filterMatches(const std::any& res, size_t index,
+                                size_t size);
+    // How far filters[i] has to scan: up to the match picked by a constant
+    // index right after it (items[type='x'][0] or [-1]), or its first match
+    // when it is marked firstMatch
+    // Only filters whose predicate neverThrows() stop early: the items a
+    // stopped scan skips could otherwise have raised an error (e.g. T2009 for
+    // a comparison with a string)
+    static std::optional<int64_t> filterStop(
+        const std::vector<std::shared_ptr<Parser::Symbol>>& filters,
+        size_t i);
+    // True when evaluating expr cannot raise an error, whatever the input:
+    // literals, variables, plain names and field paths, and =, !=, in, and,
+    // or over those. Conservative; false for everything else
+    static bool neverThrows(const std::shared_ptr<Parser::Symbol>& expr);
+    // Hands tasks to sortExecutor_ and rethrows the first exception any of
+    // them raised
+    void runSortTasks(const std::vector<std::function<void()>>& tasks);
+    // How many leading items of a sorted list stages can select when the
+    // first of them is a constant index or array of indexes ([0], [[0..9]]);
+    // 0 when they may read any item
+    static size_t sortLimit(
+        const std::vector<std::shared_ptr<Parser::Symbol>>& stages);
+    // True while procedure (a variable node) still refers to the builtin
+    bool callsBuiltin(const std::shared_ptr<Parser::Symbol>& procedure,
+                      const std::shared_ptr<Frame>& environment);
     std::any evaluatePath(std::shared_ptr<Parser::Symbol> expr,
                           const std::any& input,
                           std::shared_ptr<Frame> environment);
+    // The result of a path ending in [] (Symbol::keepSingletonArray)
+    static std::any keepSingletonArray(std::any resultSequence);
     std::any evaluateCondition(std::shared_ptr<Parser::Symbol> expr,
                                const std::any& input,
                                std::shared_ptr<Frame> environment);
@@ -317,7 +574,7 @@ class Jsonata {
                                 const std::any& input,
                                 std::shared_ptr<Frame> environment);
     void recurseDescendants(const std::any& input,
-                            std::vector<std::any>& results);
+                            Utils::JList& results);
     std::any evaluateApply(std::shared_ptr<Parser::Symbol> expr,
                            const std::any& input,
                            std::shared_ptr<Frame> environment);
@@ -330,9 +587,12 @@ class Jsonata {
     std::any evaluateLambda(std::shared_ptr<Parser::Symbol> expr,
                             const std::any& input,
                             std::shared_ptr<Frame> environment);
+    // limit, when not 0, keeps only that many leading items of the order
+    // (see sortLimit)
     std::any evaluateSort(std::shared_ptr<Parser::Symbol> expr,
                           const std::any& input,
-                          std::shared_ptr<Frame> environment);
+                          std::shared_ptr<Frame> environment,
+                          size_t limit = 0);
     std::any evaluateTransform(std::shared_ptr<Parser::Symbol> expr,
                                const std::any& input,
                                std::shared_ptr<Frame> environment);
@@ -345,30 +605,77 @@ class Jsonata {
 
     // Binary operation evaluators
     std::any evaluateNumericExpression(const std::any& lhs, const std::any& rhs,
-                                       const std::string& op);
+                                       Parser::OpCode op);
     std::any evaluateComparisonExpression(const std::any& lhs,
                                           const std::any& rhs,
-                                          const std::string& op);
+                                          Parser::OpCode op);
     bool deepEquals(const std::any& lhs, const std::any& rhs);
     std::any evaluateEqualityExpression(const std::any& lhs,
                                         const std::any& rhs,
-                                        const std::string& op);
+                                        Parser::OpCode op);
     std::any evaluateBooleanExpression(const std::any& lhs,
                                        std::function<std::any()> rhs,
-                                       const std::string& op);
+                                       Parser::OpCode op);
     std::any evaluateStringConcat(const std::any& lhs, const std::any& rhs);
     std::any evaluateRangeExpression(const std::any& lhs, const std::any& rhs);
     std::any evaluateIncludesExpression(const std::any& lhs,
                                         const std::any& rhs);
+    // x in rhs, with rhs invariant, looks x up in a hash index of rhs built
+    // once per evaluation; false when rhs has to be scanned instead
+    bool evaluateIndexedIncludes(const std::shared_ptr<Parser::Symbol>& expr,
+                                 const std::any& lhs, const std::any& input,
+                                 const std::shared_ptr<Frame>& environment,
+                                 std::any& result);
 
     // Missing advanced evaluation methods from Java
     std::any evaluateStages(
         const std::vector<std::shared_ptr<Parser::Symbol>>& stages,
-        const std::any& input, std::shared_ptr<Frame> environment);
+        std::any input, std::shared_ptr<Frame> environment,
+        size_t first = 0);
     std::any evaluateStep(std::shared_ptr<Parser::Symbol> expr,
-                          const std::any& input,
+                          const Utils::JList& input,
                           std::shared_ptr<Frame> environment,
                           bool lastStep = false);
+    // Takes the results over; their items are moved into the sequence
+    static std::any flattenStepResults(Utils::JList&& result, bool lastStep);
+    // True when some result survives flattenStepResults (is not an empty
+    // array)
+    static bool hasItems(const Utils::JList& results);
+    // Runs steps [begin, end) of a path item by item, feeding each result on
+    // to the next step without building the intermediate sequences. The
+    // count input items are read in place
+    std::any evaluateSteps(const std::shared_ptr<Parser::Symbol>& path,
+                           size_t begin, size_t end, const std::any* items,
+                           size_t count,
+                           const std::shared_ptr<Frame>& environment);
+    // The same over a range, whose items are produced one at a time
+    std::any evaluateSteps(const std::shared_ptr<Parser::Symbol>& path,
+                           size_t begin, size_t end, const Utils::JList& range,
+                           const std::shared_ptr<Frame>& environment);
+    void streamStep(const std::shared_ptr<Parser::Symbol>& path, size_t index,
+                    size_t end, const std::any& item,
+                    const std::shared_ptr<Frame>& environment,
+                    Utils::JList& results);
+    std::any evaluateStepItem(const std::shared_ptr<Parser::Symbol>& step,
+                              const std::any& item,
+                              const std::shared_ptr<Frame>& environment);
+    // items[0] and the like index the field in place instead of copying the
+    // whole array out of item first; false when the step is not of that form
+    bool evaluateIndexedField(const std::shared_ptr<Parser::Symbol>& step,
+                              const std::any& item,
+                              const std::shared_ptr<Frame>& environment,
+                              std::any& result);
+    static bool isStreamableStep(const std::shared_ptr<Parser::Symbol>& step);
+    // Paths of plain field names (Symbol::fields) walk the input in place and
+    // copy only the values that end up in the result
+    static std::any evaluateFieldPath(const Parser::Symbol& path,
+                                      const std::any& input);
+    // Paths with a Symbol::join look the filtered items up in an index built
+    // once per evaluation; false when the path has to be walked instead
+    bool evaluateHashJoin(const std::shared_ptr<Parser::Symbol>& path,
+                          const std::any& input,
+                          const std::shared_ptr<Frame>& environment,
+                          std::any& result);
     std::any evaluateTupleStep(std::shared_ptr<Parser::Symbol> expr,
                                const Utils::JList& input,
                                const std::optional<Utils::JList>& tupleBindings,
@@ -376,6 +683,12 @@ class Jsonata {
     std::any evaluateGroupExpression(std::shared_ptr<Parser::Symbol> expr,
                                      const std::any& input,
                                      std::shared_ptr<Frame> environment);
+    // Group-by with Symbol::aggregates folds each item into a running value
+    // per group; false when an item needs the groups collected instead
+    bool evaluateGroupAggregates(const std::shared_ptr<Parser::Symbol>& expr,
+                                 const Utils::JList& items,
+                                 const std::shared_ptr<Frame>& environment,
+                                 std::any& result);
     std::any evaluateTransformExpression(std::shared_ptr<Parser::Symbol> expr,
                                          const std::any& input,
                                          std::shared_ptr<Frame> environment);
@@ -386,9 +699,8 @@ class Jsonata {
                                         const std::any& input,
                                         std::shared_ptr<Frame> environment);
 
-    std::shared_ptr<Frame> createFrameFromTuple(
-        std::shared_ptr<Frame> environment, const std::any& tupleAny);
-    std::any reduceTupleStream(const std::any& tupleStream);
+    // The tuple of a group's tuples, each variable holding all their values
+    static Tuple reduceTupleStream(const std::any& tupleStream);
 
     // Conversion helpers between engine types and JSON
     // Ordered variants preserve insertion order using nlohmann::ordered_json
@@ -410,7 +722,7 @@ std::any jsonata_evaluate(const std::string& expression, const std::any& input);
 template <typename R>
 void Jsonata::registerFunction(const std::string& name,
                                std::function<R()> implementation) {
-    auto wrapper = [implementation](const std::vector<std::any>&) -> std::any {
+    auto wrapper = [implementation](const Utils::JList&) -> std::any {
         if constexpr (std::is_void_v<R>) {
             implementation();
             return std::any{};
@@ -425,7 +737,7 @@ template <typename A, typename R>
 void Jsonata::registerFunction(const std::string& name,
                                std::function<R(A)> implementation) {
     auto wrapper = [implementation,
-                    name](const std::vector<std::any>& args) -> std::any {
+                    name](const Utils::JList& args) -> std::any {
         if (args.empty()) {
             throw JException("S0410", -1,
                              "Function " + name + " expects 1 argument, got 0");
@@ -445,7 +757,7 @@ template <typename A, typename B, typename R>
 void Jsonata::registerFunction(const std::string& name,
                                std::function<R(A, B)> implementation) {
     auto wrapper = [implementation,
-                    name](const std::vector<std::any>& args) -> std::any {
+                    name](const Utils::JList& args) -> std::any {
         if (args.size() < 2) {
             throw JException("S0410", -1,
                              "Function " + name + " expects 2 arguments, got " +
@@ -467,7 +779,7 @@ template <typename A, typename B, typename C, typename R>
 void Jsonata::registerFunction(const std::string& name,
                                std::function<R(A, B, C)> implementation) {
     auto wrapper = [implementation,
-                    name](const std::vector<std::any>& args) -> std::any {
+                    name](const Utils::JList& args) -> std::any {
         if (args.size() < 3) {
             throw JException("S0410", -1,
                              "Function " + name + " expects 3 arguments, got " +
@@ -490,7 +802,7 @@ template <typename A, typename B, typename C, typename D, typename R>
 void Jsonata::registerFunction(const std::string& name,
                                std::function<R(A, B, C, D)> implementation) {
     auto wrapper = [implementation,
-                    name](const std::vector<std::any>& args) -> std::any {
+                    name](const Utils::JList& args) -> std::any {
         if (args.size() < 4) {
             throw JException("S0410", -1,
                              "Function " + name + " expects 4 arguments, got " +
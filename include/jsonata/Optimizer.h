@@ -0,0 +1,72 @@
+/**
+ * jsonata-cpp is the JSONata C++ reference port
+ *
+ * Copyright Dashjoin GmbH. https://dashjoin.com
+ * Copyright Robert Yokota
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <memory>
+
+#include "jsonata/Parser.h"
+
+namespace jsonata {
+
+class Jsonata;
+
+/**
+ * Simplifies a processed AST once, after parsing:
+ *  - subtrees built only from literals (operators, array and object
+ *    constructors, and calls to pure builtins such as $uppercase) are
+ *    evaluated and replaced by a literal node holding the value;
+ *  - conditions with a constant test are replaced by the branch taken;
+ *  - blocks holding a single expression that binds nothing are replaced by
+ *    that expression, and literals before the last expression are dropped;
+ *  - a call $exists(x) keeps in Symbol::body a copy of x marked firstMatch,
+ *    which the evaluator uses instead of x while $exists is the builtin, so
+ *    the filter or path stops at its first match (only when the predicates
+ *    and steps it would skip cannot raise an error, see Jsonata::neverThrows);
+ *  - inside path steps, filters, lambda bodies, group-by, sort terms and
+ *    transforms, the largest subtrees that read no context and no variable
+ *    the expression binds (e.g. $average($$.orders.total) in a filter) are
+ *    marked Symbol::invariant; Jsonata::evaluate computes each once per
+ *    evaluation and reuses the value, unless one of the builtins listed in
+ *    Symbol::invariantCalls has been replaced;
+ *  - in the same places, a path whose leading steps are invariant and end in
+ *    a name filtered by `field = key`, where key does not read the item (e.g.
+ *    $$.customers[id = $order.customerId].name), gets a Symbol::join; the
+ *    evaluator indexes the filtered items by field once per evaluation and
+ *    looks key up instead of testing every item;
+ *  - a group-by whose keys are pure and whose values are all $sum, $count,
+ *    $max, $min or $average of a field or of $ is marked
+ *    Symbol::aggregates; the evaluator keeps one running value per group
+ *    instead of collecting the group's items, and collects them after all
+ *    when an item holds something only the collected form handles (nested
+ *    arrays, non-numbers).
+ *
+ * Subtrees whose evaluation fails are left alone so the error is still
+ * raised, with its position, at evaluation time. Subtrees using the parent
+ * operator (%), and the steps it climbs back to, are not rewritten, and
+ * variables bound by @$x and #$i count as bound by the expression; the rest
+ * of such an expression is optimized. Builtin calls are folded only when the
+ * expression does not rebind the name itself; the literal keeps the calls'
+ * variables in Symbol::arguments and the folded subtree in Symbol::body, and
+ * the evaluator runs that subtree instead if registerFunction or evaluation
+ * bindings have replaced one of the builtins.
+ */
+std::shared_ptr<Parser::Symbol> optimize(
+    const std::shared_ptr<Parser::Symbol>& ast, Jsonata& instance);
+
+}  // namespace jsonata
@@ -42,6 +42,9 @@ namespace jsonata {
 // Forward declarations
 class Frame;
 class Signature;
+namespace vm {
+struct Program;
+}
 
 /**
  * Parser implementing the 'Top down operator precedence' algorithm
@@ -50,11 +53,91 @@ class Signature;
  */
 class Parser {
   public:
+    // Node kinds resolved from Symbol::type so the evaluator can dispatch
+    // with a switch instead of string comparisons
+    enum class NodeType : uint8_t {
+        Unresolved,
+        String,
+        Number,
+        Value,
+        Name,
+        Variable,
+        Binary,
+        Unary,
+        Function,
+        Partial,
+        Regex,
+        Wildcard,
+        Path,
+        Condition,
+        Descendant,
+        Apply,
+        Bind,
+        Lambda,
+        Transform,
+        Parent,
+        Block,
+        Sort,
+        Filter,
+        Index,
+        Operator,
+        Other
+    };
+
+    // Operator codes resolved from Symbol::value for binary and unary nodes
+    enum class OpCode : uint8_t {
+        None,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Concat,
+        Range,
+        In,
+        And,
+        Or,
+        ArrayConstructor,
+        ObjectConstructor,
+        Negate,
+        Not,
+        Other
+    };
+
+    static NodeType nodeTypeOf(const std::string& type);
+    static OpCode opCodeOf(NodeType type, const std::any& value);
+    // Source spelling of an operator, used in error messages
+    static const char* opName(OpCode op);
+
     // AST Node representation
     class Symbol : public std::enable_shared_from_this<Symbol> {
       public:
         std::string id;
         std::string type;
+        // Resolved form of type/value; filled in by Parser::parse, or on
+        // first use for nodes synthesized at evaluation time
+        NodeType kind = NodeType::Unresolved;
+        OpCode op = OpCode::None;
+        // Frame::Slot of a variable node's name (UINT32_MAX otherwise)
+        uint32_t varSlot = UINT32_MAX;
+        // Id of the Parser::parse call that built the node (0 for nodes
+        // synthesized at evaluation time), and whether a variable node names
+        // something that expression never binds ($$, builtins, evaluation
+        // bindings), which Frame::lookupFree finds from the evaluation root
+        uint32_t scope = 0;
+        bool freeVariable = false;
+        // Frame::Slots of the variables a tuple step binds: its focus (@$v)
+        // and index (#$i, or an index stage's), and the label of the
+        // ancestor it binds or a parent node (%) reads
+        uint32_t focusSlot = UINT32_MAX;
+        uint32_t indexSlot = UINT32_MAX;
+        uint32_t ancestorSlot = UINT32_MAX;
         std::any value;
         std::any token;
         int64_t lbp = 0;
@@ -73,6 +156,9 @@ class Parser {
         std::vector<std::shared_ptr<Symbol>> expressions;
         std::vector<std::shared_ptr<Symbol>> arguments;
         std::vector<std::shared_ptr<Symbol>> steps;  // for path expressions
+        // Field names of a path made only of plain name steps, set by
+        // Parser::parse (see markFieldPath); empty for every other node
+        std::vector<std::string> fields;
         std::vector<std::shared_ptr<Symbol>> terms;
         std::vector<std::shared_ptr<Symbol>> predicate;
 
@@ -101,12 +187,41 @@ class Parser {
         bool keepArray = false;
         bool consarray = false;
         bool keepSingletonArray = false;
+        // Filter or path that may stop at its first match; only set on the
+        // copy of a $exists argument made by the optimizer
+        bool firstMatch = false;
+        // Subexpression inside a filter, lambda, path step, sort term or
+        // group whose value is the same throughout an evaluation (see
+        // Optimizer.h); computed once, while the builtins it calls, listed
+        // in invariantCalls, have not been replaced
+        bool invariant = false;
+        std::vector<std::shared_ptr<Symbol>> invariantCalls;
+        // Path whose first steps end in one filtered by `field = key` and
+        // are otherwise invariant (see Optimizer.h): the evaluator indexes
+        // the filtered items by field once per evaluation and looks key up
+        struct HashJoin {
+            size_t length = 0;               // steps the join stands for
+            std::shared_ptr<Symbol> source;  // the steps before the last
+            std::shared_ptr<Symbol> step;    // the last, without its filter
+            std::shared_ptr<Symbol> field;   // read from each item
+            std::shared_ptr<Symbol> key;     // read once per lookup
+            std::vector<std::shared_ptr<Symbol>> calls;  // builtins of source
+        };
+        std::shared_ptr<HashJoin> join;
+        // Group-by (the node in another's group) whose values are all
+        // $sum, $count, $max, $min or $average of a field or of $, which
+        // the evaluator accumulates item by item (see Optimizer.h)
+        bool aggregates = false;
         int64_t level = 0;
         std::any focus;
         std::any tuple;
         bool thunk = false;
         std::any input;
         std::any environment;
+        // Closure made by a compiled program: its body is run from
+        // program->code[entry] (see Compiler.h)
+        std::shared_ptr<const vm::Program> program;
+        uint32_t entry = 0;
 
         // Complex structures
         std::shared_ptr<Symbol> group;
@@ -151,6 +266,20 @@ class Parser {
         virtual ~Symbol() = default;
 
         std::string toString() const;
+
+        NodeType nodeType() {
+            if (kind == NodeType::Unresolved) resolveType();
+            return kind;
+        }
+        OpCode opCode() {
+            if (kind == NodeType::Unresolved) resolveType();
+            return op;
+        }
+        uint32_t variableSlot() {
+            if (kind == NodeType::Unresolved) resolveType();
+            return varSlot;
+        }
+        void resolveType();
     };
 
     // Specific symbol types
@@ -395,6 +524,11 @@ class Parser {
     void pushAncestry(std::shared_ptr<Symbol> result,
                       std::shared_ptr<Symbol> value);
     void resolveAncestry(std::shared_ptr<Symbol> path);
+    static void resolveNodeTypes(const std::shared_ptr<Symbol>& node);
+    // Sets Symbol::scope on every node and Symbol::freeVariable on the
+    // variables that read a name the expression never binds
+    static void markScope(const std::shared_ptr<Symbol>& expr);
+    static void markFieldPath(const std::shared_ptr<Symbol>& path);
 
     // Object constructor parsing
     std::shared_ptr<Symbol> objectParser(std::shared_ptr<Symbol> left);
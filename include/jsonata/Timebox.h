@@ -21,17 +21,17 @@
 #include <any>
 #include <chrono>
 #include <functional>
+#include <memory>
 
-namespace jsonata {
+#include "jsonata/Jsonata.h"
 
-// Forward declarations
-class Frame;
+namespace jsonata {
 
 /**
  * Configure max runtime / max recursion depth.
  * See Frame.setRuntimeBounds - usually not used directly
  */
-class Timebox {
+class Timebox : public EvaluationObserver {
   private:
     int64_t timeout_;  // timeout in milliseconds (default: 5000ms)
     int64_t maxDepth_;  // max recursion depth (default: 100)
@@ -62,7 +62,16 @@ class Timebox {
     // Runtime check method
     void checkRunnaway();
 
-    // Callback handlers (called by Frame during evaluation)
+    // Observer hooks (called by the evaluator for every node)
+    void onEvaluateEntry(const std::shared_ptr<Parser::Symbol>& expr,
+                         const std::any& input,
+                         const std::shared_ptr<Frame>& environment) override;
+    void onEvaluateExit(const std::shared_ptr<Parser::Symbol>& expr,
+                        const std::any& input,
+                        const std::shared_ptr<Frame>& environment,
+                        const std::any& result) override;
+
+    // Depth bookkeeping behind the hooks
     void onEvaluateEntry();
     void onEvaluateExit();
 
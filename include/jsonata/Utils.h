@@ -19,14 +19,20 @@
 #pragma once
 
 #include <any>
+#include <atomic>
+#include <cstdint>
 #include <ctime>
 #include <functional>
+#include <initializer_list>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -45,46 +51,262 @@ static inline std::time_t timegm_utc(std::tm* tm) {
 class JFunction;
 class JFunctionCallable;
 
+/**
+ * Memory for the frames and sequences of a single evaluation.
+ * Jsonata::evaluate creates one per call and makes it current on its thread
+ * while it runs; frames created beneath the evaluation's root frame and the
+ * item buffers of sequences grown meanwhile come from its pools, and the
+ * blocks go back to the system together once the last of them is gone.
+ * Frames and buffers each hold a reference, so anything that outlives the
+ * call stays valid. An evaluation runs on one thread, so the pools are
+ * unsynchronized.
+ */
+class EvaluationArena : public std::pmr::unsynchronized_pool_resource {
+  public:
+    // A new arena; the returned pointer holds one reference
+    static std::shared_ptr<EvaluationArena> create();
+
+    // The arena new sequence buffers on this thread come from, or nullptr
+    static EvaluationArena* current() { return current_; }
+
+    // Makes an arena current on this thread until the end of the scope
+    class Scope {
+      public:
+        explicit Scope(EvaluationArena* arena) : previous_(current_) {
+            current_ = arena;
+        }
+        ~Scope() { current_ = previous_; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        EvaluationArena* previous_;
+    };
+
+    void retain() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    void release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+  private:
+    EvaluationArena() = default;
+
+    std::atomic<size_t> refs_{1};
+    static thread_local EvaluationArena* current_;
+};
+
 class Utils {
   public:
     // Sentinel type to represent a JSON null literal (distinct from undefined)
     class NullValue {};
 
+    // Vector of std::any items whose first item is stored inline. Most
+    // sequences built during evaluation hold zero or one item, so they never
+    // allocate an item buffer; longer lists grow into a buffer like
+    // std::vector, drawn from the current EvaluationArena when there is one
+    // and from the heap otherwise. Slots past size() are kept as empty
+    // std::any values.
+    class ItemVector {
+      public:
+        using value_type = std::any;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::any&;
+        using const_reference = const std::any&;
+        using pointer = std::any*;
+        using const_pointer = const std::any*;
+        using iterator = std::any*;
+        using const_iterator = const std::any*;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        ItemVector() noexcept : data_(&inline_) {}
+        ItemVector(size_t count, const std::any& value);
+        ItemVector(std::initializer_list<std::any> init);
+        template <typename InputIt,
+                  typename = typename std::iterator_traits<
+                      InputIt>::iterator_category>
+        ItemVector(InputIt first, InputIt last) : data_(&inline_) {
+            insert(end(), first, last);
+        }
+        explicit ItemVector(const std::vector<std::any>& items);
+        explicit ItemVector(std::vector<std::any>&& items);
+        ItemVector(const ItemVector& other);
+        ItemVector(ItemVector&& other) noexcept;
+        ItemVector& operator=(const ItemVector& other);
+        ItemVector& operator=(ItemVector&& other) noexcept;
+        ~ItemVector() {
+            if (data_ != &inline_) {
+                freeBuffer();
+            }
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        size_t capacity() const { return capacity_; }
+        void reserve(size_t capacity) {
+            if (capacity > capacity_) {
+                grow(capacity);
+            }
+        }
+        void clear() noexcept;
+        void resize(size_t count);
+        void swap(ItemVector& other) noexcept;
+
+        std::any* data() { return data_; }
+        const std::any* data() const { return data_; }
+        std::any& operator[](size_t index) { return data_[index]; }
+        const std::any& operator[](size_t index) const { return data_[index]; }
+        std::any& at(size_t index);
+        const std::any& at(size_t index) const;
+        std::any& front() { return data_[0]; }
+        const std::any& front() const { return data_[0]; }
+        std::any& back() { return data_[size_ - 1]; }
+        const std::any& back() const { return data_[size_ - 1]; }
+
+        iterator begin() { return data_; }
+        iterator end() { return data_ + size_; }
+        const_iterator begin() const { return data_; }
+        const_iterator end() const { return data_ + size_; }
+        const_iterator cbegin() const { return data_; }
+        const_iterator cend() const { return data_ + size_; }
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const {
+            return const_reverse_iterator(end());
+        }
+        const_reverse_iterator rend() const {
+            return const_reverse_iterator(begin());
+        }
+
+        void push_back(const std::any& value) { emplace_back(value); }
+        void push_back(std::any&& value) { emplace_back(std::move(value)); }
+        template <typename... Args>
+        std::any& emplace_back(Args&&... args) {
+            if (size_ == capacity_) {
+                // args may refer to an item of this vector
+                std::any value(std::forward<Args>(args)...);
+                grow(capacity_ * 2);
+                return data_[size_++] = std::move(value);
+            }
+            return data_[size_++] = std::any(std::forward<Args>(args)...);
+        }
+        void pop_back() { data_[--size_].reset(); }
+
+        iterator insert(const_iterator pos, std::any value);
+        template <typename InputIt,
+                  typename = typename std::iterator_traits<
+                      InputIt>::iterator_category>
+        iterator insert(const_iterator pos, InputIt first, InputIt last) {
+            const size_t index = static_cast<size_t>(pos - data_);
+            if constexpr (std::is_base_of_v<
+                              std::forward_iterator_tag,
+                              typename std::iterator_traits<
+                                  InputIt>::iterator_category>) {
+                const size_t count =
+                    static_cast<size_t>(std::distance(first, last));
+                iterator at = openGap(index, count);
+                for (; first != last; ++first, ++at) {
+                    *at = *first;
+                }
+            } else {
+                for (size_t i = index; first != last; ++first, ++i) {
+                    insert(data_ + i, std::any(*first));
+                }
+            }
+            return data_ + index;
+        }
+        iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+        iterator erase(const_iterator first, const_iterator last);
+
+        // Whether the item buffer was drawn from an EvaluationArena
+        bool inArena() const { return arena_ != nullptr; }
+
+      private:
+        // Reallocates to hold at least capacity items
+        void grow(size_t capacity);
+        // Moves the items to a new buffer of capacity slots from arena (the
+        // heap when nullptr)
+        void reallocate(size_t capacity, EvaluationArena* arena);
+        // Destroys the item buffer and returns it to where it came from
+        void freeBuffer() noexcept;
+        // Shifts items from index on right by count slots and returns the
+        // first opened slot
+        iterator openGap(size_t index, size_t count);
+
+        std::any* data_;
+        uint32_t size_ = 0;
+        uint32_t capacity_ = 1;
+        std::any inline_;
+        // Arena the item buffer came from; nullptr for the heap or inline
+        EvaluationArena* arena_ = nullptr;
+    };
+
     // Unified list type that can represent either a regular list or a range
     // (declared first for use in function signatures)
-    class JList : public std::vector<std::any> {
+    class JList : public ItemVector {
       private:
         // Range-specific members
         int64_t range_start_ = 0;
         int64_t range_end_ = 0;
-        bool is_range_ = false;
+        bool is_range_ : 1;
+
+        void clearFlags() {
+            sequence = outerWrapper = tupleStream = keepSingleton = cons =
+                is_range_ = false;
+        }
+        void copyFlags(const JList& other) {
+            sequence = other.sequence;
+            outerWrapper = other.outerWrapper;
+            tupleStream = other.tupleStream;
+            keepSingleton = other.keepSingleton;
+            cons = other.cons;
+            is_range_ = other.is_range_;
+        }
 
       public:
         // Regular list constructors
-        JList() : std::vector<std::any>() {}
-        JList(size_t capacity) : std::vector<std::any>() {
+        JList() { clearFlags(); }
+        JList(size_t capacity) {
+            clearFlags();
             this->reserve(capacity);
         }
-        JList(const std::vector<std::any>& other)
-            : std::vector<std::any>(other) {}
+        JList(const std::vector<std::any>& other) : ItemVector(other) {
+            clearFlags();
+        }
+        JList(std::vector<std::any>&& other) : ItemVector(std::move(other)) {
+            clearFlags();
+        }
+        template <typename InputIt,
+                  typename = typename std::iterator_traits<
+                      InputIt>::iterator_category>
+        JList(InputIt first, InputIt last) : ItemVector(first, last) {
+            clearFlags();
+        }
         JList(const JList& other);
+        // Sequences are handed between evaluation steps by value; moving
+        // keeps that O(1) instead of copying every element
+        JList(JList&& other) noexcept;
+        JList& operator=(const JList& other);
+        JList& operator=(JList&& other) noexcept;
 
         // Add initializer list constructor
-        JList(std::initializer_list<std::any> init)
-            : std::vector<std::any>(init),
-              range_start_(0),
-              range_end_(0),
-              is_range_(false) {}
+        JList(std::initializer_list<std::any> init) : ItemVector(init) {
+            clearFlags();
+        }
 
         // Range constructor
         JList(int64_t start, int64_t end);
 
-        // JSONata specific flags
-        bool sequence = false;
-        bool outerWrapper = false;
-        bool tupleStream = false;
-        bool keepSingleton = false;
-        bool cons = false;
+        // JSONata specific flags, packed into bit-fields. Bit-fields cannot
+        // have default member initializers, so every constructor clears them
+        bool sequence : 1;
+        bool outerWrapper : 1;
+        bool tupleStream : 1;
+        bool keepSingleton : 1;
+        bool cons : 1;
 
         // Range detection
         bool isRange() const { return is_range_; }
@@ -133,9 +355,8 @@ class Utils {
         // Simple solution: Override begin/end to materialize ranges when needed
         // for iteration This is simpler than complex custom iterators and
         // ensures compatibility
-        using base_iterator = typename std::vector<std::any>::iterator;
-        using base_const_iterator =
-            typename std::vector<std::any>::const_iterator;
+        using base_iterator = ItemVector::iterator;
+        using base_const_iterator = ItemVector::const_iterator;
 
         // Override begin/end to handle ranges by materializing if needed
         base_iterator begin();
@@ -184,10 +405,45 @@ class Utils {
     static bool isSequence(const std::any& result);
     static std::any convertNumber(const std::any& n);
     static JList arrayify(const std::any& value);
+    // Moves the elements out of value when it already holds a list
+    static JList arrayify(std::any&& value);
+    // Calls visit(item) for each item of an array value without copying the
+    // array; a range's items are produced one at a time
+    template <typename Visit>
+    static void forEachItem(const std::any& array, Visit&& visit);
     static void checkUrl(const std::string& str);
     static std::any convertValue(const std::any& val);
     static std::any convertNulls(const std::any& res);
     static void quote(const std::string& string, std::ostringstream& w);
+    // A hash of value's structure: values Jsonata::deepEquals or $distinct
+    // find equal hash alike. Numbers hash by their double value, arrays by
+    // their items in order and objects by their entries in any order.
+    // nullopt when value holds an infinite number, which comparisons report
+    // as D1001 rather than compare
+    static std::optional<uint64_t> structuralHash(const std::any& value);
+
+    // An operand of an ordering comparison (<, <=, >, >=, order-by, $sort):
+    // a number or a string, read in place. text views the string held by
+    // the value it was taken from, so the key must not outlive that value
+    struct OrderKey {
+        enum class Kind : uint8_t { Other, Integer, Double, String };
+
+        Kind kind = Kind::Other;
+        int64_t integer = 0;
+        double number = 0;
+        std::string_view text;
+
+        bool isNumber() const {
+            return kind == Kind::Integer || kind == Kind::Double;
+        }
+        bool isString() const { return kind == Kind::String; }
+    };
+    // Classifies value for compareOrderKeys. NaN is Other; an infinite
+    // double throws D1001, as isNumeric does
+    static OrderKey orderKey(const std::any& value);
+    // Three-way comparison of two numbers or two strings. Integers compare
+    // exactly, with each other and with doubles; strings compare bytewise
+    static int compareOrderKeys(const OrderKey& a, const OrderKey& b);
 
     // Special values
     static const std::any NONE;
@@ -199,4 +455,25 @@ class Utils {
     static void recurse(std::any& val);
 };
 
+template <typename Visit>
+void Utils::forEachItem(const std::any& array, Visit&& visit) {
+    if (array.type() == typeid(JList)) {
+        const auto& list = std::any_cast<const JList&>(array);
+        if (list.isRange()) {
+            for (size_t i = 0; i < list.size(); i++) {
+                visit(list[i]);
+            }
+            return;
+        }
+        for (const auto& item : list) {
+            visit(item);
+        }
+    } else if (array.type() == typeid(std::vector<std::any>)) {
+        for (const auto& item :
+             std::any_cast<const std::vector<std::any>&>(array)) {
+            visit(item);
+        }
+    }
+}
+
 }  // namespace jsonata
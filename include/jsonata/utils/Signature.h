@@ -94,6 +94,8 @@ class Signature {
      * @return Validated arguments list
      */
     Utils::JList validate(const Utils::JList& args, const std::any& context);
+    // The same, moving the arguments out of args instead of copying them
+    Utils::JList validate(Utils::JList&& args, const std::any& context);
 
     /**
      * Returns the total number of parameters in the signature
@@ -105,6 +107,12 @@ class Signature {
      */
     int64_t getMinNumberOfArgs() const;
 
+    /**
+     * Returns true when a missing argument may be taken from the context
+     * (a parameter marked '-')
+     */
+    bool hasContextParam() const;
+
   private:
     int64_t findClosingBracket(const std::string& str, int64_t start, char openSymbol,
                            char closeSymbol);
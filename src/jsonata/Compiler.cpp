@@ -0,0 +1,764 @@
+/**
+ * jsonata-cpp is the JSONata C++ reference port
+ *
+ * Copyright Dashjoin GmbH. https://dashjoin.com
+ * Copyright Robert Yokota
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "jsonata/Compiler.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "jsonata/Functions.h"
+#include "jsonata/JException.h"
+#include "jsonata/Jsonata.h"
+#include "jsonata/Utils.h"
+
+namespace jsonata {
+namespace vm {
+
+namespace {
+
+class Compiler {
+  public:
+    explicit Compiler(Program& program) : program_(program) {}
+
+    // Compiles node into its own entry point ending in Op::Return
+    uint32_t compileEntry(const std::shared_ptr<Parser::Symbol>& node) {
+        std::vector<Instruction> code;
+        emit(node, code);
+        code.push_back({Op::Return});
+        auto entry = static_cast<uint32_t>(program_.code.size());
+        program_.code.insert(program_.code.end(), code.begin(), code.end());
+        return entry;
+    }
+
+  private:
+    Program& program_;
+    std::unordered_map<std::string, uint32_t> nameIds_;
+
+    uint32_t addConstant(const std::any& value) {
+        program_.constants.push_back(value);
+        return static_cast<uint32_t>(program_.constants.size() - 1);
+    }
+
+    uint32_t addName(const std::string& name) {
+        auto it = nameIds_.find(name);
+        if (it != nameIds_.end()) {
+            return it->second;
+        }
+        program_.names.push_back(name);
+        auto id = static_cast<uint32_t>(program_.names.size() - 1);
+        nameIds_.emplace(name, id);
+        return id;
+    }
+
+    uint32_t addNode(const std::shared_ptr<Parser::Symbol>& node) {
+        program_.nodes.push_back(node);
+        return static_cast<uint32_t>(program_.nodes.size() - 1);
+    }
+
+    static bool isString(const std::any& value) {
+        return value.type() == typeid(std::string);
+    }
+
+    // Emits a forward jump and returns its index for patchJump()
+    static size_t emitJump(Op op, std::vector<Instruction>& code) {
+        code.push_back({op});
+        return code.size() - 1;
+    }
+
+    static void patchJump(size_t at, std::vector<Instruction>& code) {
+        code[at].a = static_cast<uint32_t>(code.size() - at - 1);
+    }
+
+    // Jumps back to the instruction at target
+    static void emitLoop(size_t target, std::vector<Instruction>& code) {
+        code.push_back(
+            {Op::Loop, static_cast<uint32_t>(code.size() + 1 - target)});
+    }
+
+    void emit(const std::shared_ptr<Parser::Symbol>& node,
+              std::vector<Instruction>& code) {
+        if (!node) {
+            code.push_back({Op::PushUndefined});
+            return;
+        }
+        // Group-by is applied by Jsonata::_evaluate around the node itself,
+        // invariant nodes are memoized by Jsonata::evaluate and hash joins
+        // are planned paths
+        if (!node->group && !node->invariant && !node->join &&
+            lowersStages(node->predicate) && emitNode(node, code)) {
+            emitStages(node->predicate, code);
+            if (!isScalar(node) || !node->predicate.empty() ||
+                node->keepArray) {
+                code.push_back({Op::Finish, node->keepArray});
+            }
+            return;
+        }
+        code.push_back({Op::Evaluate, addNode(node)});
+    }
+
+    // Nodes whose value Op::Finish leaves as it is
+    static bool isScalar(const std::shared_ptr<Parser::Symbol>& node) {
+        switch (node->nodeType()) {
+            case Parser::NodeType::String:
+            case Parser::NodeType::Number:
+                return node->arguments.empty();
+            case Parser::NodeType::Binary:
+                return node->opCode() == Parser::OpCode::And ||
+                       node->opCode() == Parser::OpCode::Or;
+            default:
+                return false;
+        }
+    }
+
+    // Predicates and step stages compile when they are all filters;
+    // index stages only occur on tuple steps
+    static bool lowersStages(
+        const std::vector<std::shared_ptr<Parser::Symbol>>& stages) {
+        for (const auto& stage : stages) {
+            if (!stage || stage->nodeType() != Parser::NodeType::Filter ||
+                stage->expr.type() != typeid(std::shared_ptr<Parser::Symbol>) ||
+                !std::any_cast<const std::shared_ptr<Parser::Symbol>&>(
+                    stage->expr)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Filters the top of stack as Jsonata::evaluateStages does
+    void emitStages(const std::vector<std::shared_ptr<Parser::Symbol>>& stages,
+                    std::vector<Instruction>& code) {
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const auto& predicate =
+                std::any_cast<const std::shared_ptr<Parser::Symbol>&>(
+                    stages[i]->expr);
+            if (predicate->nodeType() == Parser::NodeType::Number) {
+                code.push_back({Op::FilterIndex, addNode(predicate)});
+                continue;
+            }
+            auto stop = Jsonata::filterStop(stages, i);
+            code.push_back(
+                {Op::FilterBegin,
+                 addConstant(stop ? std::any(*stop) : std::any{})});
+            size_t next = emitJump(Op::Next, code);
+            emit(predicate, code);
+            code.push_back({Op::FilterTest});
+            emitLoop(next, code);
+            patchJump(next, code);
+            code.push_back({Op::FilterEnd});
+        }
+    }
+
+    // Returns false when the node has no dedicated instruction sequence
+    bool emitNode(const std::shared_ptr<Parser::Symbol>& node,
+                  std::vector<Instruction>& code) {
+        switch (node->nodeType()) {
+            case Parser::NodeType::String:
+            case Parser::NodeType::Number:
+            case Parser::NodeType::Value:
+                // Folded builtin calls are checked on every evaluation
+                if (!node->arguments.empty()) {
+                    return false;
+                }
+                code.push_back(
+                    {Op::PushConst,
+                     addConstant(node->value.has_value() ? node->value
+                                                         : Utils::NULL_VALUE)});
+                return true;
+            case Parser::NodeType::Variable: {
+                if (!isString(node->value)) return false;
+                const auto& name = std::any_cast<const std::string&>(node->value);
+                if (name.empty()) {
+                    code.push_back({Op::LoadContext});
+                } else if (node->freeVariable) {
+                    code.push_back(
+                        {Op::LoadFree, node->variableSlot(), node->scope});
+                } else {
+                    code.push_back({Op::LoadVariable, node->variableSlot()});
+                }
+                return true;
+            }
+            case Parser::NodeType::Name:
+                if (!isString(node->value)) return false;
+                code.push_back(
+                    {Op::LoadField,
+                     addName(std::any_cast<const std::string&>(node->value))});
+                return true;
+            case Parser::NodeType::Binary:
+                return emitBinary(node, code);
+            case Parser::NodeType::Unary:
+                if (node->opCode() != Parser::OpCode::Negate ||
+                    !node->expression) {
+                    return false;
+                }
+                emit(node->expression, code);
+                code.push_back({Op::Negate, addNode(node)});
+                return true;
+            case Parser::NodeType::Condition: {
+                if (!node->condition) return false;
+                emit(node->condition, code);
+                size_t toElse = emitJump(Op::JumpIfFalse, code);
+                emit(node->then_expr, code);
+                size_t toEnd = emitJump(Op::Jump, code);
+                patchJump(toElse, code);
+                if (node->else_expr) {
+                    emit(node->else_expr, code);
+                } else {
+                    code.push_back({Op::PushUndefined});
+                }
+                patchJump(toEnd, code);
+                return true;
+            }
+            case Parser::NodeType::Block:
+                code.push_back({Op::EnterScope});
+                for (size_t i = 0; i < node->expressions.size(); ++i) {
+                    if (i > 0) code.push_back({Op::Pop});
+                    emit(node->expressions[i], code);
+                }
+                if (node->expressions.empty()) {
+                    code.push_back({Op::PushUndefined});
+                }
+                code.push_back({Op::ExitScope});
+                return true;
+            case Parser::NodeType::Bind:
+                if (!node->lhs ||
+                    node->lhs->variableSlot() == Frame::kNoSlot) {
+                    return false;
+                }
+                emit(node->rhs, code);
+                code.push_back({Op::Bind, node->lhs->variableSlot()});
+                return true;
+            case Parser::NodeType::Function: {
+                // A first-match argument is chosen at each call
+                if (!node->procedure || node->body) return false;
+                uint32_t id = addNode(node);
+                emit(node->procedure, code);
+                code.push_back({Op::CheckFunction, id});
+                for (const auto& arg : node->arguments) {
+                    emit(arg, code);
+                }
+                code.push_back(
+                    {Op::Call, id,
+                     static_cast<uint32_t>(node->arguments.size())});
+                return true;
+            }
+            case Parser::NodeType::Lambda: {
+                // Tail calls (thunks) are unpacked by Jsonata::apply
+                if (node->thunk || !node->body) return false;
+                uint32_t body = compileEntry(node->body);
+                code.push_back({Op::Lambda, addNode(node), body});
+                return true;
+            }
+            case Parser::NodeType::Path:
+                return emitPath(node, code);
+            default:
+                return false;
+        }
+    }
+
+    bool emitBinary(const std::shared_ptr<Parser::Symbol>& node,
+                    std::vector<Instruction>& code) {
+        if (!node->lhs || !node->rhs) return false;
+        const Parser::OpCode op = node->opCode();
+        if (op == Parser::OpCode::And || op == Parser::OpCode::Or) {
+            emit(node->lhs, code);
+            size_t shortCircuit =
+                emitJump(op == Parser::OpCode::And ? Op::And : Op::Or, code);
+            emit(node->rhs, code);
+            code.push_back({Op::ToBoolean});
+            patchJump(shortCircuit, code);
+            return true;
+        }
+        if (op == Parser::OpCode::None || op == Parser::OpCode::Other) {
+            return false;
+        }
+        // An invariant right-hand side of `in` is looked up in a hash index
+        if (op == Parser::OpCode::In && node->rhs->invariant) {
+            return false;
+        }
+        emit(node->lhs, code);
+        emit(node->rhs, code);
+        code.push_back({Op::Binary, addNode(node)});
+        return true;
+    }
+
+    // Name-only paths walk the input in one instruction. Other paths run
+    // their steps as nested loops, each item going through all of them
+    // before the next is read, as Jsonata::evaluateSteps streams them; only
+    // the last step's results are collected. Tuple and sort steps need the
+    // whole sequence and stay on Jsonata::evaluatePath
+    bool emitPath(const std::shared_ptr<Parser::Symbol>& node,
+                  std::vector<Instruction>& code) {
+        const auto& steps = node->steps;
+        if (steps.empty() || node->tuple.has_value()) {
+            return false;
+        }
+        if (!node->fields.empty()) {
+            code.push_back({Op::FieldPath, addNode(node)});
+            return true;
+        }
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (!Jsonata::isStreamableStep(steps[i]) ||
+                (!(i == 0 && steps[0]->consarray) &&
+                 !lowersStages(steps[i]->stages))) {
+                return false;
+            }
+        }
+
+        // An array constructor as the first step is evaluated once, on the
+        // whole input (its stages are not applied, as in evaluatePath)
+        size_t first = 0;
+        uint32_t source =
+            steps[0]->nodeType() == Parser::NodeType::Variable ? 2 : 0;
+        std::vector<size_t> toEnd;
+        if (steps[0]->consarray) {
+            code.push_back({Op::PathInput});
+            code.push_back({Op::EnterContext});
+            emit(steps[0], code);
+            code.push_back({Op::ExitContext});
+            first = 1;
+            source = 1;
+            if (steps.size() > 1) {
+                toEnd.push_back(emitJump(Op::JumpIfEmpty, code));
+            }
+        }
+
+        if (first < steps.size()) {
+            std::vector<size_t> nexts;
+            code.push_back({Op::StepBegin, source, node->firstMatch});
+            for (size_t i = first; i < steps.size(); ++i) {
+                nexts.push_back(emitJump(Op::Next, code));
+                emit(steps[i], code);
+                emitStages(steps[i]->stages, code);
+                if (i + 1 < steps.size()) {
+                    code.push_back({Op::Spread});
+                } else {
+                    code.push_back(
+                        {Op::Collect,
+                         static_cast<uint32_t>(steps.size() - 1 - first)});
+                }
+            }
+            for (size_t i = nexts.size(); i-- > 0;) {
+                emitLoop(nexts[i], code);
+                patchJump(nexts[i], code);
+                code.push_back({i == 0 ? Op::StepEnd : Op::EndLoop});
+            }
+        }
+
+        for (size_t at : toEnd) {
+            patchJump(at, code);
+        }
+        if (node->keepSingletonArray) {
+            code.push_back({Op::KeepSingleton});
+        }
+        return true;
+    }
+};
+
+class Machine {
+  public:
+    Machine(std::shared_ptr<const Program> program, Jsonata& instance)
+        : program_(std::move(program)), instance_(instance) {}
+
+    std::any run(uint32_t pc, const std::any& input,
+                 std::shared_ptr<Frame> environment) {
+        const std::vector<Instruction>& code = program_->code;
+        std::vector<std::shared_ptr<Frame>> scopes;
+        const std::any* context = &input;
+        for (;;) {
+            const Instruction& ins = code[pc++];
+            switch (ins.op) {
+                case Op::PushConst:
+                    stack_.push_back(program_->constants[ins.a]);
+                    break;
+                case Op::PushUndefined:
+                    stack_.emplace_back();
+                    break;
+                case Op::LoadContext:
+                    stack_.push_back(contextItem(*context));
+                    break;
+                case Op::LoadVariable:
+                    stack_.push_back(environment->lookup(ins.a));
+                    break;
+                case Op::LoadFree:
+                    stack_.push_back(environment->lookupFree(ins.a, ins.b));
+                    break;
+                case Op::LoadField:
+                    stack_.push_back(context->has_value()
+                                         ? Functions::lookup(
+                                               *context, program_->names[ins.a])
+                                         : std::any{});
+                    break;
+                case Op::Pop:
+                    stack_.pop_back();
+                    break;
+                case Op::Binary: {
+                    std::any rhs = pop();
+                    std::any lhs = pop();
+                    stack_.push_back(instance_.evaluateBinaryOperator(
+                        program_->nodes[ins.a], lhs, rhs));
+                    break;
+                }
+                case Op::Negate:
+                    stack_.back() = instance_.evaluateNegation(
+                        program_->nodes[ins.a], stack_.back());
+                    break;
+                case Op::And:
+                    if (!Jsonata::boolize(pop())) {
+                        stack_.emplace_back(false);
+                        pc += ins.a;
+                    }
+                    break;
+                case Op::Or:
+                    if (Jsonata::boolize(pop())) {
+                        stack_.emplace_back(true);
+                        pc += ins.a;
+                    }
+                    break;
+                case Op::ToBoolean:
+                    stack_.back() = Jsonata::boolize(stack_.back());
+                    break;
+                case Op::JumpIfFalse:
+                    if (!Jsonata::boolize(pop())) {
+                        pc += ins.a;
+                    }
+                    break;
+                case Op::JumpIfEmpty:
+                    if (!stack_.back().has_value() ||
+                        isEmptyArray(stack_.back())) {
+                        pc += ins.a;
+                    }
+                    break;
+                case Op::Jump:
+                    pc += ins.a;
+                    break;
+                case Op::Loop:
+                    pc -= ins.a;
+                    break;
+                case Op::EnterScope:
+                    scopes.push_back(environment);
+                    environment = instance_.createFrame(environment);
+                    break;
+                case Op::ExitScope:
+                    environment = scopes.back();
+                    scopes.pop_back();
+                    break;
+                case Op::Bind:
+                    environment->bind(ins.a, stack_.back());
+                    break;
+                case Op::CheckFunction:
+                    if (!stack_.back().has_value()) {
+                        const auto& expr = program_->nodes[ins.a];
+                        throw JException("T1006", expr->position,
+                                         expr->procedure->value);
+                    }
+                    break;
+                case Op::Call: {
+                    Utils::JList args(static_cast<size_t>(ins.b));
+                    for (size_t i = stack_.size() - ins.b; i < stack_.size();
+                         ++i) {
+                        args.push_back(std::move(stack_[i]));
+                    }
+                    stack_.resize(stack_.size() - ins.b);
+                    std::any proc = pop();
+                    stack_.push_back(instance_.invokeFunction(
+                        program_->nodes[ins.a], proc, std::move(args),
+                        *context, environment));
+                    break;
+                }
+                case Op::Lambda: {
+                    auto closure = instance_.evaluateLambda(
+                        program_->nodes[ins.a], *context, environment);
+                    const auto& procedure =
+                        std::any_cast<const std::shared_ptr<Parser::Symbol>&>(
+                            closure);
+                    procedure->program = program_;
+                    procedure->entry = ins.b;
+                    stack_.push_back(std::move(closure));
+                    break;
+                }
+                case Op::FieldPath:
+                    stack_.push_back(Jsonata::evaluateFieldPath(
+                        *program_->nodes[ins.a], *context));
+                    break;
+                case Op::PathInput:
+                    stack_.push_back(pathInput(*context));
+                    break;
+                case Op::EnterContext: {
+                    Loop& loop = enterLoop(context);
+                    loop.held = pop();
+                    context = &loop.held;
+                    break;
+                }
+                case Op::ExitContext:
+                case Op::EndLoop:
+                    context = leaveLoop().context;
+                    break;
+                case Op::StepBegin: {
+                    Loop& loop = enterLoop(context);
+                    loop.firstMatch = ins.b != 0;
+                    // As in evaluatePath, an array constructor's result
+                    // only replaces the path's input when it is an array
+                    std::any value = ins.a == 1 ? pop() : std::any{};
+                    if (ins.a == 1 && Utils::isArray(value)) {
+                        iterate(loop, Utils::arrayify(std::move(value)));
+                    } else if (ins.a != 2 && context->has_value() &&
+                               Utils::isArray(*context)) {
+                        // The input list is read in place
+                        const auto* list =
+                            std::any_cast<Utils::JList>(context);
+                        if (list != nullptr && !list->isRange()) {
+                            loop.items = list->data();
+                            loop.count = list->ItemVector::size();
+                        } else {
+                            iterate(loop, Utils::arrayify(*context));
+                        }
+                    } else {
+                        loop.items = context;
+                        loop.count = 1;
+                    }
+                    break;
+                }
+                case Op::Spread: {
+                    // The items Jsonata::streamStep hands on
+                    std::any value = pop();
+                    Loop& loop = enterLoop(context);
+                    if (!value.has_value()) {
+                        break;
+                    }
+                    const auto* list = std::any_cast<Utils::JList>(&value);
+                    if (!Utils::isArray(value) ||
+                        (list != nullptr && list->cons)) {
+                        loop.held = std::move(value);
+                        loop.items = &loop.held;
+                        loop.count = 1;
+                    } else {
+                        iterate(loop, Utils::arrayify(std::move(value)));
+                    }
+                    break;
+                }
+                case Op::Next: {
+                    Loop& loop = *loops_[depth_ - 1];
+                    if (loop.done || loop.next >= loop.count ||
+                        (loop.firstMatch && Jsonata::hasItems(loop.results))) {
+                        pc += ins.a;
+                        break;
+                    }
+                    loop.index =
+                        loop.fromEnd ? loop.count - 1 - loop.next : loop.next;
+                    loop.next++;
+                    context = &loop.items[loop.index];
+                    break;
+                }
+                case Op::Collect: {
+                    std::any value = pop();
+                    if (value.has_value()) {
+                        loops_[depth_ - 1 - ins.a]->results.push_back(
+                            std::move(value));
+                    }
+                    break;
+                }
+                case Op::StepEnd: {
+                    Loop& loop = leaveLoop();
+                    context = loop.context;
+                    stack_.push_back(Jsonata::flattenStepResults(
+                        std::move(loop.results), true));
+                    break;
+                }
+                case Op::FilterIndex:
+                    stack_.back() = instance_.evaluateFilter(
+                        program_->nodes[ins.a], stack_.back(), environment);
+                    break;
+                case Op::FilterBegin: {
+                    // Jsonata::evaluateFilter reads its input as a sequence
+                    std::any value = pop();
+                    Loop& loop = enterLoop(context);
+                    if (!Utils::isArray(value)) {
+                        iterate(loop, Utils::createSequence(value));
+                    } else {
+                        iterate(loop, Utils::arrayify(std::move(value)));
+                    }
+                    const auto& stop = program_->constants[ins.a];
+                    if (stop.has_value()) {
+                        int64_t last = std::any_cast<int64_t>(stop);
+                        loop.bounded = true;
+                        loop.fromEnd = last < 0;
+                        loop.wanted = static_cast<size_t>(
+                            loop.fromEnd ? -last : last + 1);
+                    }
+                    break;
+                }
+                case Op::FilterTest: {
+                    Loop& loop = *loops_[depth_ - 1];
+                    const std::any& item = loop.items[loop.index];
+                    size_t matches =
+                        Jsonata::filterMatches(pop(), loop.index, loop.count);
+                    for (size_t m = matches; m > 0; m--) {
+                        loop.results.push_back(item);
+                    }
+                    // Empty arrays vanish when step results are flattened
+                    if (loop.bounded && matches > 0 && !isEmptyArray(item)) {
+                        loop.found += matches;
+                        loop.done = loop.found >= loop.wanted;
+                    }
+                    break;
+                }
+                case Op::FilterEnd: {
+                    Loop& loop = leaveLoop();
+                    context = loop.context;
+                    if (loop.fromEnd) {
+                        std::reverse(loop.results.begin(), loop.results.end());
+                    }
+                    stack_.emplace_back(std::move(loop.results));
+                    break;
+                }
+                case Op::KeepSingleton:
+                    stack_.back() =
+                        Jsonata::keepSingletonArray(std::move(stack_.back()));
+                    break;
+                case Op::Finish:
+                    stack_.back() = Jsonata::finishResult(
+                        std::move(stack_.back()), ins.a != 0);
+                    break;
+                case Op::Evaluate:
+                    stack_.push_back(instance_.evaluate(
+                        program_->nodes[ins.a], *context, environment));
+                    break;
+                case Op::Return:
+                    return pop();
+            }
+        }
+    }
+
+  private:
+    // A path step or filter being iterated. Loops are kept for reuse, so
+    // context items pointing into them stay put while inner loops start
+    struct Loop {
+        const std::any* context = nullptr;  // restored when the loop ends
+        std::any held;                      // single owned item
+        Utils::JList owned;                 // owned items
+        const std::any* items = nullptr;
+        size_t count = 0;
+        size_t next = 0;
+        size_t index = 0;
+        Utils::JList results;
+        bool firstMatch = false;
+        // A filter scan bounded by the index after it (see filterStop)
+        bool bounded = false;
+        bool fromEnd = false;
+        bool done = false;
+        size_t wanted = 0;
+        size_t found = 0;
+    };
+
+    std::shared_ptr<const Program> program_;
+    Jsonata& instance_;
+    std::vector<std::any> stack_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    size_t depth_ = 0;
+
+    std::any pop() {
+        std::any value = std::move(stack_.back());
+        stack_.pop_back();
+        return value;
+    }
+
+    Loop& enterLoop(const std::any* context) {
+        if (depth_ == loops_.size()) {
+            loops_.push_back(std::make_unique<Loop>());
+        }
+        Loop& loop = *loops_[depth_++];
+        loop = Loop();
+        loop.context = context;
+        loop.results = Utils::createSequence();
+        return loop;
+    }
+
+    Loop& leaveLoop() { return *loops_[--depth_]; }
+
+    static void iterate(Loop& loop, Utils::JList&& items) {
+        loop.owned = std::move(items);
+        loop.items = loop.owned.data();
+        loop.count = loop.owned.ItemVector::size();
+    }
+
+    static bool isEmptyArray(const std::any& value) {
+        if (value.type() == typeid(Utils::JList)) {
+            return std::any_cast<const Utils::JList&>(value).empty();
+        }
+        return value.type() == typeid(std::vector<std::any>) &&
+               std::any_cast<const std::vector<std::any>&>(value).empty();
+    }
+
+    // The sequence Jsonata::evaluatePath hands an array constructor step
+    static std::any pathInput(const std::any& input) {
+        if (input.has_value() && Utils::isArray(input)) {
+            return Utils::arrayify(input);
+        }
+        return Utils::createSequence(input);
+    }
+
+    // Same as Jsonata::evaluateVariable for the empty name
+    static std::any contextItem(const std::any& input) {
+        if (input.type() == typeid(Utils::JList)) {
+            const auto& jlist = std::any_cast<const Utils::JList&>(input);
+            if (jlist.outerWrapper && !jlist.empty()) {
+                return jlist[0];
+            }
+        }
+        return input;
+    }
+};
+
+}  // namespace
+
+std::shared_ptr<const Program> compile(
+    const std::shared_ptr<Parser::Symbol>& ast) {
+    auto program = std::make_shared<Program>();
+    Compiler compiler(*program);
+    program->entry = compiler.compileEntry(ast);
+    return program;
+}
+
+std::any execute(const std::shared_ptr<const Program>& program,
+                 uint32_t entry, Jsonata& instance, const std::any& input,
+                 std::shared_ptr<Frame> environment) {
+    Machine machine(program, instance);
+    return machine.run(entry, input, std::move(environment));
+}
+
+}  // namespace vm
+
+CompiledExpression::CompiledExpression(
+    std::shared_ptr<Jsonata> instance,
+    std::shared_ptr<const vm::Program> program)
+    : instance_(std::move(instance)), program_(std::move(program)) {}
+
+nlohmann::ordered_json CompiledExpression::run(
+    const nlohmann::ordered_json& input, std::shared_ptr<Frame> bindings) {
+    return Jsonata::anyToOrderedJson(instance_->evaluateInput(
+        Jsonata::orderedJsonToAny(input), bindings, program_));
+}
+
+nlohmann::json CompiledExpression::run(const nlohmann::json& input,
+                                       std::shared_ptr<Frame> bindings) {
+    return Jsonata::anyToJson(instance_->evaluateInput(
+        Jsonata::jsonToAny(input), bindings, program_));
+}
+
+}  // namespace jsonata
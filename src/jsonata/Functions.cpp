@@ -37,6 +37,7 @@
 #include <regex>
 #include <set>
 #include <sstream>
+#include <unordered_map>
 
 namespace jsonata {
 
@@ -64,36 +65,58 @@ static inline std::optional<std::string> type(const std::any& value) {
     return Utils::type(value);
 }
 
-// Aggregation functions
-std::optional<double> Functions::sum(const Utils::JList& args) {
-    if (args.empty()) {
-        return std::nullopt;
-    }
-
-    // Flatten all arguments into a single vector for processing
-    Utils::JList flatArgs;
+// Reads an argument in place. Argument lists are built item by item and are
+// never ranges, so their items can be referenced (JList's const operator[]
+// returns copies so that it can serve ranges)
+static inline const std::any& argument(const Utils::JList& args,
+                                       size_t index) {
+    return static_cast<const Utils::ItemVector&>(args)[index];
+}
 
-    for (const auto& arg : args) {
-        if (isArray(arg)) {
-            // Handle arrays by flattening them
-            auto array = Utils::arrayify(arg);
-            for (const auto& item : array) {
-                flatArgs.push_back(item);
+// Calls visit(double) for each number extractNumbers would collect from the
+// arguments, spreading array arguments one level. Items are read in place
+// and a range's numbers are produced one at a time
+template <typename Visit>
+static void forEachNumber(const Utils::JList& args, Visit&& visit) {
+    auto number = [&](const std::any& value) {
+        if (value.type() == typeid(double)) {
+            visit(std::any_cast<double>(value));
+        } else if (value.type() == typeid(int64_t)) {
+            visit(static_cast<double>(std::any_cast<int64_t>(value)));
+        } else if (value.type() == typeid(uint64_t)) {
+            visit(static_cast<double>(std::any_cast<uint64_t>(value)));
+        }
+    };
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::any& arg = argument(args, i);
+        const auto* list = std::any_cast<Utils::JList>(&arg);
+        if (list != nullptr && list->isRange()) {
+            for (int64_t n = list->getRangeStart(); n <= list->getRangeEnd();
+                 n++) {
+                visit(static_cast<double>(n));
             }
+        } else if (isArray(arg)) {
+            Utils::forEachItem(arg, number);
         } else {
-            flatArgs.push_back(arg);
+            number(arg);
         }
     }
+}
 
-    // Use existing extractNumbers function
-    auto numbers = extractNumbers(flatArgs);
-    if (numbers.empty()) {
+// Aggregation functions
+std::optional<double> Functions::sum(const Utils::JList& args) {
+    if (args.empty()) {
         return std::nullopt;
     }
 
+    bool found = false;
     double sum = 0.0;
-    for (const auto& num : numbers) {
-        sum += Utils::toDouble(num);
+    forEachNumber(args, [&](double num) {
+        found = true;
+        sum += num;
+    });
+    if (!found) {
+        return std::nullopt;
     }
     return sum;
 }
@@ -105,18 +128,22 @@ std::optional<int64_t> Functions::count(const Utils::JList& args) {
         return 0;
     }
 
-    // If the first argument is an array, count its elements
-    if (args[0].has_value()) {
-        if (isArray(args[0])) {
-            const auto& array = Utils::arrayify(args[0]);
-            return static_cast<int64_t>(array.size());
-        }
+    // If the first argument is an array, count its elements (a range's size
+    // is known without producing them)
+    const std::any& array = argument(args, 0);
+    if (array.type() == typeid(Utils::JList)) {
+        return static_cast<int64_t>(
+            std::any_cast<const Utils::JList&>(array).size());
+    }
+    if (array.type() == typeid(std::vector<std::any>)) {
+        return static_cast<int64_t>(
+            std::any_cast<const std::vector<std::any>&>(array).size());
     }
 
     // Otherwise, count non-null arguments (for backward compatibility)
     int64_t count = 0;
-    for (const auto& arg : args) {
-        if (arg.has_value()) {
+    for (size_t i = 0; i < args.size(); i++) {
+        if (argument(args, i).has_value()) {
             count++;
         }
     }
@@ -128,34 +155,12 @@ std::optional<double> Functions::max(const Utils::JList& args) {
         return std::nullopt;
     }
 
-    // Flatten all arguments into a single vector for processing
-    Utils::JList flatArgs;
-
-    for (const auto& arg : args) {
-        if (isArray(arg)) {
-            // Handle arrays by flattening them
-            auto array = Utils::arrayify(arg);
-            for (const auto& item : array) {
-                flatArgs.push_back(item);
-            }
-        } else {
-            flatArgs.push_back(arg);
-        }
-    }
-
-    // Use existing extractNumbers function
-    auto numbers = extractNumbers(flatArgs);
-    if (numbers.empty()) {
-        return std::nullopt;
-    }
-
-    double max_val = std::any_cast<double>(numbers[0]);
-    for (size_t i = 1; i < numbers.size(); ++i) {
-        double val = std::any_cast<double>(numbers[i]);
-        if (val > max_val) {
+    std::optional<double> max_val;
+    forEachNumber(args, [&](double val) {
+        if (!max_val || val > *max_val) {
             max_val = val;
         }
-    }
+    });
     return max_val;
 }
 
@@ -164,34 +169,12 @@ std::optional<double> Functions::min(const Utils::JList& args) {
         return std::nullopt;
     }
 
-    // Flatten all arguments into a single vector for processing
-    Utils::JList flatArgs;
-
-    for (const auto& arg : args) {
-        if (isArray(arg)) {
-            // Handle arrays by flattening them
-            auto array = Utils::arrayify(arg);
-            for (const auto& item : array) {
-                flatArgs.push_back(item);
-            }
-        } else {
-            flatArgs.push_back(arg);
-        }
-    }
-
-    // Use existing extractNumbers function
-    auto numbers = extractNumbers(flatArgs);
-    if (numbers.empty()) {
-        return std::nullopt;
-    }
-
-    double min_val = std::any_cast<double>(numbers[0]);
-    for (size_t i = 1; i < numbers.size(); ++i) {
-        double val = std::any_cast<double>(numbers[i]);
-        if (val < min_val) {
+    std::optional<double> min_val;
+    forEachNumber(args, [&](double val) {
+        if (!min_val || val < *min_val) {
             min_val = val;
         }
-    }
+    });
     return min_val;
 }
 
@@ -200,39 +183,23 @@ std::optional<double> Functions::average(const Utils::JList& args) {
         return std::nullopt;
     }
 
-    // Flatten all arguments into a single vector for processing
-    Utils::JList flatArgs;
-
-    for (const auto& arg : args) {
-        if (isArray(arg)) {
-            // Handle arrays by flattening them
-            auto array = Utils::arrayify(arg);
-            for (const auto& item : array) {
-                flatArgs.push_back(item);
-            }
-        } else {
-            flatArgs.push_back(arg);
-        }
-    }
-
-    // Use existing extractNumbers function
-    auto numbers = extractNumbers(flatArgs);
-    if (numbers.empty()) {
-        return std::nullopt;
-    }
-
+    size_t count = 0;
     double sum = 0.0;
-    for (const auto& num : numbers) {
-        sum += std::any_cast<double>(num);
+    forEachNumber(args, [&](double num) {
+        count++;
+        sum += num;
+    });
+    if (count == 0) {
+        return std::nullopt;
     }
-    return sum / numbers.size();
+    return sum / count;
 }
 
 // String functions
 std::optional<std::string> Functions::string(const std::any& arg,
                                              bool prettify) {
     if (arg.type() == typeid(Utils::JList)) {
-        auto jlist = std::any_cast<Utils::JList>(arg);
+        const auto& jlist = std::any_cast<const Utils::JList&>(arg);
         if (jlist.outerWrapper) {
             auto item = jlist[0];
             if (!item.has_value()) {
@@ -368,14 +335,11 @@ std::any Functions::sort(const Utils::JList& args) {
         // later for complex comparators
         std::stable_sort(result.begin(), result.end(),
                          [](const std::any& a, const std::any& b) {
-                             if (Utils::isNumeric(a) && Utils::isNumeric(b)) {
-                                 double valA = Utils::toDouble(a);
-                                 double valB = Utils::toDouble(b);
-                                 return valA < valB;
-                             } else if (a.type() == typeid(std::string) &&
-                                        b.type() == typeid(std::string)) {
-                                 return std::any_cast<std::string>(a) <
-                                        std::any_cast<std::string>(b);
+                             Utils::OrderKey keyA = Utils::orderKey(a);
+                             Utils::OrderKey keyB = Utils::orderKey(b);
+                             if ((keyA.isNumber() && keyB.isNumber()) ||
+                                 (keyA.isString() && keyB.isString())) {
+                                 return Utils::compareOrderKeys(keyA, keyB) < 0;
                              }
                              return false;
                          });
@@ -409,14 +373,11 @@ std::any Functions::sort(const Utils::JList& args) {
         // Natural ordering for homogeneous arrays - use stable_sort
         std::stable_sort(result.begin(), result.end(),
                          [](const std::any& a, const std::any& b) {
-                             if (Utils::isNumeric(a) && Utils::isNumeric(b)) {
-                                 double valA = Utils::toDouble(a);
-                                 double valB = Utils::toDouble(b);
-                                 return valA < valB;
-                             } else if (a.type() == typeid(std::string) &&
-                                        b.type() == typeid(std::string)) {
-                                 return std::any_cast<std::string>(a) <
-                                        std::any_cast<std::string>(b);
+                             Utils::OrderKey keyA = Utils::orderKey(a);
+                             Utils::OrderKey keyB = Utils::orderKey(b);
+                             if ((keyA.isNumber() && keyB.isNumber()) ||
+                                 (keyA.isString() && keyB.isString())) {
+                                 return Utils::compareOrderKeys(keyA, keyB) < 0;
                              }
                              return false;
                          });
@@ -465,12 +426,10 @@ static bool isDeepEqualForDistinct(const std::any& lhs, const std::any& rhs) {
         // Compare direct map objects
         if (lhs.type() ==
             typeid(nlohmann::ordered_map<std::string, std::any>)) {
-            const auto& leftMap =
-                std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                    lhs);
-            const auto& rightMap =
-                std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                    rhs);
+            const auto& leftMap = std::any_cast<
+                const nlohmann::ordered_map<std::string, std::any>&>(lhs);
+            const auto& rightMap = std::any_cast<
+                const nlohmann::ordered_map<std::string, std::any>&>(rhs);
 
             if (leftMap.size() != rightMap.size()) {
                 return false;
@@ -516,19 +475,23 @@ std::any Functions::distinct(const std::any& _arr) {
     Utils::JList results = Utils::createSequence();
 
     // Java reference logic: Use LinkedHashSet behavior - preserve order,
-    // eliminate duplicates Since C++ doesn't have direct equivalent of Java's
-    // LinkedHashSet with object equality, we need to implement deep equality
-    // comparison like JavaScript version
+    // eliminate duplicates. Results are indexed by their structural hash and
+    // a value is only compared with the results in its bucket; values with no
+    // hash are compared with each other
+    std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+    std::vector<size_t> unhashed;
     for (const auto& value : arr) {
-        // Check if this value is already in results using deep equality
+        auto hash = Utils::structuralHash(value);
+        auto& candidates = hash ? buckets[*hash] : unhashed;
         bool includes = false;
-        for (const auto& existing : results) {
-            if (isDeepEqualForDistinct(value, existing)) {
+        for (size_t index : candidates) {
+            if (isDeepEqualForDistinct(value, results[index])) {
                 includes = true;
                 break;
             }
         }
         if (!includes) {
+            candidates.push_back(results.size());
             results.push_back(value);
         }
     }
@@ -1143,7 +1106,8 @@ Functions::getFunctionRegistry() {
 
             {"replace",
              FunctionEntry(
-                 [](const Utils::JList& args) -> std::any {
+                 [](const Utils::JList& args,
+                    const EvalContext& context) -> std::any {
                      if (args.size() < 3 || !isString(args[0]))
                          return std::any();
                      auto str = std::any_cast<std::string>(args[0]);
@@ -1161,7 +1125,8 @@ Functions::getFunctionRegistry() {
                      int64_t limit = (args.size() >= 4 && isNumber(args[3]))
                                      ? Utils::toLong(args[3])
                                      : -1;
-                     auto result = replace(str, args[1], args[2], limit);
+                     auto result =
+                         replace(str, args[1], args[2], limit, context);
                      return result ? std::any(*result) : std::any();
                  },
                  "<s-(sf)(sf)n?:s>")},
@@ -1413,32 +1378,39 @@ Functions::getFunctionRegistry() {
                         "<x-:b>")},
 
             // Higher-order functions
-            {"map",
-             FunctionEntry(
-                 [](const Utils::JList& args) -> std::any { return map(args); },
-                 "<af>")},
+            {"map", FunctionEntry(
+                        [](const Utils::JList& args, const EvalContext& context)
+                            -> std::any { return map(args, context); },
+                        "<af>")},
 
             {"zip",
              FunctionEntry(
                  [](const Utils::JList& args) -> std::any { return zip(args); },
                  "<a+>")},
 
-            {"filter", FunctionEntry([](const Utils::JList& args)
-                                         -> std::any { return filter(args); },
-                                     "<af>")},
+            {"filter",
+             FunctionEntry(
+                 [](const Utils::JList& args, const EvalContext& context)
+                     -> std::any { return filter(args, context); },
+                 "<af>")},
 
-            {"single", FunctionEntry([](const Utils::JList& args)
-                                         -> std::any { return single(args); },
-                                     "<af?>")},
+            {"single",
+             FunctionEntry(
+                 [](const Utils::JList& args, const EvalContext& context)
+                     -> std::any { return single(args, context); },
+                 "<af?>")},
 
-            {"reduce", FunctionEntry([](const Utils::JList& args)
-                                         -> std::any { return foldLeft(args); },
-                                     "<afj?:j>")},
+            {"reduce",
+             FunctionEntry(
+                 [](const Utils::JList& args, const EvalContext& context)
+                     -> std::any { return foldLeft(args, context); },
+                 "<afj?:j>")},
 
             // Object/Array functions
-            {"sift", FunctionEntry([](const Utils::JList& args)
-                                       -> std::any { return sift(args); },
-                                   "<o-f?:o>")},
+            {"sift", FunctionEntry(
+                         [](const Utils::JList& args, const EvalContext& context)
+                             -> std::any { return sift(args, context); },
+                         "<o-f?:o>")},
 
             {"keys", FunctionEntry(
                          [](const Utils::JList& args) -> std::any {
@@ -1481,9 +1453,10 @@ Functions::getFunctionRegistry() {
                                       "<a:a>")},
 
             {"each", FunctionEntry(
-                         [](const Utils::JList& args) -> std::any {
+                         [](const Utils::JList& args,
+                            const EvalContext& context) -> std::any {
                              if (args.size() < 2) return std::any();
-                             return each(args[0], args[1]);
+                             return each(args[0], args[1], context);
                          },
                          "<o-f:a>")},
 
@@ -1524,9 +1497,12 @@ Functions::getFunctionRegistry() {
                          },
                          "<x:s>")},
 
-            {"sort", FunctionEntry([](const Utils::JList& args)
-                                       -> std::any { return sort(args); },
-                                   "<af?:a>")},
+            {"sort", FunctionEntry(
+                         [](const Utils::JList& args, const EvalContext& context)
+                             -> std::any {
+                             return sortWithContext(args, context);
+                         },
+                         "<af?:a>")},
 
             {"shuffle", FunctionEntry([](const Utils::JList& args)
                                           -> std::any { return shuffle(args); },
@@ -1610,13 +1586,14 @@ Functions::getFunctionRegistry() {
 
             // Special functions
             {"eval", FunctionEntry(
-                         [](const Utils::JList& args) -> std::any {
+                         [](const Utils::JList& args,
+                            const EvalContext& context) -> std::any {
                              if (args.empty() || !isString(args[0]))
                                  return std::any();
                              auto expr = std::any_cast<std::string>(args[0]);
                              std::any focus =
                                  (args.size() >= 2) ? args[1] : std::any();
-                             return functionEval(expr, focus);
+                             return functionEval(expr, focus, context);
                          },
                          "<sx?:x>")},
 
@@ -1690,7 +1667,8 @@ Functions::getFunctionRegistry() {
 }
 
 std::any Functions::applyFunction(const std::string& name,
-                                  const Utils::JList& args) {
+                                  const Utils::JList& args,
+                                  const EvalContext& context) {
     auto registry = getFunctionRegistry();
     auto it = registry.find(name);
     if (it != registry.end()) {
@@ -1719,17 +1697,18 @@ std::any Functions::applyFunction(const std::string& name,
         }
 
         // Call the function with validated arguments
-        return entry.implementation(validatedArgs);
+        return entry.call(validatedArgs, context);
     }
     throw JException("T0410", 0, name);
 }
 
 // Backward compatibility overload for std::vector<std::any>
 std::any Functions::applyFunction(const std::string& name,
-                                  const std::vector<std::any>& args) {
+                                  const std::vector<std::any>& args,
+                                  const EvalContext& context) {
     // Convert std::vector to Utils::JList and delegate
     Utils::JList jlist_args(args);
-    return applyFunction(name, jlist_args);
+    return applyFunction(name, jlist_args, context);
 }
 
 // Function application infrastructure
@@ -1882,21 +1861,15 @@ Utils::JList Functions::hofFuncArgs(const std::any& func, const std::any& arg1,
     return func_args;
 }
 
-std::any Functions::funcApply(const std::any& func, const Utils::JList& args) {
+std::any Functions::funcApply(const std::any& func, const Utils::JList& args,
+                             const EvalContext& context) {
     try {
         // Match Java implementation exactly (Functions.java lines 1557-1564)
         if (isLambda(func)) {
             // Java: res = Jsonata.current.get().apply(func, funcArgs, null,
             // Jsonata.current.get().environment);
-            auto instance = Jsonata::getCurrentInstance();
-            if (instance) {
-                // apply is now an instance method, so call it on the instance
-                return instance->apply(func, args, std::any{},
-                                       instance->getEnvironment());
-            }
-            // If no instance available, this is a problem
-            // This should not happen in normal execution
-            return std::any{};
+            return context.instance.apply(func, args, std::any{},
+                                          context.instance.getEnvironment());
         } else {
             // For native functions (JFunction in Java), call them directly
             // Java: res = ((JFunction)func).call(null, funcArgs);
@@ -1905,16 +1878,17 @@ std::any Functions::funcApply(const std::any& func, const Utils::JList& args) {
             if (func.type() == typeid(JFunction)) {
                 auto& jfunc = std::any_cast<const JFunction&>(func);
                 if (jfunc.implementation) {
-                    auto instance = Jsonata::getCurrentInstance();
-                    auto env = instance ? instance->getEnvironment() : nullptr;
-                    return jfunc.implementation(args, std::any{}, env);
+                    const std::any noInput;
+                    auto env = context.instance.getEnvironment();
+                    return jfunc.implementation(
+                        args, EvalContext{context.instance, noInput, env});
                 }
                 return std::any{};
             }
             // Check for FunctionEntry objects (direct function calls)
             else if (func.type() == typeid(FunctionEntry)) {
                 auto& funcEntry = std::any_cast<const FunctionEntry&>(func);
-                return funcEntry.implementation(args);
+                return funcEntry.call(args, context);
             }
         }
         return std::any{};
@@ -1924,15 +1898,16 @@ std::any Functions::funcApply(const std::any& func, const Utils::JList& args) {
 }
 
 // Higher-order functions
-std::any Functions::map(const Utils::JList& args) {
+std::any Functions::map(const Utils::JList& args,
+                        const EvalContext& context) {
     // Match Java implementation exactly (Functions.java lines 1572-1590)
     if (args.size() < 2) {
         return std::any{};  // Invalid arguments
     }
 
     // Extract array and function
-    const auto& arrayArg = args[0];
-    const auto& funcArg = args[1];
+    const auto& arrayArg = argument(args, 0);
+    const auto& funcArg = argument(args, 1);
 
     // Java: if (arr == null) { return null; }
     if (!arrayArg.has_value()) {
@@ -1940,34 +1915,29 @@ std::any Functions::map(const Utils::JList& args) {
     }
 
     try {
-        // Convert to vector if needed - handle both vector and JList
-        Utils::JList inputArray;
-        if (isArray(arrayArg)) {
-            inputArray = Utils::arrayify(arrayArg);
-        } else {
-            // Single value becomes single-element array (Java wrapping
-            // behavior)
-            inputArray.push_back(arrayArg);
-        }
-
         Utils::JList result = Utils::createSequence();
 
-        // Java: for (int i=0; i<arr.size(); i++)
-        for (size_t i = 0; i < inputArray.size(); ++i) {
-            // Java: Object arg = arr.get(i);
-            const auto& arg = inputArray[i];
-
+        // Java: for (int i=0; i<arr.size(); i++). The items are read in
+        // place; a range's items are produced one at a time
+        int64_t i = 0;
+        auto apply = [&](const std::any& arg) {
             // Java: List funcArgs = hofFuncArgs(func, arg, i, arr);
-            auto funcArgs =
-                hofFuncArgs(funcArg, arg, static_cast<int64_t>(i), arrayArg);
+            auto funcArgs = hofFuncArgs(funcArg, arg, i++, arrayArg);
 
             // Java: Object res = funcApply(func, funcArgs);
-            auto res = funcApply(funcArg, funcArgs);
+            auto res = funcApply(funcArg, funcArgs, context);
 
             // Java: if (res!=null) result.add(res);
             if (res.has_value()) {
-                result.push_back(res);
+                result.push_back(std::move(res));
             }
+        };
+        if (isArray(arrayArg)) {
+            Utils::forEachItem(arrayArg, apply);
+        } else {
+            // Single value becomes single-element array (Java wrapping
+            // behavior)
+            apply(arrayArg);
         }
 
         // Java: return result;
@@ -1977,14 +1947,15 @@ std::any Functions::map(const Utils::JList& args) {
     }
 }
 
-std::any Functions::filter(const Utils::JList& args) {
+std::any Functions::filter(const Utils::JList& args,
+                           const EvalContext& context) {
     if (args.size() < 2) {
         return std::any{};  // Invalid arguments
     }
 
     // Extract array and predicate function
-    const auto& arrayArg = args[0];
-    const auto& predicateArg = args[1];
+    const auto& arrayArg = argument(args, 0);
+    const auto& predicateArg = argument(args, 1);
 
     // Handle null input
     if (!arrayArg.has_value()) {
@@ -1992,32 +1963,28 @@ std::any Functions::filter(const Utils::JList& args) {
     }
 
     try {
-        // Convert to vector if needed - handle both vector and JList
-        Utils::JList inputArray;
-        if (isArray(arrayArg)) {
-            inputArray = Utils::arrayify(arrayArg);
-        } else {
-            // Single value becomes single-element array
-            inputArray.push_back(arrayArg);
-        }
-
         Utils::JList result = Utils::createSequence();
 
-        // Iterate over the array and filter based on predicate
-        for (size_t i = 0; i < inputArray.size(); ++i) {
-            const auto& item = inputArray[i];
-
+        // Iterate over the array and filter based on predicate; only the
+        // items that pass are copied
+        int64_t i = 0;
+        auto test = [&](const std::any& item) {
             // Prepare arguments for the predicate function
-            auto funcArgs =
-                hofFuncArgs(predicateArg, item, static_cast<int64_t>(i), arrayArg);
+            auto funcArgs = hofFuncArgs(predicateArg, item, i++, arrayArg);
 
             // Apply the predicate function
-            auto res = funcApply(predicateArg, funcArgs);
+            auto res = funcApply(predicateArg, funcArgs, context);
             auto boolResult = toBoolean(res);
 
             if (boolResult && boolResult.value()) {
                 result.push_back(item);
             }
+        };
+        if (isArray(arrayArg)) {
+            Utils::forEachItem(arrayArg, test);
+        } else {
+            // Single value becomes single-element array
+            test(arrayArg);
         }
 
         return result;
@@ -2026,15 +1993,15 @@ std::any Functions::filter(const Utils::JList& args) {
     }
 }
 
-std::any Functions::foldLeft(const Utils::JList& args) {
+std::any Functions::foldLeft(const Utils::JList& args,
+                             const EvalContext& context) {
     if (args.size() < 2) {
         return std::any{};  // Invalid arguments
     }
 
     // Extract sequence, function, and optional initial value
-    const auto& sequenceArg = args[0];
-    const auto& funcArg = args[1];
-    std::any initArg = (args.size() >= 3) ? args[2] : std::any{};
+    const auto& sequenceArg = argument(args, 0);
+    const auto& funcArg = argument(args, 1);
 
     // Handle null input
     if (!sequenceArg.has_value()) {
@@ -2042,45 +2009,41 @@ std::any Functions::foldLeft(const Utils::JList& args) {
     }
 
     try {
-        // Convert to vector if needed - handle both vector and JList
-        Utils::JList sequence;
-        if (isArray(sequenceArg)) {
-            sequence = Utils::arrayify(sequenceArg);
-        } else {
-            // Single value becomes single-element array
-            sequence.push_back(sequenceArg);
-        }
-
         int64_t arity = getFunctionArity(funcArg);
         if (arity < 2) {
             // Match Java implementation exactly: throw JException("D3050", 1)
             throw JException("D3050", 1);
         }
 
-        std::any result;
-        size_t index;
-
-        if (!initArg.has_value() && !sequence.empty()) {
-            result = sequence[0];
-            index = 1;
-        } else {
-            result = initArg;
-            index = 0;
-        }
-
-        while (index < sequence.size()) {
+        // Without an initial value the first item seeds the result
+        std::any result = args.size() >= 3 ? argument(args, 2) : std::any{};
+        bool seeded = result.has_value();
+        int64_t index = 0;
+        auto fold = [&](const std::any& item) {
+            if (!seeded) {
+                result = item;
+                seeded = true;
+                index++;
+                return;
+            }
             Utils::JList funcArgs;
-            funcArgs.push_back(result);
-            funcArgs.push_back(sequence[index]);
+            funcArgs.push_back(std::move(result));
+            funcArgs.push_back(item);
             if (arity >= 3) {
-                funcArgs.push_back(static_cast<int64_t>(index));
+                funcArgs.push_back(index);
             }
             if (arity >= 4) {
                 funcArgs.push_back(sequenceArg);
             }
 
-            result = funcApply(funcArg, funcArgs);
+            result = funcApply(funcArg, funcArgs, context);
             index++;
+        };
+        if (isArray(sequenceArg)) {
+            Utils::forEachItem(sequenceArg, fold);
+        } else {
+            // Single value becomes single-element array
+            fold(sequenceArg);
         }
 
         return result;
@@ -2089,7 +2052,8 @@ std::any Functions::foldLeft(const Utils::JList& args) {
     }
 }
 
-std::any Functions::single(const Utils::JList& args) {
+std::any Functions::single(const Utils::JList& args,
+                           const EvalContext& context) {
     // Match Java implementation exactly (Functions.java lines 1627-1664)
     if (args.empty()) {
         return std::any{};  // Invalid arguments
@@ -2109,14 +2073,22 @@ std::any Functions::single(const Utils::JList& args) {
     }
 
     try {
-        // Convert to vector if needed - handle both vector and JList
-        Utils::JList inputArray;
-        if (isArray(arrayArg)) {
-            inputArray = Utils::arrayify(arrayArg);
-        } else {
-            // Single value becomes single-element array
-            inputArray.push_back(arrayArg);
+        // A list is read in place (the scan stops at the second match);
+        // anything else is converted once
+        Utils::JList converted;
+        const bool isList = arrayArg.type() == typeid(Utils::JList) &&
+                            !std::any_cast<const Utils::JList&>(arrayArg)
+                                 .isRange();
+        if (!isList) {
+            if (isArray(arrayArg)) {
+                converted = Utils::arrayify(arrayArg);
+            } else {
+                // Single value becomes single-element array
+                converted.push_back(arrayArg);
+            }
         }
+        const Utils::ItemVector& inputArray =
+            isList ? std::any_cast<const Utils::JList&>(arrayArg) : converted;
 
         // Java: var hasFoundMatch = false; Object result = null;
         bool hasFoundMatch = false;
@@ -2137,7 +2109,7 @@ std::any Functions::single(const Utils::JList& args) {
                     hofFuncArgs(funcArg, entry, static_cast<int64_t>(i), arrayArg);
 
                 // Java: var res = funcApply(func, func_args);
-                auto res = funcApply(funcArg, funcArgs);
+                auto res = funcApply(funcArg, funcArgs, context);
 
                 // Java: var booledValue = toBoolean(res); positiveResult =
                 // booledValue == null ? false : booledValue;
@@ -2230,55 +2202,56 @@ std::any Functions::append(const Utils::JList& args) {
         return std::any{};  // Invalid arguments
     }
 
-    auto arg1 = args[0];
-    auto arg2 = args[1];
+    std::any result = args[0];
+    appendTo(result, args[1]);
+    return result;
+}
 
+void Functions::appendTo(std::any& target, const std::any& value) {
     // Disregard undefined args
-    if (!arg1.has_value()) {
-        return arg2;
+    if (!value.has_value()) {
+        return;
     }
-    if (!arg2.has_value()) {
-        return arg1;
+    if (!target.has_value()) {
+        target = value;
+        return;
     }
 
-    try {
-        // Convert arguments to arrays if they aren't already
+    // Convert the target to a list it owns if it isn't one already
+    auto* list = std::any_cast<Utils::JList>(&target);
+    if (list == nullptr || list->isRange()) {
         Utils::JList array1;
-        if (isArray(arg1)) {
-            array1 = Utils::arrayify(arg1);
-        } else {
-            array1 = Utils::createSequence(arg1);
-        }
-
-        // Java shortcut (lines 2090-2091): if array1 is empty and arg2 is
-        // a range JList, return the range JList
-        if (array1.empty() && arg2.type() == typeid(Utils::JList)) {
-            auto jlist = std::any_cast<Utils::JList>(arg2);
-            if (jlist.isRange()) {
-                return arg2;
-            }
-        }
-
-        Utils::JList array2;
-        if (isArray(arg2)) {
-            array2 = Utils::arrayify(arg2);
+        if (isArray(target)) {
+            array1 = Utils::arrayify(std::move(target));
         } else {
-            array2.push_back(arg2);
+            array1.push_back(std::move(target));
         }
+        target = std::move(array1);
+        list = std::any_cast<Utils::JList>(&target);
+    }
 
-        // Create result array and append both arrays
-        // Java line 2093: arg1 = new JList<>((List)arg1); - creates a new
-        // regular JList (not sequence)
-        Utils::JList result;  // Start with fresh JList (no sequence flag)
-        result.insert(result.end(), array1.begin(),
-                      array1.end());  // Copy first array
-        result.insert(result.end(), array2.begin(),
-                      array2.end());  // Append second array
+    // Java shortcut (lines 2090-2091): if array1 is empty and arg2 is
+    // a range JList, return the range JList
+    if (list->empty() && value.type() == typeid(Utils::JList) &&
+        std::any_cast<const Utils::JList&>(value).isRange()) {
+        target = value;
+        return;
+    }
 
-        return result;
-    } catch (const std::bad_any_cast&) {
-        return std::any{};
+    if (isArray(value)) {
+        Utils::forEachItem(value,
+                           [&](const std::any& item) { list->push_back(item); });
+    } else {
+        list->push_back(value);
     }
+
+    // Java line 2093: arg1 = new JList<>((List)arg1); - the result is a
+    // regular JList (not sequence)
+    list->sequence = false;
+    list->outerWrapper = false;
+    list->tupleStream = false;
+    list->keepSingleton = false;
+    list->cons = false;
 }
 
 std::any Functions::spread(const Utils::JList& args) {
@@ -2332,7 +2305,8 @@ std::any Functions::spread(const Utils::JList& args) {
     }
 }
 
-std::any Functions::sift(const Utils::JList& args) {
+std::any Functions::sift(const Utils::JList& args,
+                          const EvalContext& context) {
     if (args.size() < 2) {
         return std::any{};  // Invalid arguments
     }
@@ -2360,7 +2334,7 @@ std::any Functions::sift(const Utils::JList& args) {
                                             entry.first, objectArg);
 
                 // Apply the predicate function
-                auto res = funcApply(predicateArg, funcArgs);
+                auto res = funcApply(predicateArg, funcArgs, context);
                 auto boolResult = toBoolean(res);
 
                 if (boolResult && boolResult.value()) {
@@ -2423,9 +2397,8 @@ void Functions::stringifyInternal(std::ostringstream& os, const std::any& arg,
             os << "]";
         } else if (arg.type() ==
                    typeid(nlohmann::ordered_map<std::string, std::any>)) {
-            auto map =
-                std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                    arg);
+            const auto& map = std::any_cast<
+                const nlohmann::ordered_map<std::string, std::any>&>(arg);
             os << "{";
             if (prettify && !map.empty()) os << "\n";
 
@@ -2672,7 +2645,7 @@ bool Functions::contains(const std::string& str, const std::any& token) {
     try {
         // Java lines 694-695: if (token instanceof String)
         if (token.type() == typeid(std::string)) {
-            const auto& searchStr = std::any_cast<std::string>(token);
+            const auto& searchStr = std::any_cast<const std::string&>(token);
             // Java line 695: result = (str.indexOf((String)token) != -1);
             return str.find(searchStr) != std::string::npos;
         }
@@ -2702,7 +2675,8 @@ bool Functions::contains(const std::string& str, const std::any& token) {
 std::optional<std::string> Functions::replace(const std::string& str,
                                               const std::any& pattern,
                                               const std::any& replacement,
-                                              int64_t limit) {
+                                              int64_t limit,
+                                              const EvalContext& context) {
     if (str.empty()) {
         return std::nullopt;
     }
@@ -2713,14 +2687,13 @@ std::optional<std::string> Functions::replace(const std::string& str,
             // Handle function-based replacement
             if (pattern.type() == typeid(std::regex)) {
                 auto regex = std::any_cast<std::regex>(pattern);
-                // Use thread-local instance (matching Java implementation)
-                return safeReplaceAllFn(str, regex, replacement);
+                return safeReplaceAllFn(str, regex, replacement, context);
             } else {
                 // Check if it's a regex object (stored as map with "type" =
                 // "regex")
                 try {
                     auto regex = std::any_cast<std::regex>(pattern);
-                    return safeReplaceAllFn(str, regex, replacement);
+                    return safeReplaceAllFn(str, regex, replacement, context);
                 } catch (const std::bad_any_cast&) {
                     // Not a regex object
                 }
@@ -2846,7 +2819,7 @@ std::optional<double> Functions::number(const std::any& arg) {
         throw JException("T0410", -1);
     }
     if (arg.type() == typeid(std::string)) {
-        const auto& str = std::any_cast<std::string>(arg);
+        const auto& str = std::any_cast<const std::string&>(arg);
 
         // Java reference line 1326: result = Double.valueOf((String)arg);
         // Double.valueOf("") throws NumberFormatException
@@ -2877,7 +2850,7 @@ std::optional<double> Functions::number(const std::any& arg) {
         }
         // Java reference line 1317-1326: else if (arg instanceof String)
         else if (arg.type() == typeid(std::string)) {
-            const auto& str = std::any_cast<std::string>(arg);
+            const auto& str = std::any_cast<const std::string&>(arg);
 
             // Handle special prefixes like Java implementation
             if (str.length() >= 2) {
@@ -3024,7 +2997,8 @@ Utils::JList Functions::keys(const std::any& arg) {
 
 bool Functions::exists(const std::any& arg) { return arg.has_value(); }
 
-std::any Functions::each(const std::any& obj, const std::any& func) {
+std::any Functions::each(const std::any& obj, const std::any& func,
+                          const EvalContext& context) {
     // Port exact logic from Java reference (Functions.java lines 1851-1868)
 
     // Java: if (obj==null) { return null; }
@@ -3051,7 +3025,7 @@ std::any Functions::each(const std::any& obj, const std::any& func) {
                 auto func_args = hofFuncArgs(func, value, key, obj);
 
                 // Java: var val = funcApply(func, func_args);
-                auto val = funcApply(func, func_args);
+                auto val = funcApply(func, func_args, context);
 
                 // Java: if(val != null) { result.add(val); }
                 if (val.has_value()) {
@@ -3908,8 +3882,7 @@ std::optional<std::string> Functions::formatNumber(
 
 // Context-aware sort function with lambda comparator support
 std::any Functions::sortWithContext(const Utils::JList& args,
-                                    const std::any& input,
-                                    std::shared_ptr<Frame> environment) {
+                                    const EvalContext& context) {
     // Java reference lines 1940-1942: undefined inputs always return undefined
     if (args.empty()) {
         return std::any{};  // Return null/undefined like Java
@@ -3945,17 +3918,6 @@ std::any Functions::sortWithContext(const Utils::JList& args,
         // funcApply
         auto comparator = args[1];
 
-        // Get current Jsonata instance for lambda invocation
-        auto instance = Jsonata::getCurrentInstance();
-        if (!instance) {
-            // Fallback to basic sort if no instance available
-            std::stable_sort(result.begin(), result.end(),
-                             [](const std::any& a, const std::any& b) {
-                                 return defaultComparator(a, b);
-                             });
-            return result;
-        }
-
         // Sort with lambda comparator using stable_sort - Java reference uses
         // stable sort
         std::stable_sort(
@@ -3967,8 +3929,10 @@ std::any Functions::sortWithContext(const Utils::JList& args,
                     // funcApply(comparator, Arrays.asList(o1, o2)); if (swap)
                     // return 1; else return -1;
                     Utils::JList compareArgs = {a, b};
-                    auto compareResult = instance->apply(
-                        comparator, compareArgs, input, environment);
+                    auto compareResult =
+                        context.instance.apply(comparator, compareArgs,
+                                               context.input,
+                                               context.environment);
 
                     // Convert result to boolean for comparison
                     // Java reference: if swap=true, return 1 (a > b), else
@@ -3990,19 +3954,16 @@ std::any Functions::sortWithContext(const Utils::JList& args,
                 }
             });
     } else {
-        // Natural ordering for homogeneous arrays - same logic as basic sort
-        // function
-        bool canSort = true;
+        // Natural ordering for homogeneous arrays. Each item is classified
+        // once; the keys read the items in place, so the items are only
+        // moved once the order is known
+        std::vector<Utils::OrderKey> keys(result.size());
         bool isAllNumbers = true;
         bool isAllStrings = true;
-
-        for (const auto& item : arrayToSort) {
-            if (!Utils::isNumeric(item)) {
-                isAllNumbers = false;
-            }
-            if (item.type() != typeid(std::string)) {
-                isAllStrings = false;
-            }
+        for (size_t i = 0; i < result.size(); i++) {
+            keys[i] = Utils::orderKey(result[i]);
+            isAllNumbers = isAllNumbers && keys[i].isNumber();
+            isAllStrings = isAllStrings && keys[i].isString();
         }
 
         if (!isAllNumbers && !isAllStrings) {
@@ -4014,11 +3975,36 @@ std::any Functions::sortWithContext(const Utils::JList& args,
                 "the second argument to specify a comparison function");
         }
 
-        // Natural ordering for homogeneous arrays - use stable_sort
-        std::stable_sort(result.begin(), result.end(),
-                         [](const std::any& a, const std::any& b) {
-                             return defaultComparator(a, b);
-                         });
+        std::vector<size_t> order(result.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        auto less = [&](size_t a, size_t b) {
+            return Utils::compareOrderKeys(keys[a], keys[b]) < 0;
+        };
+
+        // A predicate that only reads the first items, as in $sort(x)[0],
+        // gets them from a bounded heap selection; ties fall back to input
+        // order so they match the stable sort
+        size_t kept = order.size();
+        if (context.limit > 0 && context.limit < result.size()) {
+            kept = context.limit;
+            std::partial_sort(order.begin(), order.begin() + kept, order.end(),
+                              [&](size_t a, size_t b) {
+                                  int comp =
+                                      Utils::compareOrderKeys(keys[a], keys[b]);
+                                  return comp != 0 ? comp < 0 : a < b;
+                              });
+        } else {
+            std::stable_sort(order.begin(), order.end(), less);
+        }
+
+        Utils::JList sorted;
+        sorted.reserve(kept);
+        for (size_t i = 0; i < kept; i++) {
+            sorted.push_back(std::move(result[order[i]]));
+        }
+        return sorted;
     }
 
     return result;
@@ -4027,16 +4013,13 @@ std::any Functions::sortWithContext(const Utils::JList& args,
 // Helper function for default comparison logic
 bool Functions::defaultComparator(const std::any& a, const std::any& b) {
     try {
-        // Enhanced numeric type handling to fix case004
-        if (Utils::isNumeric(a) && Utils::isNumeric(b)) {
-            double valA = Utils::toDouble(a);
-            double valB = Utils::toDouble(b);
-
-            return valA < valB;
-        } else if (a.type() == typeid(std::string) &&
-                   b.type() == typeid(std::string)) {
-            return std::any_cast<std::string>(a) <
-                   std::any_cast<std::string>(b);
+        // Two numbers or two strings go through the ordering kernel shared
+        // with the comparison operators and order-by
+        Utils::OrderKey keyA = Utils::orderKey(a);
+        Utils::OrderKey keyB = Utils::orderKey(b);
+        if ((keyA.isNumber() && keyB.isNumber()) ||
+            (keyA.isString() && keyB.isString())) {
+            return Utils::compareOrderKeys(keyA, keyB) < 0;
         } else {
             // Mixed types - convert to strings for comparison
             // Java reference: toString() comparison for mixed types
@@ -4084,24 +4067,26 @@ std::any Functions::lookup(const std::any& input, const std::string& key) {
         if (isArray(input)) {
             // Java: if (input instanceof List) - create sequence and lookup
             // recursively
-            const auto& vec = Utils::arrayify(input);
+            // The input is read in place and nested results are moved in,
+            // so the lookup is linear in the size of its result
             Utils::JList result = Utils::createSequence();
 
-            for (size_t i = 0; i < vec.size(); i++) {
+            Utils::forEachItem(input, [&](const std::any& item) {
                 auto res =
-                    lookup(vec[i], key);  // Recursive call like Java reference
+                    lookup(item, key);  // Recursive call like Java reference
                 if (res.has_value()) {
                     if (isArray(res)) {
                         // Java: if (res instanceof List) - addAll
-                        auto resVec = Utils::arrayify(res);
-                        result.insert(result.end(), resVec.begin(),
-                                      resVec.end());
+                        auto resVec = Utils::arrayify(std::move(res));
+                        result.insert(result.end(),
+                                      std::make_move_iterator(resVec.begin()),
+                                      std::make_move_iterator(resVec.end()));
                     } else {
                         // Java: else - add single element
-                        result.push_back(res);
+                        result.push_back(std::move(res));
                     }
                 }
-            }
+            });
 
             return result.empty() ? std::any{} : std::any(result);
         } else if (input.type() ==
@@ -4904,7 +4889,8 @@ std::optional<int64_t> Functions::parseInteger(const std::string& value,
 }
 
 std::any Functions::functionEval(const std::string& expr,
-                                 const std::any& focus) {
+                                 const std::any& focus,
+                                 const EvalContext& context) {
     // Java reference lines 2366-2402: parses and evaluates the supplied
     // expression
 
@@ -4914,12 +4900,8 @@ std::any Functions::functionEval(const std::string& expr,
     }
 
     // Java reference line 2371: Object input = Jsonata.current.get().input;
-    auto currentInstance = Jsonata::getCurrentInstance();
-    if (!currentInstance) {
-        throw JException("D3121", -1, "No Jsonata context available");
-    }
-
-    std::any input = currentInstance->getCurrentInput();
+    // here the input at the call site
+    std::any input = context.input;
 
     // Java reference lines 2372-2379: if(focus != null) handle focus input
     if (focus.has_value()) {
@@ -4935,7 +4917,7 @@ std::any Functions::functionEval(const std::string& expr,
 
     // Java reference line 2382: Jsonata.Frame env =
     // Jsonata.current.get().environment;
-    auto env = currentInstance->getCurrentEnvironment();
+    auto env = context.environment;
 
     try {
         // Java reference line 2384: ast = jsonata(expr);
@@ -4958,9 +4940,10 @@ std::any Functions::functionEval(const std::string& expr,
 
         try {
             // Java reference line 2393: result =
-            // Jsonata.current.get().evaluate(ast.ast, input, env); Use CURRENT
-            // instance to evaluate the parsed AST with current context
-            auto result = currentInstance->evaluate(expressionAst, input, env);
+            // Jsonata.current.get().evaluate(ast.ast, input, env); Use the
+            // calling instance to evaluate the parsed AST with its context
+            auto result =
+                context.instance.evaluate(expressionAst, input, env);
             return result;
         } catch (const JException&) {
             // Re-throw JSONata exceptions as-is
@@ -5343,7 +5326,8 @@ std::string Functions::safeReplaceFirst(const std::string& str,
 
 std::string Functions::safeReplaceAllFn(const std::string& str,
                                         const std::regex& pattern,
-                                        const std::any& func) {
+                                        const std::any& func,
+                                        const EvalContext& context) {
     // Following Java implementation: Functions.java lines 844-859
     std::string result = str;
     std::sregex_iterator matchIter(str.begin(), str.end(), pattern);
@@ -5360,20 +5344,10 @@ std::string Functions::safeReplaceAllFn(const std::string& str,
             // toJsonataMatch)
             auto jsonataMatch = toJsonataMatch(match);
 
-            // Apply function with match as argument (equivalent to Java's
-            // funcApply) Use thread-local instance like Java implementation
-            auto jsonataInstance = Jsonata::getCurrentInstance();
-            if (!jsonataInstance) {
-                throw JException(
-                    "D3012", 0,
-                    "No current Jsonata instance available for function call");
-            }
-
+            // Apply function with match as argument (Java's funcApply passes
+            // null as input and the main environment)
             Utils::JList args = {jsonataMatch};
-            // Match Java implementation: funcApply passes null as input and
-            // main environment
-            auto functionResult = jsonataInstance->apply(
-                func, args, std::any{}, jsonataInstance->getEnvironment());
+            auto functionResult = funcApply(func, args, context);
 
             // Check if result is a string (Java lines 849-852)
             if (functionResult.type() == typeid(std::string)) {
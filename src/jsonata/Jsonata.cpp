@@ -20,12 +20,17 @@
 
 #include <algorithm>
 #include <cmath>
+#include <deque>
 #include <iostream>
 #include <mutex>
 #include <regex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
 
 #include "jsonata/Functions.h"
 #include "jsonata/JException.h"
+#include "jsonata/Optimizer.h"
 #include "jsonata/Timebox.h"
 #include "jsonata/Utils.h"
 
@@ -49,20 +54,15 @@ void Jsonata::initializeBuiltinFunctions(std::shared_ptr<Frame> frame) {
     for (const auto& [name, entry] : registryWithSignatures) {
         JFunction jfunc;
 
-        // Special handling for higher-order functions that need context access
-        if (name == "sort") {
-            // Sort function needs access to apply method for lambda comparators
-            jfunc.implementation = [](const Utils::JList& args,
-                                      const std::any& input,
-                                      std::shared_ptr<Frame> env) -> std::any {
-                return Functions::sortWithContext(args, input, env);
-            };
+        if (entry.contextImplementation) {
+            // Higher-order functions, $eval and $sort call back into the
+            // evaluator through the context
+            jfunc.implementation = entry.contextImplementation;
         } else {
             // Copy entry to avoid C++20 structured binding capture issue
             auto entryImpl = entry.implementation;
             jfunc.implementation = [entryImpl](const Utils::JList& args,
-                                               const std::any& input,
-                                               std::shared_ptr<Frame> env) {
+                                               const EvalContext&) {
                 return entryImpl(args);
             };
         }
@@ -70,51 +70,421 @@ void Jsonata::initializeBuiltinFunctions(std::shared_ptr<Frame> frame) {
         // Create signature object from signature string
         jfunc.signature =
             std::make_shared<jsonata::utils::Signature>(entry.signature, name);
-        frame->bind(name, std::any(jfunc));
+        frame->bind(Frame::slotOf(name), std::any(jfunc));
     }
 }
 
 // Frame implementation
-Frame::Frame() : parent_(nullptr), timeout_(0), recursionDepth_(0) {
-    timestamp_ = std::chrono::steady_clock::now();
-}
+Frame::Frame() : parent_(nullptr), timeout_(0), recursionDepth_(0) {}
 
 Frame::Frame(std::shared_ptr<Frame> enclosingEnvironment)
-    : parent_(enclosingEnvironment), timeout_(0), recursionDepth_(0) {
-    timestamp_ = std::chrono::steady_clock::now();
+    : Frame(enclosingEnvironment,
+            enclosingEnvironment ? enclosingEnvironment->arena_ : nullptr) {}
+
+Frame::Frame(std::shared_ptr<Frame> enclosingEnvironment,
+             std::shared_ptr<EvaluationArena> arena)
+    : arena_(std::move(arena)),
+      parent_(std::move(enclosingEnvironment)),
+      slots_(arena_ ? static_cast<std::pmr::memory_resource*>(arena_.get())
+                    : std::pmr::get_default_resource()),
+      index_(slots_.get_allocator()),
+      timeout_(0),
+      recursionDepth_(0) {
+    if (parent_) {
+        root_ = parent_->root_;
+    }
+}
+
+Frame::~Frame() = default;
+
+Frame::InvariantValues* Frame::getInvariants() {
+    if (root_ == nullptr) {
+        return nullptr;
+    }
+    auto& invariants = root_->invariants_;
+    if (!invariants) {
+        invariants = std::make_unique<InvariantValues>();
+    }
+    return invariants.get();
+}
+
+namespace {
+
+// Frames with more bindings than this switch from a linear scan to a slot
+// index
+constexpr size_t kIndexedFrameThreshold = 8;
+
+struct SlotTable {
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, Frame::Slot> ids;
+    std::deque<std::string> names;  // stable references for nameOf()
+};
+
+SlotTable& slotTable() {
+    static SlotTable table;
+    return table;
+}
+
+bool isEmptyArray(const std::any& value) {
+    if (value.type() == typeid(Utils::JList)) {
+        return std::any_cast<const Utils::JList&>(value).empty();
+    }
+    return value.type() == typeid(std::vector<std::any>) &&
+           std::any_cast<const std::vector<std::any>&>(value).empty();
+}
+
+}  // namespace
+
+/* static */ Frame::Slot Frame::findSlot(const std::string& name) {
+    auto& table = slotTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    auto it = table.ids.find(name);
+    return it != table.ids.end() ? it->second : kNoSlot;
+}
+
+/* static */ Frame::Slot Frame::slotOf(const std::string& name) {
+    Slot slot = findSlot(name);
+    if (slot != kNoSlot) {
+        return slot;
+    }
+    auto& table = slotTable();
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    auto [it, inserted] =
+        table.ids.emplace(name, static_cast<Slot>(table.names.size()));
+    if (inserted) {
+        table.names.push_back(name);
+    }
+    return it->second;
+}
+
+/* static */ const std::string& Frame::nameOf(Slot slot) {
+    auto& table = slotTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    return table.names.at(slot);
+}
+
+const std::any* Frame::find(Slot slot) const {
+    const std::any* value = findLocal(slot);
+    if (value == nullptr && tuple_ != nullptr) {
+        value = tuple_->find(slot);
+    }
+    if (value == nullptr && !named_.empty() && slot >= namedFrom_) {
+        value = findNamed(nameOf(slot));
+    }
+    return value;
+}
+
+const std::any* Frame::findNamed(const std::string& name) const {
+    for (const auto& [bound, value] : named_) {
+        if (bound == name) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
+size_t Frame::position(Slot slot) const {
+    if (!index_.empty()) {
+        auto it = index_.find(slot);
+        return it != index_.end() ? it->second : kNoPosition;
+    }
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (slots_[i].first == slot) {
+            return i;
+        }
+    }
+    return kNoPosition;
+}
+
+const std::any* Frame::findLocal(Slot slot) const {
+    size_t i = position(slot);
+    return i != kNoPosition ? &slots_[i].second : nullptr;
+}
+
+std::any* Frame::findLocal(Slot slot) {
+    size_t i = position(slot);
+    return i != kNoPosition ? &slots_[i].second : nullptr;
+}
+
+void Frame::bind(Slot slot, const std::any& value) {
+    if (std::any* existing = findLocal(slot)) {
+        *existing = value;
+        return;
+    }
+    if (!named_.empty() && slot >= namedFrom_) {
+        // The name was bound before an expression interned it
+        const std::string& name = nameOf(slot);
+        named_.erase(std::remove_if(named_.begin(), named_.end(),
+                                    [&name](const auto& binding) {
+                                        return binding.first == name;
+                                    }),
+                     named_.end());
+    }
+    slots_.emplace_back(slot, value);
+    if (slots_.size() > kIndexedFrameThreshold) {
+        if (index_.empty()) {
+            for (size_t i = 0; i < slots_.size(); ++i) {
+                index_.emplace(slots_[i].first, i);
+            }
+        } else {
+            index_.emplace(slot, slots_.size() - 1);
+        }
+    }
+}
+
+const Frame* Frame::bindingFrame(Slot slot) const {
+    for (const Frame* frame = this; frame != nullptr;
+         frame = frame->parent_.get()) {
+        if (frame->find(slot) != nullptr) {
+            return frame;
+        }
+    }
+    return nullptr;
+}
+
+std::any Frame::lookup(Slot slot) const {
+    for (const Frame* frame = this; frame != nullptr;
+         frame = frame->parent_.get()) {
+        if (const std::any* value = frame->find(slot)) {
+            return *value;
+        }
+    }
+    return std::any{};  // null
+}
+
+std::any Frame::lookupFree(Slot slot, uint32_t scope) const {
+    // The frames between this one and the root are the evaluator's own
+    // (blocks, lambda calls, tuple bindings), which bind only names the
+    // expression binds. Expressions evaluated here under another root
+    // ($eval) have another scope and search every frame
+    if (root_ != nullptr && root_->scope_ == scope) {
+        return root_->lookup(slot);
+    }
+    return lookup(slot);
 }
 
 void Frame::bind(const std::string& name, const std::any& value) {
-    bindings_[name] = value;
+    Slot slot = findSlot(name);
+    if (slot != kNoSlot) {
+        bind(slot, value);
+        return;
+    }
+    for (auto& binding : named_) {
+        if (binding.first == name) {
+            binding.second = value;
+            return;
+        }
+    }
+    if (named_.empty()) {
+        auto& table = slotTable();
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        namedFrom_ = static_cast<Slot>(table.names.size());
+    }
+    named_.emplace_back(name, value);
 }
 
 std::any Frame::lookup(const std::string& name) const {
-    auto it = bindings_.find(name);
-    if (it != bindings_.end()) {
-        return it->second;
+    Slot slot = findSlot(name);
+    if (slot != kNoSlot) {
+        return lookup(slot);
+    }
+    // Not interned: only bound by name, if at all
+    for (const Frame* frame = this; frame != nullptr;
+         frame = frame->parent_.get()) {
+        if (const std::any* value = frame->findNamed(name)) {
+            return *value;
+        }
     }
-    if (parent_) {
-        return parent_->lookup(name);
+    return std::any{};
+}
+
+void Frame::bindAll(const Frame& other) {
+    for (const auto& [slot, value] : other.slots_) {
+        bind(slot, value);
     }
-    return std::any{};  // null
+    for (const auto& [name, value] : other.named_) {
+        bind(name, value);
+    }
+}
+
+nlohmann::ordered_map<std::string, std::any> Frame::getBindings() const {
+    nlohmann::ordered_map<std::string, std::any> bindings;
+    if (tuple_ != nullptr) {
+        for (const auto& [slot, value] : tuple_->bindings) {
+            bindings[nameOf(slot)] = *value;
+        }
+    }
+    for (const auto& [name, value] : named_) {
+        bindings[name] = value;
+    }
+    for (const auto& [slot, value] : slots_) {
+        bindings[nameOf(slot)] = value;
+    }
+    return bindings;
+}
+
+void Frame::borrowTuple(const Tuple* tuple) {
+    slots_.clear();
+    index_.clear();
+    isParallelCall = false;
+    tuple_ = tuple;
+}
+
+void Frame::adoptTuple() {
+    if (tuple_ == nullptr) {
+        return;
+    }
+    const Tuple* tuple = tuple_;
+    tuple_ = nullptr;
+    for (const auto& [slot, value] : tuple->bindings) {
+        if (findLocal(slot) == nullptr) {
+            bind(slot, *value);
+        }
+    }
+}
+
+const std::any* Tuple::find(Frame::Slot slot) const {
+    for (const auto& [bound, value] : bindings) {
+        if (bound == slot) {
+            return value.get();
+        }
+    }
+    return nullptr;
+}
+
+void Tuple::bind(Frame::Slot slot, Value value) {
+    for (auto& binding : bindings) {
+        if (binding.first == slot) {
+            binding.second = std::move(value);
+            return;
+        }
+    }
+    bindings.emplace_back(slot, std::move(value));
+}
+
+namespace {
+
+// Forwards to several observers installed on the same frame
+class ObserverChain : public EvaluationObserver {
+  public:
+    explicit ObserverChain(const std::vector<EvaluationObserver*>& observers)
+        : observers_(observers) {}
+
+    void onEvaluateEntry(const std::shared_ptr<Parser::Symbol>& expr,
+                         const std::any& input,
+                         const std::shared_ptr<Frame>& environment) override {
+        for (auto* observer : observers_) {
+            observer->onEvaluateEntry(expr, input, environment);
+        }
+    }
+
+    void onEvaluateExit(const std::shared_ptr<Parser::Symbol>& expr,
+                        const std::any& input,
+                        const std::shared_ptr<Frame>& environment,
+                        const std::any& result) override {
+        for (auto* observer : observers_) {
+            observer->onEvaluateExit(expr, input, environment, result);
+        }
+    }
+
+  private:
+    const std::vector<EvaluationObserver*>& observers_;
+};
+
+// Adapts the std::function callbacks of Frame::setEvaluate*Callback
+class CallbackObserver : public EvaluationObserver {
+  public:
+    EntryCallback entry;
+    ExitCallback exit;
+
+    void onEvaluateEntry(const std::shared_ptr<Parser::Symbol>& expr,
+                         const std::any& input,
+                         const std::shared_ptr<Frame>& environment) override {
+        if (entry) entry(expr, input, environment);
+    }
+
+    void onEvaluateExit(const std::shared_ptr<Parser::Symbol>& expr,
+                        const std::any& input,
+                        const std::shared_ptr<Frame>& environment,
+                        const std::any& result) override {
+        if (exit) exit(expr, input, environment, result);
+    }
+};
+
+}  // namespace
+
+void Frame::addObserver(EvaluationObserver* observer) {
+    observers_.push_back(observer);
+    updateObserver();
+}
+
+void Frame::removeObserver(EvaluationObserver* observer) {
+    observers_.erase(
+        std::remove(observers_.begin(), observers_.end(), observer),
+        observers_.end());
+    updateObserver();
+}
+
+void Frame::updateObserver() {
+    if (observers_.size() > 1) {
+        if (!observerChain_) {
+            observerChain_ = std::make_unique<ObserverChain>(observers_);
+        }
+        observer_ = observerChain_.get();
+    } else {
+        observer_ = observers_.empty() ? nullptr : observers_.front();
+    }
+}
+
+EvaluationObserver* Frame::getObserver() const {
+    // Not copied into child frames: an ancestor may replace or remove its
+    // observers (setRuntimeBounds) while frames created from it live on
+    for (const Frame* frame = this; frame != nullptr;
+         frame = frame->parent_.get()) {
+        if (frame->observer_ != nullptr) {
+            return frame->observer_;
+        }
+        if (frame->observerSource_) {
+            if (auto* observer = frame->observerSource_->getObserver()) {
+                return observer;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void Frame::observeFrom(std::shared_ptr<const Frame> source) {
+    observerSource_ = std::move(source);
 }
 
 void Frame::setRuntimeBounds(int64_t timeout, int64_t maxRecursionDepth) {
     timeout_ = timeout;
     recursionDepth_ = maxRecursionDepth;
     // Create Timebox to handle recursion depth checking (Java reference logic)
-    // Each frame gets its own timebox instance
-    auto timebox = std::make_unique<Timebox>(*this, timeout, maxRecursionDepth);
-    // Keep the timebox alive by storing a reference (avoiding static)
-    timebox_ = std::move(timebox);
+    // Each frame gets its own timebox instance; it registers itself as an
+    // observer of this frame
+    if (timebox_) {
+        removeObserver(timebox_.get());
+    }
+    timebox_ = std::make_unique<Timebox>(*this, timeout, maxRecursionDepth);
 }
 
 void Frame::setEvaluateEntryCallback(EntryCallback callback) {
-    entryCallback_ = callback;
+    if (!callbacks_) {
+        callbacks_ = std::make_unique<CallbackObserver>();
+        addObserver(callbacks_.get());
+    }
+    static_cast<CallbackObserver*>(callbacks_.get())->entry =
+        std::move(callback);
 }
 
 void Frame::setEvaluateExitCallback(ExitCallback callback) {
-    exitCallback_ = callback;
+    if (!callbacks_) {
+        callbacks_ = std::make_unique<CallbackObserver>();
+        addObserver(callbacks_.get());
+    }
+    static_cast<CallbackObserver*>(callbacks_.get())->exit =
+        std::move(callback);
 }
 
 // Jsonata implementation
@@ -134,6 +504,12 @@ std::shared_ptr<Frame> Jsonata::createFrame() {
 
 std::shared_ptr<Frame> Jsonata::createFrame(
     std::shared_ptr<Frame> enclosingEnvironment) {
+    // Frames of an evaluation come from its arena
+    if (enclosingEnvironment && enclosingEnvironment->getArena()) {
+        return std::allocate_shared<Frame>(
+            ArenaAllocator<Frame>(enclosingEnvironment->getArena()),
+            enclosingEnvironment);
+    }
     return std::make_shared<Frame>(enclosingEnvironment);
 }
 
@@ -147,12 +523,48 @@ std::shared_ptr<Parser::Symbol> Jsonata::parse(const std::string& expression) {
     return parser_->parse(expression);
 }
 
+CompiledExpression Jsonata::compile() const {
+    // The compiled expression keeps its own instance sharing this one's AST
+    // and environment, so it stays valid independently of this object
+    auto instance = std::make_shared<Jsonata>(*this);
+    instance->validateInput_ = validateInput_;
+    return CompiledExpression(instance, vm::compile(expression_));
+}
+
 std::any Jsonata::evaluate(std::shared_ptr<Parser::Symbol> expr,
                            const std::any& input,
                            std::shared_ptr<Frame> environment) {
     // Thread safety: Make sure each evaluate is executed on an instance per
     // thread
-    return getPerThreadInstance()->_evaluate(expr, input, environment);
+    Jsonata* instance = getPerThreadInstance();
+    if (expr && expr->invariant) {
+        return instance->evaluateInvariant(expr, input, environment);
+    }
+    return instance->_evaluate(expr, input, environment);
+}
+
+std::any Jsonata::evaluateInvariant(const std::shared_ptr<Parser::Symbol>& expr,
+                                    const std::any& input,
+                                    const std::shared_ptr<Frame>& environment) {
+    // The first evaluation computes the value for the rest of this
+    // evaluation, unless a builtin it calls has been rebound; errors are
+    // not kept, so they surface wherever the subexpression is reached
+    auto* invariants = environment->getInvariants();
+    if (invariants == nullptr) {
+        return _evaluate(expr, input, environment);
+    }
+    auto found = invariants->find(expr);
+    if (found != invariants->end()) {
+        return found->second;
+    }
+    for (const auto& procedure : expr->invariantCalls) {
+        if (!callsBuiltin(procedure, environment)) {
+            return _evaluate(expr, input, environment);
+        }
+    }
+    std::any value = _evaluate(expr, input, environment);
+    invariants->emplace(expr, value);
+    return value;
 }
 
 std::any Jsonata::_evaluate(std::shared_ptr<Parser::Symbol> expr,
@@ -166,135 +578,122 @@ std::any Jsonata::_evaluate(std::shared_ptr<Parser::Symbol> expr,
 
     std::any result;
 
-    // Store current input and environment in thread-local context
-    tls_input_ = input;
-    tls_environment_ = environment;
-
-    // Entry callback
-    auto entryCallback = environment->lookup("__evaluate_entry");
-    if (entryCallback.has_value()) {
-        try {
-            auto callback = std::any_cast<EntryCallback>(entryCallback);
-            callback(expr, input, environment);
-        } catch (const std::bad_any_cast&) {
-            // Ignore invalid callback
-        }
-    }
-
-    // Main evaluation dispatch based on expression type
-    const std::string& type = expr->type;
-    // Debug output removed
-
-    if (type == "string" || type == "number" ||
-        type == "value") {
-        result = evaluateLiteral(expr);
-    } else if (type == "name") {
-        result = evaluateName(expr, input, environment);
-    } else if (type == "variable") {
-        result = evaluateVariable(expr, input, environment);
-    } else if (type == "binary") {
-        result = evaluateBinary(expr, input, environment);
-    } else if (type == "unary") {
-        result = evaluateUnary(expr, input, environment);
-    } else if (type == "function") {
-        result = evaluateFunction(expr, input, environment);
-    } else if (type == "regex") {
-        result = evaluateRegex(expr, input, environment);
-    } else if (type == "wildcard") {
-        result = evaluateWildcard(expr, input);
-    } else if (type == "path") {
-        result = evaluatePath(expr, input, environment);
-    } else if (type == "condition") {
-        result = evaluateCondition(expr, input, environment);
-    } else if (type == "descendant") {
-        result = evaluateDescendant(expr, input, environment);
-    } else if (type == "apply") {
-        result = evaluateApply(expr, input, environment);
-    } else if (type == "bind") {
-        result = evaluateBind(expr, input, environment);
-    } else if (type == "lambda") {
-        result = evaluateLambda(expr, input, environment);
-    } else if (type == "transform") {
-        result = evaluateTransform(expr, input, environment);
-    } else if (type == "parent") {
-        result = evaluateParent(expr, input, environment);
-    } else if (type == "block") {
-        result = evaluateBlock(expr, input, environment);
-    } else if (type == "partial") {
-        // Following exact Java logic for partial applications
-        result = evaluatePartialApplication(expr, input, environment);
-    } else {
-        // Unsupported expression type - return null for now
-        result = std::any{};
+    // Entry hook (e.g. Timebox); a single pointer check when none is set
+    EvaluationObserver* observer = environment->getObserver();
+    if (observer != nullptr) {
+        observer->onEvaluateEntry(expr, input, environment);
+    }
+
+    // Main evaluation dispatch based on the node kind resolved by the parser
+    const Parser::NodeType type = expr->nodeType();
+
+    switch (type) {
+        case Parser::NodeType::String:
+        case Parser::NodeType::Number:
+        case Parser::NodeType::Value:
+            // Literals folded from builtin calls carry those calls in
+            // arguments (see Optimizer.h)
+            result = expr->arguments.empty()
+                         ? evaluateLiteral(expr)
+                         : evaluateFoldedLiteral(expr, input, environment);
+            break;
+        case Parser::NodeType::Name:
+            result = evaluateName(expr, input, environment);
+            break;
+        case Parser::NodeType::Variable:
+            result = evaluateVariable(expr, input, environment);
+            break;
+        case Parser::NodeType::Binary:
+            result = evaluateBinary(expr, input, environment);
+            break;
+        case Parser::NodeType::Unary:
+            result = evaluateUnary(expr, input, environment);
+            break;
+        case Parser::NodeType::Function:
+            result = evaluateFunction(expr, input, environment);
+            break;
+        case Parser::NodeType::Regex:
+            result = evaluateRegex(expr, input, environment);
+            break;
+        case Parser::NodeType::Wildcard:
+            result = evaluateWildcard(expr, input);
+            break;
+        case Parser::NodeType::Path:
+            result = evaluatePath(expr, input, environment);
+            break;
+        case Parser::NodeType::Condition:
+            result = evaluateCondition(expr, input, environment);
+            break;
+        case Parser::NodeType::Descendant:
+            result = evaluateDescendant(expr, input, environment);
+            break;
+        case Parser::NodeType::Apply:
+            result = evaluateApply(expr, input, environment);
+            break;
+        case Parser::NodeType::Bind:
+            result = evaluateBind(expr, input, environment);
+            break;
+        case Parser::NodeType::Lambda:
+            result = evaluateLambda(expr, input, environment);
+            break;
+        case Parser::NodeType::Transform:
+            result = evaluateTransform(expr, input, environment);
+            break;
+        case Parser::NodeType::Parent:
+            result = evaluateParent(expr, input, environment);
+            break;
+        case Parser::NodeType::Block:
+            result = evaluateBlock(expr, input, environment);
+            break;
+        case Parser::NodeType::Partial:
+            // Following exact Java logic for partial applications
+            result = evaluatePartialApplication(expr, input, environment);
+            break;
+        default:
+            // Unsupported expression type - return null for now
+            result = std::any{};
+            break;
     }
 
     // Apply predicates if present - matches Java lines 210-213
     if (!expr->predicate.empty()) {
-        for (const auto& pred : expr->predicate) {
-            // Extract the predicate expression from pred->expr (matches Java:
-            // pred.expr)
-            if (pred && pred->expr.has_value()) {
-                try {
-                    auto predicateExpr =
-                        std::any_cast<std::shared_ptr<Parser::Symbol>>(
-                            pred->expr);
-                    result = evaluateFilter(predicateExpr, result, environment);
-                } catch (const std::bad_any_cast&) {
-                    // Skip invalid predicate
-                }
-            }
-        }
+        result = evaluateStages(expr->predicate, std::move(result), environment);
     }
 
     // Apply group expression if present - matches Java lines 215-217
     // Java: if (!expr.type.equals("path") && expr.group!=null)
-    if (type != "path" && expr->group != nullptr) {
+    if (type != Parser::NodeType::Path && expr->group != nullptr) {
         result = evaluateGroupExpression(expr->group, result, environment);
     }
 
-    // Exit callback
-    auto exitCallback = environment->lookup("__evaluate_exit");
-    if (exitCallback.has_value()) {
-        try {
-            auto callback = std::any_cast<ExitCallback>(exitCallback);
-            callback(expr, input, environment, result);
-        } catch (const std::bad_any_cast&) {
-            // Ignore invalid callback
-        }
+    // Exit hook
+    if (observer != nullptr) {
+        observer->onEvaluateExit(expr, input, environment, result);
     }
 
     // Result mangling - matches Java lines 225-235
-    // mangle result (list of 1 element -> 1 element, empty list -> null)
-    bool isArrayConstructor = expr && expr->type == "unary" &&
-                              expr->value.has_value() &&
-                              expr->value.type() == typeid(std::string) &&
-                              std::any_cast<std::string>(expr->value) == "[";
+    return finishResult(std::move(result), expr->keepArray);
+}
 
+/* static */ std::any Jsonata::finishResult(std::any result, bool keepArray) {
+    // mangle result (list of 1 element -> 1 element, empty list -> null)
     if (result.has_value() && Utils::isSequence(result)) {
-        try {
-            auto _result = std::any_cast<Utils::JList>(result);
-            if (!_result.tupleStream) {
-                if (expr->keepArray) {
-                    _result.keepSingleton = true;
-                }
-                if (_result.empty()) {
-                    result = std::any{};  // Java: result = null
-                } else if (_result.size() == 1) {
-                    result = _result.keepSingleton
-                                 ? std::any(_result)
-                                 : _result[0];  // Java: result =
-                                                // _result.keepSingleton ?
-                                                // _result : _result.get(0)
-                }
-                // If we modified keepSingleton but didn't change result, update
-                // it with the modified JList
-                if (expr->keepArray && !_result.empty() &&
-                    _result.size() != 1) {
-                    result = std::any(_result);
-                }
+        // Adjust the sequence in place rather than through a copy
+        auto* _result = std::any_cast<Utils::JList>(&result);
+        if (_result != nullptr && !_result->tupleStream) {
+            if (keepArray) {
+                _result->keepSingleton = true;
+            }
+            if (_result->empty()) {
+                result = std::any{};  // Java: result = null
+            } else if (_result->size() == 1 && !_result->keepSingleton) {
+                // Java: result = _result.keepSingleton ? _result :
+                // _result.get(0)
+                std::any item = _result->isRange()
+                                    ? std::as_const(*_result)[0]
+                                    : std::move(_result->front());
+                result = std::move(item);
             }
-        } catch (const std::bad_any_cast&) {
-            // If cast fails, leave result unchanged
         }
     }
 
@@ -312,6 +711,26 @@ std::any Jsonata::evaluateLiteral(std::shared_ptr<Parser::Symbol> expr) {
     }
 }
 
+std::any Jsonata::evaluateFoldedLiteral(std::shared_ptr<Parser::Symbol> expr,
+                                        const std::any& input,
+                                        std::shared_ptr<Frame> environment) {
+    // The value stands only while every builtin it was computed with is
+    // still the one in scope; registerFunction or evaluation bindings may
+    // have replaced it, in which case the original subtree runs
+    for (const auto& procedure : expr->arguments) {
+        if (!callsBuiltin(procedure, environment)) {
+            return evaluate(expr->body, input, environment);
+        }
+    }
+    return evaluateLiteral(expr);
+}
+
+bool Jsonata::callsBuiltin(const std::shared_ptr<Parser::Symbol>& procedure,
+                           const std::shared_ptr<Frame>& environment) {
+    return environment->bindingFrame(procedure->variableSlot()) ==
+           getStaticFrame().get();
+}
+
 std::any Jsonata::evaluateName(std::shared_ptr<Parser::Symbol> expr,
                                const std::any& input,
                                std::shared_ptr<Frame> environment) {
@@ -335,7 +754,7 @@ std::any Jsonata::evaluateVariable(std::shared_ptr<Parser::Symbol> expr,
                                    const std::any& input,
                                    std::shared_ptr<Frame> environment) {
     try {
-        std::string varName = std::any_cast<std::string>(expr->value);
+        const auto& varName = std::any_cast<const std::string&>(expr->value);
 
         // Java reference: if the variable name is empty string, then it refers
         // to context value Java: expr.value.equals("") means standalone "$"
@@ -344,7 +763,7 @@ std::any Jsonata::evaluateVariable(std::shared_ptr<Parser::Symbol> expr,
             // Java: result = input instanceof JList &&
             // ((JList)input).outerWrapper ? ((JList)input).get(0) : input;
             if (input.type() == typeid(Utils::JList)) {
-                auto jlist = std::any_cast<Utils::JList>(input);
+                const auto& jlist = std::any_cast<const Utils::JList&>(input);
                 if (jlist.outerWrapper) {
                     // Java calls ((JList)input).get(0) which returns the
                     // ORIGINAL input that was wrapped For wrapped empty array
@@ -361,7 +780,12 @@ std::any Jsonata::evaluateVariable(std::shared_ptr<Parser::Symbol> expr,
             return input;
         } else {
             // Java reference: lookup variable name in environment (line 1293)
-            return environment->lookup(varName);
+            // using the slot the parser resolved for this name
+            if (expr->freeVariable) {
+                return environment->lookupFree(expr->variableSlot(),
+                                               expr->scope);
+            }
+            return environment->lookup(expr->variableSlot());
         }
     } catch (const std::bad_any_cast&) {
         return std::any{};
@@ -377,55 +801,71 @@ std::any Jsonata::evaluateBinary(std::shared_ptr<Parser::Symbol> expr,
     }
 
     auto lhs = evaluate(expr->lhs, input, environment);
-    std::string op = std::any_cast<std::string>(expr->value);
+    const Parser::OpCode op = expr->opCode();
 
     // Short-circuit evaluation for logical operators
-    if (op == "and" || op == "or") {
+    if (op == Parser::OpCode::And || op == Parser::OpCode::Or) {
         auto rhsEvaluator = [this, expr, input, environment]() -> std::any {
             return this->evaluate(expr->rhs, input, environment);
         };
         return evaluateBooleanExpression(lhs, rhsEvaluator, op);
     }
 
+    if (op == Parser::OpCode::In && expr->rhs->invariant) {
+        std::any result;
+        if (evaluateIndexedIncludes(expr, lhs, input, environment, result)) {
+            return result;
+        }
+    }
+
     auto rhs = evaluate(expr->rhs, input, environment);
+    return evaluateBinaryOperator(expr, lhs, rhs);
+}
 
-    if (op == "+" || op == "-" || op == "*" || op == "/" || op == "%") {
-        return evaluateNumericExpression(lhs, rhs, op);
-    } else if (op == "=" || op == "!=") {
-        return evaluateEqualityExpression(lhs, rhs, op);
-    } else if (op == "<" || op == "<=" || op == ">" || op == ">=") {
-        return evaluateComparisonExpression(lhs, rhs, op);
-    } else if (op == "&") {
-        return evaluateStringConcat(lhs, rhs);
-    } else if (op == "..") {
-        return evaluateRangeExpression(lhs, rhs);
-    } else if (op == "in") {
-        return evaluateIncludesExpression(lhs, rhs);
-    } else {
-        throw JException("S0201", expr->position, "Unknown operator: " + op);
+std::any Jsonata::evaluateBinaryOperator(std::shared_ptr<Parser::Symbol> expr,
+                                         const std::any& lhs,
+                                         const std::any& rhs) {
+    const Parser::OpCode op = expr->opCode();
+    switch (op) {
+        case Parser::OpCode::Add:
+        case Parser::OpCode::Subtract:
+        case Parser::OpCode::Multiply:
+        case Parser::OpCode::Divide:
+        case Parser::OpCode::Modulo:
+            return evaluateNumericExpression(lhs, rhs, op);
+        case Parser::OpCode::Equal:
+        case Parser::OpCode::NotEqual:
+            return evaluateEqualityExpression(lhs, rhs, op);
+        case Parser::OpCode::Less:
+        case Parser::OpCode::LessEqual:
+        case Parser::OpCode::Greater:
+        case Parser::OpCode::GreaterEqual:
+            return evaluateComparisonExpression(lhs, rhs, op);
+        case Parser::OpCode::Concat:
+            return evaluateStringConcat(lhs, rhs);
+        case Parser::OpCode::Range:
+            return evaluateRangeExpression(lhs, rhs);
+        case Parser::OpCode::In:
+            return evaluateIncludesExpression(lhs, rhs);
+        default: {
+            std::string opText;
+            if (expr->value.type() == typeid(std::string)) {
+                opText = std::any_cast<std::string>(expr->value);
+            }
+            throw JException("S0201", expr->position,
+                             "Unknown operator: " + opText);
+        }
     }
 }
 
 std::any Jsonata::evaluateUnary(std::shared_ptr<Parser::Symbol> expr,
                                 const std::any& input,
                                 std::shared_ptr<Frame> environment) {
-    // Handle array and object constructors based on expr->value like Java
-    // implementation
-    std::string exprValue;
-    if (expr->value.has_value()) {
-        try {
-            exprValue = std::any_cast<std::string>(expr->value);
-        } catch (const std::bad_any_cast&) {
-            // If value is not a string, use id as fallback
-            exprValue = expr->id;
-        }
-    } else {
-        // Java: switch ((String)""+expr.value) - if value is empty, use empty
-        // string
-        exprValue = "";
-    }
+    // Handle array and object constructors based on the operator code the
+    // parser resolved from expr->value (Java: switch ((String)""+expr.value))
+    const Parser::OpCode op = expr->opCode();
 
-    if (exprValue == "[") {
+    if (op == Parser::OpCode::ArrayConstructor) {
         // Array constructor: [expr1, expr2, ...] - following Java
         // implementation
         std::any result = Utils::JList{};  // Start with empty list
@@ -442,26 +882,21 @@ std::any Jsonata::evaluateUnary(std::shared_ptr<Parser::Symbol> expr,
             // values
             if (value.has_value()) {
                 // Java reference lines 654-657: check item.value equals "["
-                bool isNestedArray = false;
-                if (item->value.has_value()) {
-                    try {
-                        std::string itemValue =
-                            std::any_cast<std::string>(item->value);
-                        isNestedArray = (itemValue == "[");
-                    } catch (const std::bad_any_cast&) {
-                        // Not a string value
-                    }
-                }
+                bool isNestedArray =
+                    item->opCode() == Parser::OpCode::ArrayConstructor;
 
                 if (isNestedArray) {
                     // Java line 655: ((List)result).add(value)
-                    auto vec = Utils::arrayify(result);
-                    vec.push_back(value);
-                    result = vec;
+                    auto* list = std::any_cast<Utils::JList>(&result);
+                    if (list == nullptr || list->isRange()) {
+                        result = Utils::arrayify(std::move(result));
+                        list = std::any_cast<Utils::JList>(&result);
+                    }
+                    list->push_back(std::move(value));
                 } else {
-                    // Java line 657: result = Functions.append(result, value)
-                    Utils::JList appendArgs = {result, value};
-                    result = Functions::append(appendArgs);
+                    // Java line 657: result = Functions.append(result, value),
+                    // extending result in place
+                    Functions::appendTo(result, value);
                 }
             }
             // If value is empty (undefined), skip it - matching Java behavior
@@ -474,20 +909,20 @@ std::any Jsonata::evaluateUnary(std::shared_ptr<Parser::Symbol> expr,
             // JList((List)result);
             Utils::JList jlist;
             if (result.type() == typeid(Utils::JList)) {
-                jlist = std::any_cast<Utils::JList>(result);
+                jlist = std::any_cast<Utils::JList>(std::move(result));
             } else {
                 // Convert result to JList
                 jlist = Utils::arrayify(result);
             }
             // Java line 665: ((JList)result).cons = true;
             jlist.cons = true;
-            result = jlist;
+            result = std::move(jlist);
         }
 
         return result;  // Return the result as-is (could be vector or
                         // JList with range)
 
-    } else if (exprValue == "{") {
+    } else if (op == Parser::OpCode::ObjectConstructor) {
         // Object constructor: {key: value, ...}
         // Follow Java reference: call evaluateGroupExpression for proper
         // validation (T1003, D1009)
@@ -501,26 +936,11 @@ std::any Jsonata::evaluateUnary(std::shared_ptr<Parser::Symbol> expr,
                              "Missing operand for unary operator");
         }
 
-        if (exprValue == "-") {
+        if (op == Parser::OpCode::Negate) {
             // Unary minus - match Java evaluateUnary lines 630-644
             auto result = evaluate(expr->expression, input, environment);
-
-            if (!result.has_value()) {
-                // Java: if (result==null) result = null;
-                return std::any{};
-            } else if (Utils::isNumeric(result)) {
-                // Java: result = Utils.convertNumber(
-                // -((Number)result).doubleValue() );
-                // Coerce to double and negate
-                return Utils::convertNumber(-Utils::toDouble(result));
-            } else {
-                // Java: throw new JException("D1002", expr.position,
-                // expr.value, result);
-                throw JException("D1002", expr->position,
-                                 "The numeric value following the unary "
-                                 "operator cannot be negated");
-            }
-        } else if (exprValue == "!") {
+            return evaluateNegation(expr, result);
+        } else if (op == Parser::OpCode::Not) {
             // Boolean negation - simple implementation
             auto operand = evaluate(expr->expression, input, environment);
             if (operand.type() == typeid(bool)) {
@@ -531,12 +951,35 @@ std::any Jsonata::evaluateUnary(std::shared_ptr<Parser::Symbol> expr,
                 return false;  // !anything_else = false (simplified)
             }
         } else {
+            std::string exprValue = expr->id;
+            if (expr->value.type() == typeid(std::string)) {
+                exprValue = std::any_cast<std::string>(expr->value);
+            }
             throw JException("T0410", expr->position,
                              "Unknown unary operator: " + exprValue);
         }
     }
 }
 
+std::any Jsonata::evaluateNegation(std::shared_ptr<Parser::Symbol> expr,
+                                   const std::any& result) {
+    if (!result.has_value()) {
+        // Java: if (result==null) result = null;
+        return std::any{};
+    } else if (Utils::isNumeric(result)) {
+        // Java: result = Utils.convertNumber(
+        // -((Number)result).doubleValue() );
+        // Coerce to double and negate
+        return Utils::convertNumber(-Utils::toDouble(result));
+    } else {
+        // Java: throw new JException("D1002", expr.position,
+        // expr.value, result);
+        throw JException("D1002", expr->position,
+                         "The numeric value following the unary "
+                         "operator cannot be negated");
+    }
+}
+
 std::any Jsonata::evaluateFunction(std::shared_ptr<Parser::Symbol> expr,
                                    const std::any& input,
                                    std::shared_ptr<Frame> environment) {
@@ -563,7 +1006,7 @@ std::any Jsonata::evaluateFunctionWithContext(
 
     // Get procedure name for error reporting
     std::any procName;
-    if (expr->procedure->type == "path") {
+    if (expr->procedure->nodeType() == Parser::NodeType::Path) {
         // Handle path-based function calls (not fully implemented yet)
         procName = expr->procedure->value;
     } else {
@@ -601,16 +1044,35 @@ std::any Jsonata::evaluateFunctionWithContext(
         evaluatedArgs.push_back(applytoContext);
     }
 
-    // Then add the regular arguments
-    for (const auto& arg : expr->arguments) {
-        auto argValue = evaluate(arg, input, environment);
-        evaluatedArgs.push_back(argValue);
+    // Then add the regular arguments. $exists(...) may carry a copy of its
+    // argument that stops at the first match (see Optimizer.h)
+    if (expr->body && callsBuiltin(expr->procedure, environment)) {
+        evaluatedArgs.push_back(evaluate(expr->body, input, environment));
+    } else {
+        for (const auto& arg : expr->arguments) {
+            evaluatedArgs.push_back(evaluate(arg, input, environment));
+        }
     }
 
+    // The predicate of a plain call is applied to its result (a chained
+    // call's is not), so $sort(x)[0] only needs the first item of the order
+    size_t limit = isNoContextMarker ? sortLimit(expr->predicate) : 0;
+    return invokeFunction(expr, proc, std::move(evaluatedArgs), input,
+                          environment, limit);
+}
+
+std::any Jsonata::invokeFunction(std::shared_ptr<Parser::Symbol> expr,
+                                 const std::any& proc,
+                                 Utils::JList&& evaluatedArgs,
+                                 const std::any& input,
+                                 std::shared_ptr<Frame> environment,
+                                 size_t limit) {
+    const std::any& procName = expr->procedure->value;
+
     try {
         // Check if proc is a JFunction
         if (proc.type() == typeid(JFunction)) {
-            auto jfunc = std::any_cast<JFunction>(proc);
+            const auto& jfunc = std::any_cast<const JFunction&>(proc);
             if (jfunc.implementation) {
                 // Special handling for higher-order functions: check for null
                 // first argument
@@ -640,14 +1102,14 @@ std::any Jsonata::evaluateFunctionWithContext(
                 }
 
                 // Validate function signature if present
+                EvalContext context{*this, input, environment, limit};
                 if (jfunc.signature) {
                     auto validatedArgs =
-                        jfunc.signature->validate(evaluatedArgs, input);
-                    return jfunc.implementation(validatedArgs, input,
-                                                environment);
+                        jfunc.signature->validate(std::move(evaluatedArgs),
+                                                  input);
+                    return jfunc.implementation(validatedArgs, context);
                 } else {
-                    return jfunc.implementation(evaluatedArgs, input,
-                                                environment);
+                    return jfunc.implementation(evaluatedArgs, context);
                 }
             } else {
                 throw JException("T0410", expr->position,
@@ -657,7 +1119,9 @@ std::any Jsonata::evaluateFunctionWithContext(
         // If it's a string, try to look it up in the function registry
         else if (proc.type() == typeid(std::string)) {
             auto functionName = std::any_cast<std::string>(proc);
-            return Functions::applyFunction(functionName, evaluatedArgs);
+            return Functions::applyFunction(
+                functionName, evaluatedArgs,
+                EvalContext{*this, input, environment, limit});
         }
         // Check if it's a lambda function (Java reference: lambda invocation)
         else if (proc.type() == typeid(std::shared_ptr<Parser::Symbol>)) {
@@ -697,31 +1161,17 @@ std::any Jsonata::evaluateRegex(std::shared_ptr<Parser::Symbol> expr,
     }
 }
 
-std::any Jsonata::flatten(const std::any& arg, Utils::JList* flattened) {
-    // Initialize flattened if null
-    Utils::JList localFlattened;
-    if (!flattened) {
-        flattened = &localFlattened;
+void Jsonata::flatten(const std::any& arg, Utils::JList& flattened) {
+    if (!arg.has_value()) {
+        return;
     }
-
-    if (arg.has_value()) {
-        try {
-            // Java reference line 748: if(arg instanceof List)
-            if (Utils::isArray(arg)) {
-                // Use arrayify to handle all array types uniformly
-                auto vec = Utils::arrayify(arg);
-                for (const auto& item : vec) {
-                    flatten(item, flattened);
-                }
-            } else {
-                flattened->push_back(arg);
-            }
-        } catch (const std::bad_any_cast&) {
-            flattened->push_back(arg);
-        }
+    // Java reference line 748: if(arg instanceof List)
+    if (Utils::isArray(arg)) {
+        Utils::forEachItem(
+            arg, [&](const std::any& item) { flatten(item, flattened); });
+    } else {
+        flattened.push_back(arg);
     }
-
-    return *flattened;
 }
 
 std::any Jsonata::evaluateWildcard(std::shared_ptr<Parser::Symbol> expr,
@@ -732,85 +1182,165 @@ std::any Jsonata::evaluateWildcard(std::shared_ptr<Parser::Symbol> expr,
         return results;
     }
 
-    std::any _input = input;
-    if (_input.type() == typeid(Utils::JList)) {
-        auto jlist = std::any_cast<Utils::JList>(_input);
+    std::any first;
+    const std::any* _input = &input;
+    if (input.type() == typeid(Utils::JList)) {
+        const auto& jlist = std::any_cast<const Utils::JList&>(input);
         if (jlist.outerWrapper) {
             // Java calls ((JList)input).get(0) which returns the
             // ORIGINAL input that was wrapped For wrapped empty array
             // [], get(0) should return the original empty array []
-            if (!jlist.empty()) {
-                _input = jlist[0];
+            if (jlist.isRange()) {
+                first = jlist[0];
+                _input = &first;
+            } else if (!jlist.empty()) {
+                _input = &jlist.front();
             }
         }
     }
-    try {
+
+    // Java reference lines 713/723: array values are flattened and
+    // appended, other values added as they are. The leaves go straight
+    // into results, so the wildcard is linear in the size of its output
+    auto add = [&](const std::any& value) {
+        if (value.has_value() && Utils::isArray(value)) {
+            flatten(value, results);
+            // Java: fn.append() returns a plain list, not a sequence
+            results.sequence = false;
+        } else {
+            results.push_back(value);
+        }
+    };
+
+    if (_input->type() ==
+        typeid(nlohmann::ordered_map<std::string, std::any>)) {
         // Handle map/object input
-        if (_input.type() ==
-            typeid(nlohmann::ordered_map<std::string, std::any>)) {
-            auto map =
-                std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                    _input);
-            for (const auto& [key, value] : map) {
-                // Java reference line 713: if((value instanceof List))
-                if (value.has_value() && Utils::isArray(value)) {
-                    // Flatten arrays and append
-                    auto flattened = flatten(value, nullptr);
-                    auto flattenedVec = Utils::arrayify(flattened);
-                    Utils::JList appendArgs = {results, flattenedVec};
-                    results = Utils::arrayify(Functions::append(appendArgs));
-                } else {
-                    results.push_back(value);
-                }
-            }
+        for (const auto& [key, value] : std::any_cast<
+                 const nlohmann::ordered_map<std::string, std::any>&>(
+                 *_input)) {
+            add(value);
         }
+    } else if (Utils::isArray(*_input)) {
         // Handle array input
-        else if (Utils::isArray(_input)) {
-            auto vec = Utils::arrayify(_input);
-            for (const auto& value : vec) {
-                // Java reference line 723: if((value instanceof List))
-                if (value.has_value() && Utils::isArray(value)) {
-                    // Flatten arrays and append
-                    auto flattened = flatten(value, nullptr);
-                    auto flattenedVec = Utils::arrayify(flattened);
-                    Utils::JList appendArgs = {results, flattenedVec};
-                    results = Utils::arrayify(Functions::append(appendArgs));
-                } else {
-                    results.push_back(value);
-                }
-            }
-        }
-    } catch (const std::bad_any_cast&) {
-        // Fall through
+        Utils::forEachItem(*_input, add);
     }
 
     return results;
 }
 
+namespace {
+
+// The frame the items of a tuple stream are evaluated in, one at a time: it
+// reads the current tuple's bindings in place (Frame::borrowTuple) and is
+// reused for the next tuple, unless something created while evaluating the
+// item (a closure, a child frame) still holds it. That frame adopts a copy
+// of its tuple's bindings, and the next tuple gets a new frame
+class TupleFrame {
+  public:
+    TupleFrame(Jsonata& instance, std::shared_ptr<Frame> environment)
+        : instance_(instance), environment_(std::move(environment)) {}
+    TupleFrame(const TupleFrame&) = delete;
+    TupleFrame& operator=(const TupleFrame&) = delete;
+    ~TupleFrame() { leave(); }
+
+    // The frame to evaluate tuple's item in, until leave()
+    const std::shared_ptr<Frame>& enter(const Tuple& tuple) {
+        if (!frame_) {
+            frame_ = instance_.createFrame(environment_);
+        }
+        frame_->borrowTuple(&tuple);
+        return frame_;
+    }
+
+    // Called before the entered tuple changes or goes away
+    void leave() {
+        if (frame_ && frame_.use_count() > 1) {
+            frame_->adoptTuple();
+            frame_.reset();
+        }
+    }
+
+  private:
+    Jsonata& instance_;
+    std::shared_ptr<Frame> environment_;
+    std::shared_ptr<Frame> frame_;
+};
+
+// A tuple's value, moved out when no other tuple shares it
+std::any releaseValue(Tuple::Value& value) {
+    if (!value) {
+        return std::any{};
+    }
+    if (value.use_count() == 1) {
+        return std::move(*value);
+    }
+    return *value;
+}
+
+}  // namespace
+
 std::any Jsonata::evaluatePath(std::shared_ptr<Parser::Symbol> expr,
                                const std::any& input,
                                std::shared_ptr<Frame> environment) {
-    std::any current = input;
+    // Plain field navigation; with an observer attached the steps still go
+    // through evaluate() so that each of them is reported
+    if (!expr->fields.empty() && environment->getObserver() == nullptr) {
+        return evaluateFieldPath(*expr, input);
+    }
 
     // Java reference: if the first step is a variable reference ($...), then
     // the path is absolute Handle input sequence setup like Java (lines
-    // 250-257)
-    Utils::JList inputSequence;
+    // 250-257). A list input is read in place. Any other input is wrapped in
+    // a singleton sequence only when a step needs the sequence itself;
+    // streamed steps read the item directly. A range stays lazy until a step
+    // needs the sequence; streamed steps take its items one at a time
+    Utils::JList ownedSequence;
+    const Utils::JList* inputList = &ownedSequence;
+    const std::any* single = nullptr;
     if (input.has_value() && Utils::isArray(input) && !expr->steps.empty() &&
-        expr->steps[0]->type != "variable") {
-        inputSequence = Utils::arrayify(input);
+        expr->steps[0]->nodeType() != Parser::NodeType::Variable) {
+        const auto* list = std::any_cast<Utils::JList>(&input);
+        if (list != nullptr) {
+            inputList = list;
+        } else {
+            ownedSequence = Utils::arrayify(input);
+        }
     } else {
         // If input is not an array or first step is variable, make it a
         // sequence
-        inputSequence = Utils::createSequence(input);
-    }
+        single = &input;
+    }
+    auto inputSequence = [&]() -> const Utils::JList& {
+        if (single != nullptr) {
+            ownedSequence = Utils::createSequence(*single);
+            inputList = &ownedSequence;
+            single = nullptr;
+        } else if (inputList->isRange()) {
+            ownedSequence = Utils::arrayify(std::any(*inputList));
+            inputList = &ownedSequence;
+        }
+        return *inputList;
+    };
 
     std::any resultSequence;
     bool isTupleStream = false;
     std::optional<Utils::JList> tupleBindings;
 
+    // A hash join stands for the first steps
+    size_t first = 0;
+    if (expr->join &&
+        evaluateHashJoin(expr, input, environment, resultSequence)) {
+        first = expr->join->length;
+        if (first == expr->steps.size() || !resultSequence.has_value()) {
+            return resultSequence;
+        }
+        ownedSequence = Utils::arrayify(resultSequence);
+        inputList = &ownedSequence;
+        single = nullptr;
+    }
+
     // Walk through each step in the path
-    for (size_t i = 0; i < expr->steps.size(); ++i) {
+    for (size_t i = first; i < expr->steps.size(); ++i) {
         const auto& step = expr->steps[i];
 
         // Java reference lines 267-269: check for tuple step
@@ -823,16 +1353,38 @@ std::any Jsonata::evaluatePath(std::shared_ptr<Parser::Symbol> expr,
             // Java reference lines 271-273: if the first step is an explicit
             // array constructor, then just evaluate that (i.e. don't iterate
             // over a context array)
-            resultSequence = evaluate(step, inputSequence, environment);
+            resultSequence =
+                evaluate(step, std::any(inputSequence()), environment);
         } else {
             // Java reference lines 275-279: handle tuple vs regular steps
             if (isTupleStream) {
                 tupleBindings = std::any_cast<Utils::JList>(evaluateTupleStep(
-                    step, inputSequence, tupleBindings, environment));
-            } else {
+                    step, inputSequence(), tupleBindings, environment));
+            } else if (!isStreamableStep(step)) {
                 // Regular step evaluation
-                resultSequence = evaluateStep(step, inputSequence, environment,
-                                              i == expr->steps.size() - 1);
+                resultSequence =
+                    evaluateStep(step, inputSequence(), environment,
+                                 i == expr->steps.size() - 1);
+            } else {
+                // Stream each item through the run of plain steps starting
+                // here; only the run's result is materialized
+                size_t end = i + 1;
+                while (end < expr->steps.size() &&
+                       isStreamableStep(expr->steps[end])) {
+                    end++;
+                }
+                if (single != nullptr) {
+                    resultSequence =
+                        evaluateSteps(expr, i, end, single, 1, environment);
+                } else if (inputList->isRange()) {
+                    resultSequence =
+                        evaluateSteps(expr, i, end, *inputList, environment);
+                } else {
+                    resultSequence = evaluateSteps(
+                        expr, i, end, inputList->data(),
+                        inputList->ItemVector::size(), environment);
+                }
+                i = end - 1;
             }
         }
 
@@ -841,7 +1393,7 @@ std::any Jsonata::evaluatePath(std::shared_ptr<Parser::Symbol> expr,
         if (!isTupleStream) {
             if (!resultSequence.has_value() ||
                 (Utils::isArray(resultSequence) &&
-                 Utils::arrayify(resultSequence).empty())) {
+                 isEmptyArray(resultSequence))) {
                 break;
             }
         }
@@ -850,8 +1402,20 @@ std::any Jsonata::evaluatePath(std::shared_ptr<Parser::Symbol> expr,
         if (step->focus.has_value()) {
             // Keep current inputSequence when there's a focus variable
         } else {
-            if (resultSequence.has_value() && Utils::isArray(resultSequence)) {
-                inputSequence = Utils::arrayify(resultSequence);
+            // The last step's result is returned; any other is only the next
+            // step's input, so its items are moved there. A range is handed
+            // on as it is
+            if (i + 1 < expr->steps.size() && resultSequence.has_value() &&
+                Utils::isArray(resultSequence)) {
+                const auto* range =
+                    std::any_cast<Utils::JList>(&resultSequence);
+                if (range != nullptr && range->isRange()) {
+                    ownedSequence = *range;
+                } else {
+                    ownedSequence = Utils::arrayify(std::move(resultSequence));
+                }
+                inputList = &ownedSequence;
+                single = nullptr;
             }
         }
     }
@@ -861,48 +1425,23 @@ std::any Jsonata::evaluatePath(std::shared_ptr<Parser::Symbol> expr,
         if (expr->tuple.has_value()) {
             // tuple stream is carrying ancestry information - keep this
             resultSequence = tupleBindings.value_or(Utils::JList{});
-        } else {
-            // Extract the @ values from tuple bindings
+        } else if (expr->group == nullptr) {
+            // Extract the @ values from tuple bindings; a group-by reads the
+            // tuples instead
             Utils::JList result = Utils::createSequence();
             if (tupleBindings.has_value()) {
-                for (const auto& tupleAny : *tupleBindings) {
-                    auto tuple = std::any_cast<
-                        nlohmann::ordered_map<std::string, std::any>>(tupleAny);
-                    auto it = tuple.find("@");
-                    if (it != tuple.end()) {
-                        result.push_back(it->second);
-                    }
+                result.reserve(tupleBindings->size());
+                for (auto& tupleAny : *tupleBindings) {
+                    auto& tuple = std::any_cast<Tuple&>(tupleAny);
+                    result.push_back(releaseValue(tuple.context));
                 }
             }
-            resultSequence = result;
+            resultSequence = std::move(result);
         }
     }
 
     if (expr->keepSingletonArray) {
-        Utils::JList jlist;
-
-        // If we only got an ArrayList, convert it so we can set the
-        // keepSingleton flag
-        if (resultSequence.type() != typeid(Utils::JList)) {
-            // Convert regular vector to JList
-            try {
-                jlist = Utils::arrayify(resultSequence);
-            } catch (const std::bad_any_cast&) {
-                // If it's not a vector, create a JList and add the item
-                jlist.push_back(resultSequence);
-            }
-        }
-
-        // if the array is explicitly constructed in the expression and marked
-        // to promote singleton sequences to array
-        if (resultSequence.type() == typeid(Utils::JList)) {
-            jlist = std::any_cast<Utils::JList>(resultSequence);
-            if (jlist.cons && !jlist.sequence) {
-                jlist = Utils::createSequence(resultSequence);
-            }
-        }
-        jlist.keepSingleton = true;
-        resultSequence = jlist;
+        resultSequence = keepSingletonArray(std::move(resultSequence));
     }
 
     // Java reference lines 317-319: Apply group expression if present for path
@@ -915,7 +1454,36 @@ std::any Jsonata::evaluatePath(std::shared_ptr<Parser::Symbol> expr,
             environment);
     }
 
-    return resultSequence.has_value() ? resultSequence : std::any{};
+    return resultSequence;
+}
+
+/* static */ std::any Jsonata::keepSingletonArray(std::any resultSequence) {
+    Utils::JList jlist;
+
+    // If we only got an ArrayList, convert it so we can set the
+    // keepSingleton flag
+    if (resultSequence.type() != typeid(Utils::JList)) {
+        // Convert regular vector to JList
+        try {
+            jlist = Utils::arrayify(resultSequence);
+        } catch (const std::bad_any_cast&) {
+            // If it's not a vector, create a JList and add the item
+            jlist.push_back(resultSequence);
+        }
+    }
+
+    // if the array is explicitly constructed in the expression and marked
+    // to promote singleton sequences to array
+    if (resultSequence.type() == typeid(Utils::JList)) {
+        const auto& list = std::any_cast<const Utils::JList&>(resultSequence);
+        if (list.cons && !list.sequence) {
+            jlist = Utils::createSequence(resultSequence);
+        } else {
+            jlist = std::any_cast<Utils::JList>(std::move(resultSequence));
+        }
+    }
+    jlist.keepSingleton = true;
+    return jlist;
 }
 
 std::any Jsonata::evaluateCondition(std::shared_ptr<Parser::Symbol> expr,
@@ -937,14 +1505,14 @@ std::any Jsonata::evaluateCondition(std::shared_ptr<Parser::Symbol> expr,
 // Binary operation evaluators
 std::any Jsonata::evaluateNumericExpression(const std::any& lhs,
                                             const std::any& rhs,
-                                            const std::string& op) {
+                                            Parser::OpCode op) {
     // Java reference lines 812-821: Check for non-numeric operands and throw
     // appropriate errors
     if (lhs.has_value() && !Utils::isNumeric(lhs)) {
-        throw JException("T2001", -1, op, lhs);
+        throw JException("T2001", -1, std::string(Parser::opName(op)), lhs);
     }
     if (rhs.has_value() && !Utils::isNumeric(rhs)) {
-        throw JException("T2002", -1, op, rhs);
+        throw JException("T2002", -1, std::string(Parser::opName(op)), rhs);
     }
 
     // Java reference lines 823-826: Handle null/undefined operands
@@ -959,18 +1527,26 @@ std::any Jsonata::evaluateNumericExpression(const std::any& lhs,
 
         // Java reference lines 832-848: Perform numeric operations
         double result;
-        if (op == "+") {
-            result = left + right;
-        } else if (op == "-") {
-            result = left - right;
-        } else if (op == "*") {
-            result = left * right;
-        } else if (op == "/") {
-            result = left / right;
-        } else if (op == "%") {
-            result = std::fmod(left, right);
-        } else {
-            throw JException("S0201", 0, "Unknown numeric operator: " + op);
+        switch (op) {
+            case Parser::OpCode::Add:
+                result = left + right;
+                break;
+            case Parser::OpCode::Subtract:
+                result = left - right;
+                break;
+            case Parser::OpCode::Multiply:
+                result = left * right;
+                break;
+            case Parser::OpCode::Divide:
+                result = left / right;
+                break;
+            case Parser::OpCode::Modulo:
+                result = std::fmod(left, right);
+                break;
+            default:
+                throw JException("S0201", 0,
+                                 std::string("Unknown numeric operator: ") +
+                                     Parser::opName(op));
         }
 
         // Java reference line 849: Convert and return result
@@ -982,7 +1558,7 @@ std::any Jsonata::evaluateNumericExpression(const std::any& lhs,
 
 std::any Jsonata::evaluateComparisonExpression(const std::any& lhs,
                                                const std::any& rhs,
-                                               const std::string& op) {
+                                               Parser::OpCode op) {
     // Java reference lines 897-956: evaluateComparisonExpression
 
     // Java lines 901-902: type checks - check if operands are comparable
@@ -990,28 +1566,23 @@ std::any Jsonata::evaluateComparisonExpression(const std::any& lhs,
     // Number; var rcomparable = rhs == null || rhs instanceof String || rhs
     // instanceof Number;
 
-    // Helper to check for JSON null marker (which is NOT comparable in Java as
-    // NULL_VALUE)
-    auto isJsonNull = [](const std::any& value) -> bool {
-        return Utils::isNullValue(value);
-    };
-
-    // In Java: lhs == null means undefined (comparable), but NULL_VALUE is not
-    // comparable. In C++: !has_value() = undefined (comparable),
-    // Utils::NULL_VALUE = JSON null (NOT comparable)
+    // Operands are classified once and compared in place by the shared
+    // ordering kernel; strings are never copied. In Java: lhs == null means
+    // undefined (comparable), but NULL_VALUE is not comparable. In C++:
+    // !has_value() = undefined (comparable), Utils::NULL_VALUE = JSON null
+    // (NOT comparable)
+    Utils::OrderKey left = Utils::orderKey(lhs);
+    Utils::OrderKey right = Utils::orderKey(rhs);
     bool lcomparable =
-        (!lhs.has_value()) ||
-        (!isJsonNull(lhs) && lhs.type() == typeid(std::string)) ||
-        Utils::isNumeric(lhs);
+        !lhs.has_value() || left.kind != Utils::OrderKey::Kind::Other;
     bool rcomparable =
-        (!rhs.has_value()) ||
-        (rhs.type() == typeid(std::string) && !isJsonNull(rhs)) ||
-        Utils::isNumeric(rhs);
+        !rhs.has_value() || right.kind != Utils::OrderKey::Kind::Other;
 
     // Java lines 905-912: if either operand is not comparable, throw error
     if (!lcomparable || !rcomparable) {
         std::any nonComparable = lhs.has_value() ? lhs : rhs;
-        throw JException("T2010", 0, op, nonComparable);
+        throw JException("T2010", 0, std::string(Parser::opName(op)),
+                         nonComparable);
     }
 
     // Java lines 914-917: if either side is undefined, the result is undefined
@@ -1019,78 +1590,24 @@ std::any Jsonata::evaluateComparisonExpression(const std::any& lhs,
         return std::any{};
     }
 
-    // Java lines 920-937: if operands are not of the same type
-    if (lhs.type() != rhs.type()) {
-        // Java lines 922-926: handle Number/Number comparisons with type
-        // conversion
-        if (Utils::isNumeric(lhs) && Utils::isNumeric(rhs)) {
-            // Convert both to double for comparison (like Java converts to
-            // doubleValue()) Continue to comparison below with converted values
-        } else {
-            // Java lines 930-936: different types that are not both numeric
-            throw JException("T2009", 0, lhs, rhs);
-        }
+    // Java lines 920-937: a number and a string do not compare
+    if (left.isNumber() != right.isNumber()) {
+        throw JException("T2009", 0, lhs, rhs);
     }
 
-    // Java lines 939-955: Cast to Comparable and perform comparison
-    // Comparable _lhs = (Comparable)lhs;
-
-    try {
-        // Handle string comparison using compareTo logic (but not JSON null
-        // markers)
-        if (lhs.type() == typeid(std::string) &&
-            rhs.type() == typeid(std::string) && !isJsonNull(lhs) &&
-            !isJsonNull(rhs)) {
-            std::string leftStr = std::any_cast<std::string>(lhs);
-            std::string rightStr = std::any_cast<std::string>(rhs);
-
-            // Java: _lhs.compareTo(rhs) < 0, <= 0, > 0, >= 0
-            int64_t comparison = leftStr.compare(rightStr);
-
-            switch (op[0]) {
-                case '<':
-                    if (op == "<") {
-                        return comparison < 0;
-                    } else {  // "<="
-                        return comparison <= 0;
-                    }
-                case '>':
-                    if (op == ">") {
-                        return comparison > 0;
-                    } else {  // ">="
-                        return comparison >= 0;
-                    }
-            }
-        }
-
-        // Handle numeric comparison - Java type coercion logic
-        if (Utils::isNumeric(lhs) && Utils::isNumeric(rhs)) {
-            // Java lines 922-926: convert all to double like
-            // ((Number)lhs).doubleValue()
-            double left = Utils::toDouble(lhs);
-            double right = Utils::toDouble(rhs);
-
-            // Java lines 942-953: perform comparison
-            switch (op[0]) {
-                case '<':
-                    if (op == "<") {
-                        return left < right;
-                    } else {  // "<="
-                        return left <= right;
-                    }
-                case '>':
-                    if (op == ">") {
-                        return left > right;
-                    } else {  // ">="
-                        return left >= right;
-                    }
-            }
-        }
-
-        throw JException("T2010", 0, op, lhs);
-
-    } catch (const std::bad_any_cast&) {
-        throw JException("T2010", 0, op, lhs);
+    // Java lines 939-955: _lhs.compareTo(rhs) < 0, <= 0, > 0, >= 0
+    int comparison = Utils::compareOrderKeys(left, right);
+    switch (op) {
+        case Parser::OpCode::Less:
+            return comparison < 0;
+        case Parser::OpCode::LessEqual:
+            return comparison <= 0;
+        case Parser::OpCode::Greater:
+            return comparison > 0;
+        case Parser::OpCode::GreaterEqual:
+            return comparison >= 0;
+        default:
+            throw JException("T2010", 0, std::string(Parser::opName(op)), lhs);
     }
 }
 
@@ -1193,7 +1710,7 @@ bool Jsonata::deepEquals(const std::any& lhs, const std::any& rhs) {
 
 std::any Jsonata::evaluateEqualityExpression(const std::any& lhs,
                                              const std::any& rhs,
-                                             const std::string& op) {
+                                             Parser::OpCode op) {
     // Java reference lines 866-869: if either side is null/undefined, result is
     // false
     if (!lhs.has_value() || !rhs.has_value()) {
@@ -1207,17 +1724,17 @@ std::any Jsonata::evaluateEqualityExpression(const std::any& lhs,
 
     // Java line 881/884: result = lhs.equals(rhs) for "=" or !lhs.equals(rhs)
     // for "!="
-    return (op == "=") ? equal : !equal;
+    return (op == Parser::OpCode::Equal) ? equal : !equal;
 }
 
 std::any Jsonata::evaluateBooleanExpression(const std::any& lhs,
                                             std::function<std::any()> rhs,
-                                            const std::string& op) {
+                                            Parser::OpCode op) {
     bool leftBool = boolize(lhs);
 
-    if (op == "and") {
+    if (op == Parser::OpCode::And) {
         return leftBool && boolize(rhs());
-    } else if (op == "or") {
+    } else if (op == Parser::OpCode::Or) {
         return leftBool || boolize(rhs());
     } else {
         throw JException("T0410", 0, "Unknown boolean operator");
@@ -1306,7 +1823,8 @@ std::any Jsonata::evaluateIncludesExpression(const std::any& lhs,
 
     // Java reference lines 978-984: check for inclusion in array
     for (const auto& item : rhsArray) {
-        auto equality = evaluateEqualityExpression(lhs, item, "=");
+        auto equality =
+            evaluateEqualityExpression(lhs, item, Parser::OpCode::Equal);
         if (std::any_cast<bool>(equality)) {
             return true;
         }
@@ -1315,6 +1833,85 @@ std::any Jsonata::evaluateIncludesExpression(const std::any& lhs,
     return false;
 }
 
+namespace {
+
+// Right-hand arrays shorter than this are scanned
+constexpr size_t kIncludesIndexThreshold = 8;
+
+// The items of an invariant right-hand side of `in`, with the positions of
+// each structural hash
+struct IncludesIndex {
+    // False when the right-hand side is short, not an array, or holds an
+    // infinite number, which the scan reports as an error
+    bool usable = true;
+    Utils::JList items;
+    std::unordered_map<uint64_t, std::vector<size_t>> positions;
+};
+
+}  // namespace
+
+bool Jsonata::evaluateIndexedIncludes(
+    const std::shared_ptr<Parser::Symbol>& expr, const std::any& lhs,
+    const std::any& input, const std::shared_ptr<Frame>& environment,
+    std::any& result) {
+    // An observer must see the right-hand side evaluated every time
+    auto* invariants = environment->getInvariants();
+    if (invariants == nullptr || environment->getObserver() != nullptr) {
+        return false;
+    }
+    for (const auto& procedure : expr->rhs->invariantCalls) {
+        if (!callsBuiltin(procedure, environment)) {
+            return false;
+        }
+    }
+
+    std::shared_ptr<IncludesIndex> index;
+    auto found = invariants->find(expr);
+    if (found != invariants->end()) {
+        index =
+            std::any_cast<const std::shared_ptr<IncludesIndex>&>(found->second);
+    } else {
+        index = std::make_shared<IncludesIndex>();
+        std::any rhs = evaluate(expr->rhs, input, environment);
+        if (Utils::isArray(rhs)) {
+            index->items = Utils::arrayify(std::move(rhs));
+        }
+        index->usable = index->items.size() >= kIncludesIndexThreshold;
+        for (size_t i = 0; index->usable && i < index->items.size(); i++) {
+            auto hash = Utils::structuralHash(index->items[i]);
+            if (!hash) {
+                index->usable = false;
+                break;
+            }
+            index->positions[*hash].push_back(i);
+        }
+        invariants->emplace(expr, index);
+    }
+    if (!index->usable) {
+        return false;
+    }
+
+    if (!lhs.has_value()) {
+        result = false;
+        return true;
+    }
+    auto hash = Utils::structuralHash(lhs);
+    if (!hash) {
+        return false;
+    }
+    result = false;
+    auto matches = index->positions.find(*hash);
+    if (matches != index->positions.end()) {
+        for (size_t position : matches->second) {
+            if (deepEquals(lhs, index->items[position])) {
+                result = true;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
 std::any Jsonata::evaluateDescendant(std::shared_ptr<Parser::Symbol> expr,
                                      const std::any& input,
                                      std::shared_ptr<Frame> environment) {
@@ -1335,7 +1932,7 @@ std::any Jsonata::evaluateDescendant(std::shared_ptr<Parser::Symbol> expr,
 }
 
 void Jsonata::recurseDescendants(const std::any& input,
-                                 std::vector<std::any>& results) {
+                                 Utils::JList& results) {
     // Port of Java recurseDescendants - this is the equivalent of //* in XPath
 
     // Check if input is not a List/vector - following Java logic exactly
@@ -1347,17 +1944,15 @@ void Jsonata::recurseDescendants(const std::any& input,
 
     // If input is a List/vector
     if (isVector) {
-        auto vec = Utils::arrayify(input);
-        for (const auto& member : vec) {
+        Utils::forEachItem(input, [&](const std::any& member) {
             recurseDescendants(member, results);
-        }
+        });
     } else if (input.has_value()) {
         // Check if input is a Map (JSON object) - following existing patterns
         // in the codebase
         try {
-            auto map =
-                std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                    input);
+            const auto& map = std::any_cast<
+                const nlohmann::ordered_map<std::string, std::any>&>(input);
             for (const auto& [key, value] : map) {
                 recurseDescendants(value, results);
             }
@@ -1396,7 +1991,7 @@ std::any Jsonata::evaluateApply(std::shared_ptr<Parser::Symbol> expr,
     // environment);
     auto lhs = evaluate(expr->lhs, input, environment);
 
-    if (expr->rhs->type == "function") {
+    if (expr->rhs->nodeType() == Parser::NodeType::Function) {
         // Java lines 1518-1521: this is a function invocation; invoke it with
         // lhs expression as the first argument
         return evaluateFunctionWithContext(expr->rhs, input, environment, lhs);
@@ -1454,19 +2049,19 @@ std::any Jsonata::evaluateBind(std::shared_ptr<Parser::Symbol> expr,
     // Variable binding: $var := value
     auto value = evaluate(expr->rhs, input, environment);
 
-    // Get variable name from lhs
-    std::string varName;
+    // Get variable slot from lhs
+    static const Frame::Slot emptySlot = Frame::slotOf("");
+    Frame::Slot slot = emptySlot;
     if (expr->lhs && expr->lhs->value.has_value()) {
-        try {
-            varName = std::any_cast<std::string>(expr->lhs->value);
-        } catch (const std::bad_any_cast&) {
+        slot = expr->lhs->variableSlot();
+        if (slot == Frame::kNoSlot) {
             throw JException("S0212", expr->lhs->position,
                              "Invalid variable name");
         }
     }
 
     // Bind the variable in the current environment
-    environment->bind(varName, value);
+    environment->bind(slot, value);
 
     return value;
 }
@@ -1494,9 +2089,52 @@ std::any Jsonata::evaluateLambda(std::shared_ptr<Parser::Symbol> expr,
     return procedure;
 }
 
+namespace {
+
+// Order-by inputs at least this long are sorted through the sort executor,
+// when one is set
+constexpr size_t kParallelSortThreshold = 1 << 16;
+
+// The value of one order-by term for one item, classified once so the
+// comparator works on plain numbers and strings. key reads value in place,
+// so a SortKey stays where it was filled in
+struct SortKey {
+    enum class Kind : uint8_t { Pending, Undefined, Number, String, Invalid };
+
+    Kind kind = Kind::Pending;
+    Utils::OrderKey key;
+    // Invalid keys keep it to report the same error as the comparison on
+    // the raw value would
+    std::any value;
+
+    SortKey() = default;
+    SortKey(const SortKey&) = delete;
+    SortKey& operator=(const SortKey&) = delete;
+
+    void assign(std::any v) {
+        value = std::move(v);
+        if (!value.has_value()) {
+            kind = Kind::Undefined;
+            return;
+        }
+        if (value.type() == typeid(double) &&
+            !std::isfinite(std::any_cast<double>(value))) {
+            kind = Kind::Invalid;
+            return;
+        }
+        key = Utils::orderKey(value);
+        kind = key.isNumber()   ? Kind::Number
+               : key.isString() ? Kind::String
+                                : Kind::Invalid;
+    }
+};
+
+}  // namespace
+
 std::any Jsonata::evaluateSort(std::shared_ptr<Parser::Symbol> expr,
                                const std::any& input,
-                               std::shared_ptr<Frame> environment) {
+                               std::shared_ptr<Frame> environment,
+                               size_t limit) {
     // Sort operator: array^(expression)
     // This is equivalent to Java's evaluateSortExpression (lines 1306-1410)
 
@@ -1511,9 +2149,8 @@ std::any Jsonata::evaluateSort(std::shared_ptr<Parser::Symbol> expr,
     // Java line 1311: var isTupleSort = (input instanceof JList &&
     // ((JList)input).tupleStream) ? true : false;
     if (input.type() == typeid(Utils::JList)) {
-        auto jlist = std::any_cast<Utils::JList>(input);
-        arrayToSort = jlist;
-        isTupleSort = jlist.tupleStream;
+        arrayToSort = std::any_cast<const Utils::JList&>(input);
+        isTupleSort = arrayToSort.tupleStream;
     } else if (Utils::isArray(input)) {
         arrayToSort = Utils::arrayify(input);
     } else {
@@ -1530,181 +2167,185 @@ std::any Jsonata::evaluateSort(std::shared_ptr<Parser::Symbol> expr,
         return arrayToSort;
     }
 
-    // Create comparator function equivalent to Java version
-    auto comparator = [this, expr, environment, isTupleSort](
-                          const std::any& a, const std::any& b) -> bool {
-        int64_t comp = 0;
-
-        // Iterate through all sort terms in priority order (like Java)
-        for (size_t index = 0; comp == 0 && index < expr->terms.size();
-             index++) {
-            auto term = expr->terms[index];
-
-            // Evaluate sort term in context of 'a'
-            std::any contextA = a;
-            std::shared_ptr<Frame> envA = environment;
-
-            if (isTupleSort) {
-                // Extract context from tuple map
-                try {
-                    if (a.type() ==
-                        typeid(nlohmann::ordered_map<std::string, std::any>)) {
-                        auto tupleMap = std::any_cast<
-                            nlohmann::ordered_map<std::string, std::any>>(a);
-                        auto it = tupleMap.find("@");
-                        if (it != tupleMap.end()) {
-                            contextA = it->second;
-                            envA = createFrameFromTuple(environment, tupleMap);
-                        }
-                    }
-                } catch (const std::bad_any_cast&) {
-                    // Use original context if cast fails
-                }
-            }
-
-            // Java line 1331: Object aa = /* await */ evaluate(term.expression,
-            // context, env); Use _evaluate to avoid circular evaluation
-            std::any aa = evaluate(term->expression, contextA, envA);
-
-            // Evaluate sort term in context of 'b'
-            std::any contextB = b;
-            std::shared_ptr<Frame> envB = environment;
-
-            if (isTupleSort) {
-                try {
-                    if (b.type() ==
-                        typeid(nlohmann::ordered_map<std::string, std::any>)) {
-                        auto tupleMap = std::any_cast<
-                            nlohmann::ordered_map<std::string, std::any>>(b);
-                        auto it = tupleMap.find("@");
-                        if (it != tupleMap.end()) {
-                            contextB = it->second;
-                            envB = createFrameFromTuple(environment, tupleMap);
-                        }
-                    }
-                } catch (const std::bad_any_cast&) {
-                    // Use original context if cast fails
-                }
-            }
+    // Decorate-sort-undecorate: every item's key for the first term is
+    // evaluated once up front, since a sort of two or more items compares
+    // each of them at least once. Keys for later terms are only needed to
+    // break ties, so they are evaluated on first use. The comparator then
+    // works on the classified keys and raises T2007/T2008 exactly where the
+    // comparison of the raw values would.
+    const size_t count = arrayToSort.size();
+    const size_t termCount = expr->terms.size();
+
+    std::vector<bool> descending(termCount);
+    for (size_t t = 0; t < termCount; t++) {
+        const auto& term = expr->terms[t];
+        descending[t] = term->descending;
+        if (term->value.type() == typeid(std::string) &&
+            std::any_cast<const std::string&>(term->value) == "descending") {
+            descending[t] = true;
+        }
+    }
 
-            // Java line 1340: Object bb = /* await */ evaluate(term.expression,
-            // context, env); Use _evaluate to avoid circular evaluation
-            std::any bb = evaluate(term->expression, contextB, envB);
+    // Evaluates the given terms against one item, binding the tuple's
+    // variables for a tuple sort
+    std::vector<SortKey> keys(count * termCount);
+    TupleFrame tupleFrame(*this, environment);
+    auto evaluateKeys = [&](size_t item, size_t first, size_t last) {
+        const std::any& value = arrayToSort[item];
+        const std::any* context = &value;
+        const std::shared_ptr<Frame>* env = &environment;
+        const auto* tuple =
+            isTupleSort ? std::any_cast<Tuple>(&value) : nullptr;
+        if (tuple != nullptr) {
+            context = tuple->context.get();
+            env = &tupleFrame.enter(*tuple);
+        }
+        for (size_t t = first; t < last; t++) {
+            keys[item * termCount + t].assign(
+                evaluate(expr->terms[t]->expression, *context, *env));
+        }
+        tupleFrame.leave();
+    };
+    auto keyOf = [&](size_t item, size_t term) -> const SortKey& {
+        SortKey& key = keys[item * termCount + term];
+        if (key.kind == SortKey::Kind::Pending) {
+            evaluateKeys(item, term, term + 1);
+        }
+        return key;
+    };
 
-            // Type checking and comparison (following Java logic exactly)
+    auto compare = [&](size_t a, size_t b) -> int {
+        int comp = 0;
+        for (size_t t = 0; comp == 0 && t < termCount; t++) {
+            const SortKey& aa = keyOf(a, t);
+            const SortKey& bb = keyOf(b, t);
 
-            // undefined/null should be last in sort order (Java lines
-            // 1346-1354)
-            if (!aa.has_value()) {
-                comp = bb.has_value() ? 1 : 0;
+            // undefined sorts last
+            if (aa.kind == SortKey::Kind::Undefined) {
+                comp = bb.kind == SortKey::Kind::Undefined ? 0 : 1;
                 continue;
             }
-            if (!bb.has_value()) {
+            if (bb.kind == SortKey::Kind::Undefined) {
                 comp = -1;
                 continue;
             }
-
-            // Check for JSON NULL_VALUE markers (equivalent to Java's
-            // NULL_VALUE)
-            bool aa_is_null_value = false;
-            bool bb_is_null_value = false;
-
-            aa_is_null_value = Utils::isNullValue(aa);
-
-            bb_is_null_value = Utils::isNullValue(bb);
-
-            // Java logic: if aa or bb are not string or numeric values, then
-            // throw an error (lines 1357-1365) Note: NULL_VALUE is neither
-            // string nor numeric, so it should trigger T2008
-            bool aa_valid =
-                (aa.type() == typeid(std::string) && !aa_is_null_value) ||
-                Utils::isNumeric(aa);
-            bool bb_valid =
-                (bb.type() == typeid(std::string) && !bb_is_null_value) ||
-                Utils::isNumeric(bb);
-
-            if (!aa_valid || !bb_valid) {
+            if (aa.kind == SortKey::Kind::Invalid ||
+                bb.kind == SortKey::Kind::Invalid) {
+                // Non-finite numbers are reported as D1001 by isNumeric
+                if (aa.kind == SortKey::Kind::Invalid) {
+                    Utils::isNumeric(aa.value);
+                }
+                if (bb.kind == SortKey::Kind::Invalid) {
+                    Utils::isNumeric(bb.value);
+                }
                 throw JException("T2008", expr->position,
                                  "The expressions within an order-by clause "
                                  "must evaluate to numeric or string values");
             }
-
-            // Check if both values are the same type
-            bool sameType = false;
-            if (Utils::isNumeric(aa) && Utils::isNumeric(bb)) {
-                sameType = true;
-            } else if (aa.type() == bb.type()) {
-                sameType = true;
-            }
-
-            if (!sameType) {
+            if (aa.kind != bb.kind) {
                 throw JException(
                     "T2007", expr->position,
                     "Type mismatch when comparing values in order-by clause");
             }
+            comp = Utils::compareOrderKeys(aa.key, bb.key);
+            if (descending[t]) {
+                comp = -comp;
+            }
+        }
+        return comp;
+    };
+    auto less = [&](size_t a, size_t b) { return compare(a, b) < 0; };
 
-            // Perform comparison
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+
+    try {
+        // A sort that keeps only its first items, or a large one that runs
+        // in parallel, evaluates all of its keys up front. Either is only
+        // used when no comparison can fail: no invalid keys, and the defined
+        // keys of each term are all numbers or all strings. Anything else
+        // takes the sequential path, which raises the errors lazily. Since
+        // every key is known before the tasks start, they only compare keys
+        // and never evaluate on the executor's threads.
+        const bool topK = limit > 0 && limit < count;
+        const bool parallel = sortExecutor_ && sortWorkers_ > 1 &&
+                              count >= kParallelSortThreshold;
+        bool clean = false;
+        if (topK || parallel) {
+            clean = true;
             try {
-                if (Utils::isNumeric(aa) && Utils::isNumeric(bb)) {
-                    // Numeric comparison
-                    double valA = Utils::toDouble(aa);
-                    double valB = Utils::toDouble(bb);
-
-                    if (valA == valB) {
-                        comp = 0;
-                    } else if (valA < valB) {
-                        comp = -1;
-                    } else {
-                        comp = 1;
-                    }
-                } else if (aa.type() == typeid(std::string) &&
-                           bb.type() == typeid(std::string)) {
-                    // String comparison
-                    auto strA = std::any_cast<std::string>(aa);
-                    auto strB = std::any_cast<std::string>(bb);
-
-                    if (strA == strB) {
-                        comp = 0;
-                    } else if (strA < strB) {
-                        comp = -1;
-                    } else {
-                        comp = 1;
-                    }
+                for (size_t i = 0; i < count; i++) {
+                    evaluateKeys(i, 0, termCount);
                 }
-
-                // Handle descending order (check both descending flag and
-                // value)
-                bool isDescending = term->descending;
-                if (term->value.has_value()) {
-                    try {
-                        std::string valueStr =
-                            std::any_cast<std::string>(term->value);
-                        if (valueStr == "descending") {
-                            isDescending = true;
-                        }
-                    } catch (const std::bad_any_cast&) {
-                        // Not a string, ignore
+            } catch (const JException&) {
+                clean = false;
+            }
+            for (size_t t = 0; clean && t < termCount; t++) {
+                SortKey::Kind kind = SortKey::Kind::Undefined;
+                for (size_t i = 0; i < count; i++) {
+                    SortKey::Kind k = keys[i * termCount + t].kind;
+                    if (k == SortKey::Kind::Undefined) continue;
+                    if (k == SortKey::Kind::Invalid ||
+                        (kind != SortKey::Kind::Undefined && k != kind)) {
+                        clean = false;
+                        break;
                     }
+                    kind = k;
                 }
+            }
+        }
 
-                if (isDescending) {
-                    comp = -comp;
+        if (clean && topK) {
+            // Bounded heap selection of the first items; ties fall back to
+            // input order so they match the stable sort
+            std::partial_sort(order.begin(), order.begin() + limit,
+                              order.end(), [&](size_t a, size_t b) {
+                                  int comp = compare(a, b);
+                                  return comp != 0 ? comp < 0 : a < b;
+                              });
+            order.resize(limit);
+        } else if (clean && parallel) {
+            // Stable merge sort: sort contiguous chunks as separate tasks,
+            // then merge neighbours pairwise. Merging keeps the left run
+            // first on ties, so the result is identical to a sequential
+            // stable sort.
+            const size_t chunks = sortWorkers_;
+            std::vector<size_t> bounds;
+            for (size_t c = 0; c <= chunks; c++) {
+                bounds.push_back(count * c / chunks);
+            }
+            std::vector<std::function<void()>> tasks;
+            for (size_t c = 0; c < chunks; c++) {
+                tasks.push_back([&, c] {
+                    std::stable_sort(order.begin() + bounds[c],
+                                     order.begin() + bounds[c + 1], less);
+                });
+            }
+            runSortTasks(tasks);
+            for (size_t width = 1; width < chunks; width *= 2) {
+                tasks.clear();
+                for (size_t c = 0; c + width < chunks; c += 2 * width) {
+                    size_t lo = bounds[c];
+                    size_t mid = bounds[c + width];
+                    size_t hi = bounds[std::min(c + 2 * width, chunks)];
+                    tasks.push_back([&, lo, mid, hi] {
+                        std::inplace_merge(order.begin() + lo,
+                                           order.begin() + mid,
+                                           order.begin() + hi, less);
+                    });
+                }
+                runSortTasks(tasks);
+            }
+        } else {
+            if (count > 1) {
+                for (size_t i = 0; i < count; i++) {
+                    keyOf(i, 0);
                 }
-
-            } catch (const std::bad_any_cast&) {
-                throw JException(
-                    "T2008", expr->position,
-                    "Invalid values for comparison in sort expression");
             }
+            std::stable_sort(order.begin(), order.end(), less);
         }
-
-        // Return true if a < b (for ascending sort)
-        return comp < 0;
-    };
-
-    // Perform the sort using the custom comparator
-    try {
-        std::sort(arrayToSort.begin(), arrayToSort.end(), comparator);
     } catch (const JException&) {
         throw;  // Re-throw JSONata exceptions
     } catch (const std::exception& e) {
@@ -1712,9 +2353,19 @@ std::any Jsonata::evaluateSort(std::shared_ptr<Parser::Symbol> expr,
                          "Error during sort operation");
     }
 
+    std::vector<std::any> sorted;
+    sorted.reserve(order.size());
+    for (size_t i : order) {
+        sorted.push_back(std::move(arrayToSort[i]));
+    }
+    arrayToSort.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        arrayToSort[i] = std::move(sorted[i]);
+    }
+
     // Return sorted result - preserve input type if input was special type
     if (input.type() == typeid(Utils::JList)) {
-        Utils::JList result(arrayToSort);
+        Utils::JList result(std::move(arrayToSort));
         if (isTupleSort) {
             result.tupleStream = true;
         }
@@ -1835,20 +2486,10 @@ std::any Jsonata::evaluateParent(std::shared_ptr<Parser::Symbol> expr,
                                  const std::any& input,
                                  std::shared_ptr<Frame> environment) {
     // Parent operator: % (refers to parent context)
-    // Java reference: result = environment.lookup(expr.slot.label);
-    if (expr->slot.has_value()) {
-        try {
-            auto slotSymbol =
-                std::any_cast<std::shared_ptr<Parser::Symbol>>(expr->slot);
-            if (slotSymbol && !slotSymbol->label.empty()) {
-                auto result = environment->lookup(slotSymbol->label);
-                if (result.has_value()) {
-                    return result;
-                }
-            }
-        } catch (const std::bad_any_cast&) {
-            // Handle conversion error - slot is not a Symbol pointer
-        }
+    // Java reference: result = environment.lookup(expr.slot.label); the
+    // label's Frame::Slot is resolved by the parser
+    if (expr->ancestorSlot != Frame::kNoSlot) {
+        return environment->lookup(expr->ancestorSlot);
     }
 
     // If no slot or label, return null like Java would for undefined lookup
@@ -1857,26 +2498,32 @@ std::any Jsonata::evaluateParent(std::shared_ptr<Parser::Symbol> expr,
 
 std::any Jsonata::evaluateFilter(std::shared_ptr<Parser::Symbol> predicate,
                                  const std::any& input,
-                                 std::shared_ptr<Frame> environment) {
+                                 std::shared_ptr<Frame> environment,
+                                 std::optional<int64_t> stop) {
     // Java reference lines 488-526: Apply filter predicate to input data
     Utils::JList results = Utils::createSequence();
 
-    // Java lines 491-493: handle tuple stream flag
-    Utils::JList inputSequence;
-    if (input.type() == typeid(Utils::JList)) {
-        inputSequence = std::any_cast<Utils::JList>(input);
-        if (inputSequence.tupleStream) {
-            results.tupleStream = true;
+    // Java lines 491-493: handle tuple stream flag. A list input is read in
+    // place; anything else is converted once
+    Utils::JList converted;
+    const bool isList = input.type() == typeid(Utils::JList);
+    if (!isList) {
+        if (!Utils::isArray(input)) {
+            converted = Utils::createSequence(input);
+        } else {
+            // If input is an array, convert it to a sequence
+            // This ensures we handle arrays like Java's JList
+            converted = Utils::arrayify(input);
         }
-    } else if (!Utils::isArray(input)) {
-        inputSequence = Utils::createSequence(input);
-    } else {
-        // If input is an array, convert it to a sequence
-        // This ensures we handle arrays like Java's JList
-        inputSequence = Utils::arrayify(input);
+    }
+    const Utils::JList& inputSequence =
+        isList ? std::any_cast<const Utils::JList&>(input) : converted;
+    const bool isTupleStream = isList && inputSequence.tupleStream;
+    if (isTupleStream) {
+        results.tupleStream = true;
     }
 
-    if (predicate->type == "number") {
+    if (predicate->nodeType() == Parser::NodeType::Number) {
         // Index-based filtering - Java: if (predicate.type.equals("number"))
         try {
             if (!Utils::isNumber(predicate->value)) {
@@ -1909,68 +2556,185 @@ std::any Jsonata::evaluateFilter(std::shared_ptr<Parser::Symbol> predicate,
     } else {
         // Expression-based filtering - Java: for (int index = 0; index <
         // ((List)input).size(); index++)
-        for (size_t index = 0; index < inputSequence.size(); index++) {
-            auto item = inputSequence[index];
-            std::any context = item;
-            std::shared_ptr<Frame> env = environment;
-
-            bool isTupleStream = false;
-            if (input.type() == typeid(Utils::JList)) {
-                auto jlist = std::any_cast<Utils::JList>(input);
-                isTupleStream = jlist.tupleStream;
-            }
-            if (isTupleStream &&
-                item.type() ==
-                    typeid(nlohmann::ordered_map<std::string, std::any>)) {
-                auto tupleMap =
-                    std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                        item);
-                auto it = tupleMap.find("@");
-                if (it != tupleMap.end()) {
-                    context = it->second;
-                    env = createFrameFromTuple(environment, tupleMap);
-                }
+        // A bounded scan stops once it holds the matches the following index
+        // can pick: the first stop+1, or the last -stop read from the end
+        const size_t size = inputSequence.size();
+        const bool fromEnd = stop && *stop < 0;
+        const size_t wanted =
+            stop ? static_cast<size_t>(fromEnd ? -*stop : *stop + 1) : 0;
+        size_t found = 0;
+        std::any rangeItem;
+        TupleFrame tupleFrame(*this, environment);
+        for (size_t n = 0; n < size; n++) {
+            const size_t index = fromEnd ? size - 1 - n : n;
+            // Items are read in place; only matches are copied
+            const std::any& item =
+                inputSequence.isRange()
+                    ? (rangeItem = inputSequence[index])
+                    : static_cast<const Utils::ItemVector&>(
+                          inputSequence)[index];
+            const size_t before = results.size();
+            const std::any* context = &item;
+            const std::shared_ptr<Frame>* env = &environment;
+
+            const auto* tuple =
+                isTupleStream ? std::any_cast<Tuple>(&item) : nullptr;
+            if (tuple != nullptr) {
+                context = tuple->context.get();
+                env = &tupleFrame.enter(*tuple);
             }
 
             // Java: var res = /* await */ evaluate(predicate, context, env);
-            auto res = evaluate(predicate, context, env);
+            auto res = evaluate(predicate, *context, *env);
+            tupleFrame.leave();
 
-            // Java reference lines 521-523: Handle numeric results as sequences
-            if (Utils::isNumeric(res)) {
-                res = Utils::createSequence(res);
+            for (size_t m = filterMatches(res, index, size); m > 0; m--) {
+                results.push_back(item);
             }
 
-            // Java reference lines 524-538: Handle array of numbers case
-            if (Utils::isArrayOfNumbers(res)) {
-                try {
-                    auto numArray = Utils::arrayify(res);
-                    for (const auto& ires : numArray) {
-                        // round it down (following Java logic)
-                        int64_t ii = Utils::toLong(ires);
-
-                        if (ii < 0) {
-                            // count in from end of array
-                            ii = static_cast<int64_t>(inputSequence.size()) + ii;
-                        }
-                        if (ii == static_cast<int64_t>(index)) {
-                            results.push_back(item);
-                        }
-                    }
-                } catch (const std::bad_any_cast&) {
-                    // Fall through to truthy check
-                    if (boolize(res)) {
-                        results.push_back(item);
-                    }
+            // Empty arrays are not counted: they vanish when the step's
+            // results are flattened, which matters to firstMatch filters
+            if (stop && results.size() > before && !isEmptyArray(item)) {
+                found += results.size() - before;
+                if (found >= wanted) {
+                    break;
                 }
-            } else if (boolize(res)) {  // truthy
-                results.push_back(item);
             }
         }
+        if (fromEnd) {
+            std::reverse(results.begin(), results.end());
+        }
     }
 
     return results;
 }
 
+/* static */ size_t Jsonata::filterMatches(const std::any& res, size_t index,
+                                           size_t size) {
+    // Java reference lines 521-523: Handle numeric results as sequences
+    if (Utils::isNumeric(res)) {
+        return filterMatches(std::any(Utils::createSequence(res)), index,
+                             size);
+    }
+
+    // Java reference lines 524-538: Handle array of numbers case
+    if (Utils::isArrayOfNumbers(res)) {
+        try {
+            size_t matches = 0;
+            for (const auto& ires : Utils::arrayify(res)) {
+                // round it down (following Java logic)
+                int64_t ii = Utils::toLong(ires);
+
+                if (ii < 0) {
+                    // count in from end of array
+                    ii = static_cast<int64_t>(size) + ii;
+                }
+                if (ii == static_cast<int64_t>(index)) {
+                    matches++;
+                }
+            }
+            return matches;
+        } catch (const std::bad_any_cast&) {
+            // Fall through to truthy check
+        }
+    }
+    return boolize(res) ? 1 : 0;
+}
+
+/* static */ std::optional<int64_t> Jsonata::filterStop(
+    const std::vector<std::shared_ptr<Parser::Symbol>>& filters, size_t i) {
+    if (filters[i]->expr.type() != typeid(std::shared_ptr<Parser::Symbol>) ||
+        !neverThrows(std::any_cast<const std::shared_ptr<Parser::Symbol>&>(
+            filters[i]->expr))) {
+        return std::nullopt;
+    }
+    if (filters[i]->firstMatch) {
+        return 0;
+    }
+    if (i + 1 >= filters.size()) {
+        return std::nullopt;
+    }
+    const auto& next = filters[i + 1];
+    if (!next || next->nodeType() != Parser::NodeType::Filter ||
+        next->expr.type() != typeid(std::shared_ptr<Parser::Symbol>)) {
+        return std::nullopt;
+    }
+    const auto& index =
+        std::any_cast<const std::shared_ptr<Parser::Symbol>&>(next->expr);
+    if (!index || index->nodeType() != Parser::NodeType::Number ||
+        !Utils::isNumber(index->value)) {
+        return std::nullopt;
+    }
+    return Utils::toLong(index->value);
+}
+
+/* static */ bool Jsonata::neverThrows(
+    const std::shared_ptr<Parser::Symbol>& expr) {
+    if (!expr || expr->invariant || expr->join) {
+        return false;
+    }
+    const bool plain = expr->predicate.empty() && expr->stages.empty() &&
+                       !expr->group && !expr->tuple.has_value();
+    switch (expr->nodeType()) {
+        case Parser::NodeType::String:
+        case Parser::NodeType::Number:
+            return true;
+        case Parser::NodeType::Value:
+            // A folded builtin call may run its subtree instead
+            return expr->arguments.empty();
+        case Parser::NodeType::Name:
+        case Parser::NodeType::Variable:
+            return plain;
+        case Parser::NodeType::Path:
+            return !expr->fields.empty();
+        case Parser::NodeType::Binary:
+            switch (expr->opCode()) {
+                case Parser::OpCode::Equal:
+                case Parser::OpCode::NotEqual:
+                case Parser::OpCode::In:
+                case Parser::OpCode::And:
+                case Parser::OpCode::Or:
+                    return neverThrows(expr->lhs) && neverThrows(expr->rhs);
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+/* static */ size_t Jsonata::sortLimit(
+    const std::vector<std::shared_ptr<Parser::Symbol>>& stages) {
+    if (stages.empty() || !stages[0] ||
+        stages[0]->nodeType() != Parser::NodeType::Filter ||
+        stages[0]->expr.type() != typeid(std::shared_ptr<Parser::Symbol>)) {
+        return 0;
+    }
+    const auto& index =
+        std::any_cast<const std::shared_ptr<Parser::Symbol>&>(stages[0]->expr);
+    if (!index) {
+        return 0;
+    }
+    // Negative indexes count from the end, so they need every item
+    int64_t last = -1;
+    if (index->nodeType() == Parser::NodeType::Number &&
+        Utils::isNumber(index->value)) {
+        last = Utils::toLong(index->value);
+    } else if (index->nodeType() == Parser::NodeType::Value &&
+               index->arguments.empty() &&
+               Utils::isArrayOfNumbers(index->value)) {
+        // A folded constant array such as [0..9] (see Optimizer.h)
+        for (const auto& item : Utils::arrayify(index->value)) {
+            int64_t i = Utils::toLong(item);
+            if (i < 0) {
+                return 0;
+            }
+            last = std::max(last, i);
+        }
+    }
+    return last < 0 ? 0 : static_cast<size_t>(last) + 1;
+}
+
 std::any Jsonata::evaluateBlock(std::shared_ptr<Parser::Symbol> expr,
                                 const std::any& input,
                                 std::shared_ptr<Frame> environment) {
@@ -2280,13 +3044,40 @@ void Jsonata::registerFunction(
     std::function<std::any(const Utils::JList&)> implementation) {
     JFunction jfunc;
     jfunc.implementation = [implementation](const Utils::JList& args,
-                                            const std::any& input,
-                                            std::shared_ptr<Frame> env) {
+                                            const EvalContext&) {
         return implementation(args);
     };
     registerFunction(name, jfunc);
 }
 
+void Jsonata::setSortExecutor(SortExecutor executor, size_t maxWorkers) {
+    sortExecutor_ = std::move(executor);
+    sortWorkers_ = std::min(maxWorkers, kMaxSortWorkers);
+}
+
+void Jsonata::runSortTasks(const std::vector<std::function<void()>>& tasks) {
+    // Each task catches its own exception, which is rethrown here on the
+    // evaluating thread once the executor has run them all
+    std::vector<std::exception_ptr> errors(tasks.size());
+    std::vector<std::function<void()>> guarded;
+    guarded.reserve(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+        guarded.push_back([&tasks, &errors, i] {
+            try {
+                tasks[i]();
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    sortExecutor_(guarded);
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
 bool Jsonata::isValidateInput() const { return validateInput_; }
 
 void Jsonata::setValidateInput(bool validateInput) {
@@ -2295,45 +3086,51 @@ void Jsonata::setValidateInput(bool validateInput) {
 
 std::vector<std::exception_ptr> Jsonata::getErrors() const { return errors_; }
 
-std::shared_ptr<Frame> Jsonata::createFrameFromTuple(
-    std::shared_ptr<Frame> environment, const std::any& tupleAny) {
-    // Java reference lines 324-329: createFrameFromTuple implementation
-    auto frame = createFrame(environment);
-    auto tuple =
-        std::any_cast<nlohmann::ordered_map<std::string, std::any>>(tupleAny);
-    for (const auto& [key, value] : tuple) {
-        frame->bind(key, value);
-    }
-    return frame;
-}
-
-std::any Jsonata::reduceTupleStream(const std::any& tupleStream) {
+/* static */ Tuple Jsonata::reduceTupleStream(const std::any& tupleStream) {
     // Java reference lines 1137-1160: reduceTupleStream implementation
-    if (tupleStream.type() != typeid(Utils::JList)) {
-        return tupleStream;
+    if (const auto* tuple = std::any_cast<Tuple>(&tupleStream)) {
+        return *tuple;
     }
-
-    auto tuples = std::any_cast<Utils::JList>(tupleStream);
-
-    if (tuples.empty()) {
-        return std::any{};
+    const auto* list = std::any_cast<Utils::JList>(&tupleStream);
+    if (list == nullptr || list->empty()) {
+        return Tuple{};
+    }
+    const auto& tuples = static_cast<const Utils::ItemVector&>(*list);
+    const auto& first = std::any_cast<const Tuple&>(tuples[0]);
+    if (tuples.size() == 1) {
+        return first;
     }
 
-    nlohmann::ordered_map<std::string, std::any> result;
-    // Java line 1144: result.putAll(tupleStream.get(0));
-    result =
-        std::any_cast<nlohmann::ordered_map<std::string, std::any>>(tuples[0]);
+    // Java line 1144: result.putAll(tupleStream.get(0)); the values are
+    // copied, since the merge extends them in place
+    auto copy = [](const Tuple::Value& value) {
+        return std::make_shared<std::any>(value ? *value : std::any{});
+    };
+    Tuple result;
+    result.context = copy(first.context);
+    result.bindings.reserve(first.bindings.size());
+    for (const auto& [slot, value] : first.bindings) {
+        result.bindings.emplace_back(slot, copy(value));
+    }
 
-    // Java lines 1147-1158: merge remaining tuples
+    // Java lines 1147-1158: merge remaining tuples. Each variable's list is
+    // extended in place, so the merge is linear in the number of values
     for (size_t i = 1; i < tuples.size(); i++) {
-        const auto& el =
-            std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                tuples[i]);
-        for (const auto& [prop, value] : el) {
+        const auto& el = std::any_cast<const Tuple&>(tuples[i]);
+        if (el.context) {
+            Functions::appendTo(*result.context, *el.context);
+        }
+        for (const auto& [slot, value] : el.bindings) {
             // Java line 1154: result.put(prop,
             // Functions.append(result.get(prop), el.get(prop)));
-            Utils::JList appendArgs = {result[prop], value};
-            result[prop] = Functions::append(appendArgs);
+            auto merged = std::find_if(
+                result.bindings.begin(), result.bindings.end(),
+                [&](const auto& binding) { return binding.first == slot; });
+            if (merged == result.bindings.end()) {
+                merged = result.bindings.emplace(
+                    merged, slot, std::make_shared<std::any>());
+            }
+            Functions::appendTo(*merged->second, *value);
         }
     }
 
@@ -2358,8 +3155,6 @@ std::any jsonata_evaluate(const std::string& expression,
 thread_local Jsonata* Jsonata::currentInstance_ = nullptr;
 thread_local std::unique_ptr<Jsonata> Jsonata::ownedInstance_ = nullptr;
 thread_local std::shared_ptr<Parser> Jsonata::currentParser_ = nullptr;
-thread_local std::any Jsonata::tls_input_;
-thread_local std::shared_ptr<Frame> Jsonata::tls_environment_ = nullptr;
 
 Jsonata* Jsonata::getCurrentInstance() { return currentInstance_; }
 
@@ -2406,12 +3201,12 @@ Jsonata* Jsonata::getPerThreadInstance() {
     // Release owned per-thread instance and clear raw pointer.
     ownedInstance_.reset();
     currentInstance_ = nullptr;
-    // Also clear TLS evaluation context to drop references promptly.
-    tls_input_.reset();
-    tls_environment_.reset();
 }
 
-Jsonata::Jsonata(const std::string& jsonataExpression) {
+Jsonata::Jsonata(const std::string& jsonataExpression)
+    : Jsonata(jsonataExpression, true) {}
+
+Jsonata::Jsonata(const std::string& jsonataExpression, bool optimize) {
     currentInstance_ = this;
     // Initialize environment like Java does: environment =
     // createFrame(staticFrame)
@@ -2420,6 +3215,9 @@ Jsonata::Jsonata(const std::string& jsonataExpression) {
     // Parse the expression
     Parser parser;
     expression_ = parser.parse(jsonataExpression);
+    if (optimize) {
+        expression_ = jsonata::optimize(expression_, *this);
+    }
 }
 
 Jsonata::Jsonata(const Jsonata& other) {
@@ -2430,6 +3228,8 @@ Jsonata::Jsonata(const Jsonata& other) {
     expression_ = other.expression_;
     environment_ = other.environment_;
     timestamp_ = other.timestamp_;
+    sortExecutor_ = other.sortExecutor_;
+    sortWorkers_ = other.sortWorkers_;
 }
 
 nlohmann::ordered_json Jsonata::evaluate(const nlohmann::ordered_json& input) {
@@ -2438,6 +3238,15 @@ nlohmann::ordered_json Jsonata::evaluate(const nlohmann::ordered_json& input) {
 
 nlohmann::ordered_json Jsonata::evaluate(const nlohmann::ordered_json& input,
                                          std::shared_ptr<Frame> bindings) {
+    // Convert JSON input to std::any domain for the evaluator, and the
+    // result back to nlohmann::ordered_json
+    return anyToOrderedJson(
+        evaluateInput(orderedJsonToAny(input), bindings, nullptr));
+}
+
+std::any Jsonata::evaluateInput(
+    const std::any& anyInput, std::shared_ptr<Frame> bindings,
+    const std::shared_ptr<const vm::Program>& program) {
     currentInstance_ = this;
 
     // Check for syntax errors (equivalent to Java's check for errors != null)
@@ -2445,17 +3254,20 @@ nlohmann::ordered_json Jsonata::evaluate(const nlohmann::ordered_json& input,
         throw JException("S0500", 0);  // Expression compilation failed
     }
 
-    // Convert JSON input to std::any domain for the evaluator
-    std::any anyInput = orderedJsonToAny(input);
-
     // Always evaluate in a fresh child frame of the shared environment,
     // then (optionally) copy provided bindings into it. This avoids
-    // concurrent mutations of the shared environment.
-    std::shared_ptr<Frame> exec_env = createFrame(environment_);
+    // concurrent mutations of the shared environment. The frame roots the
+    // evaluation's arena, which every frame created beneath it draws from;
+    // sequences grown until the result is copied out below draw from it too.
+    auto arena = EvaluationArena::create();
+    std::optional<EvaluationArena::Scope> arenaScope(std::in_place,
+                                                     arena.get());
+    std::shared_ptr<Frame> exec_env = std::allocate_shared<Frame>(
+        ArenaAllocator<Frame>(arena), environment_, arena);
+    exec_env->makeRoot(expression_->scope);
     if (bindings != nullptr) {
-        for (const auto& [key, value] : bindings->getBindings()) {
-            exec_env->bind(key, value);
-        }
+        exec_env->bindAll(*bindings);
+        exec_env->observeFrom(bindings);
     }
 
     // TODO: capture timestamp for $now() and $millis() functions
@@ -2485,21 +3297,18 @@ nlohmann::ordered_json Jsonata::evaluate(const nlohmann::ordered_json& input,
     }
 
     std::any result;
-    try {
-        // Set thread-local input/environment for this evaluation
-        tls_input_ = processedInput;
-        tls_environment_ = exec_env;
+    // Observers (e.g. Timebox) see every node, which only the tree walker
+    // reports; compiled programs run only when none is installed
+    if (program != nullptr && exec_env->getObserver() == nullptr) {
+        result = vm::execute(program, program->entry, *this, processedInput,
+                             exec_env);
+    } else {
         result = evaluate(expression_, processedInput, exec_env);
-        // Clear TLS after evaluation to avoid dangling references
-        tls_input_.reset();
-        tls_environment_.reset();
-        result = Utils::convertNulls(result);
-        // Convert result back to nlohmann::ordered_json
-        return anyToOrderedJson(result);
-    } catch (const std::exception& err) {
-        // TODO: populateMessage(err);
-        throw;
     }
+    // convertNulls copies the result, so with the arena no longer current
+    // the returned value holds no arena buffers
+    arenaScope.reset();
+    return Utils::convertNulls(result);
 }
 
 nlohmann::ordered_json Jsonata::evaluate(std::nullptr_t) {
@@ -2518,49 +3327,7 @@ nlohmann::json Jsonata::evaluate(const nlohmann::json& input) {
 
 nlohmann::json Jsonata::evaluate(const nlohmann::json& input,
                                  std::shared_ptr<Frame> bindings) {
-    currentInstance_ = this;
-
-    if (!expression_) {
-        throw JException("S0500", 0);
-    }
-
-    // Convert JSON input to std::any domain for the evaluator
-    std::any anyInput = jsonToAny(input);
-
-    std::shared_ptr<Frame> exec_env = createFrame(environment_);
-    if (bindings != nullptr) {
-        for (const auto& [key, value] : bindings->getBindings()) {
-            exec_env->bind(key, value);
-        }
-    }
-
-    std::any processedInput = anyInput;
-    if (anyInput.has_value() && Utils::isArray(anyInput) &&
-        !Utils::isSequence(anyInput)) {
-        auto sequence = Utils::createSequence(anyInput);
-        sequence.outerWrapper = true;
-        processedInput = sequence;
-    }
-
-    exec_env->bind("$", processedInput);
-
-    if (validateInput_) {
-        Functions::validateInput(processedInput);
-    }
-
-    std::any result;
-    try {
-        tls_input_ = processedInput;
-        tls_environment_ = exec_env;
-        result = evaluate(expression_, processedInput, exec_env);
-        tls_input_.reset();
-        tls_environment_.reset();
-        result = Utils::convertNulls(result);
-        // Convert result to nlohmann::json
-        return anyToJson(result);
-    } catch (const std::exception& err) {
-        throw;
-    }
+    return anyToJson(evaluateInput(jsonToAny(input), bindings, nullptr));
 }
 
 nlohmann::json Jsonata::evaluateUnordered(std::nullptr_t) {
@@ -2592,9 +3359,6 @@ std::any Jsonata::apply(const std::any& proc, const Utils::JList& args,
                 // Java line 1680: var next = /* await */
                 // evaluate(((Symbol)result).body.procedure,
                 // ((Symbol)result).input, ((Symbol)result).environment);
-                auto instance = getCurrentInstance();
-                if (!instance) break;
-
                 std::any symbolInput, symbolEnv;
                 if (symbolResult->input.has_value())
                     symbolInput = symbolResult->input;
@@ -2608,11 +3372,12 @@ std::any Jsonata::apply(const std::any& proc, const Utils::JList& args,
                     envFrame = environment;  // fallback
                 }
 
-                auto next = instance->evaluate(symbolResult->body->procedure,
-                                               symbolInput, envFrame);
+                auto next = evaluate(symbolResult->body->procedure,
+                                     symbolInput, envFrame);
 
                 // Java lines 1681-1686: handle variable references
-                if (symbolResult->body->procedure->type == "variable") {
+                if (symbolResult->body->procedure->nodeType() ==
+                    Parser::NodeType::Variable) {
                     if (next.type() ==
                         typeid(std::shared_ptr<Parser::Symbol>)) {
                         auto nextSymbol =
@@ -2629,7 +3394,7 @@ std::any Jsonata::apply(const std::any& proc, const Utils::JList& args,
                 Utils::JList evaluatedArgs;
                 for (const auto& arg : symbolResult->body->arguments) {
                     evaluatedArgs.push_back(
-                        instance->evaluate(arg, symbolInput, envFrame));
+                        evaluate(arg, symbolInput, envFrame));
                 }
 
                 // Java line 1692: result = /* await */ applyInner(next,
@@ -2665,7 +3430,7 @@ static std::any regexClosure(std::shared_ptr<RegexState> state) {
     groups.push_back(std::string(match.str()));
     result["groups"] = std::any(groups);
     JFunction nextFn;
-    nextFn.implementation = [state](const Utils::JList&, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    nextFn.implementation = [state](const Utils::JList&, const EvalContext&) -> std::any {
         return regexClosure(state);
     };
     result["next"] = std::any(nextFn);
@@ -2718,7 +3483,7 @@ std::any Jsonata::applyInner(const std::any& proc, const Utils::JList& args,
 
         // Check if it's a JFunction (Java lines 1730-1743)
         if (proc.type() == typeid(JFunction)) {
-            auto jfunc = std::any_cast<JFunction>(proc);
+            const auto& jfunc = std::any_cast<const JFunction&>(proc);
             if (jfunc.implementation) {
                 // handling special case: when calling a function with args =
                 // [undefined] Javascript will convert to undefined (without
@@ -2731,7 +3496,8 @@ std::any Jsonata::applyInner(const std::any& proc, const Utils::JList& args,
 
                 // Call the function - Java line 1743: result =
                 // ((JFunction)proc).call(input, (List)validatedArgs);
-                return jfunc.implementation(validatedArgs, input, environment);
+                return jfunc.implementation(
+                    validatedArgs, EvalContext{*this, input, environment});
             }
         }
 
@@ -2752,7 +3518,7 @@ Utils::JList Jsonata::validateArguments(const std::any& signature,
     if (Utils::isFunction(signature)) {
         // Implement JFunction signature validation to match Java
         try {
-            const auto& jfunc = std::any_cast<JFunction>(signature);
+            const auto& jfunc = std::any_cast<const JFunction&>(signature);
             if (jfunc.signature) {
                 // Validate args against the JFunction's signature, using input
                 // as context
@@ -2850,29 +3616,18 @@ std::any Jsonata::applyProcedure(const std::any& _proc,
                             environment = std::any_cast<std::shared_ptr<Frame>>(
                                 closureMap["environment"]);
                         } catch (const std::bad_any_cast&) {
-                            auto instance = getCurrentInstance();
-                            environment = instance ? instance->getEnvironment()
-                                                   : std::make_shared<Frame>();
+                            environment = environment_;
                         }
                     } else {
-                        auto instance = getCurrentInstance();
-                        environment = instance ? instance->getEnvironment()
-                                               : std::make_shared<Frame>();
+                        environment = environment_;
                     }
                 } else {
-                    auto instance = getCurrentInstance();
-                    environment = instance ? instance->getEnvironment()
-                                           : std::make_shared<Frame>();
+                    environment = environment_;
                 }
 
                 // Apply pattern matching and transformation - exact Java logic
                 // lines 1434-1487
-                auto instance = getCurrentInstance();
-                if (!instance) {
-                    throw JException("No current Jsonata instance available");
-                }
-                auto _matches =
-                    instance->evaluate(pattern, result, environment);
+                auto _matches = evaluate(pattern, result, environment);
 
                 if (_matches.has_value()) {
                     // Convert to array if not already array
@@ -3067,7 +3822,7 @@ std::any Jsonata::applyProcedure(const std::any& _proc,
                         auto match = matches[i];
                         // Evaluate update in the context of the match
                         auto updateValue =
-                            instance->evaluate(update, match, environment);
+                            evaluate(update, match, environment);
                         if (updateValue.has_value()) {
                             if (updateValue.type() !=
                                 typeid(nlohmann::ordered_map<std::string,
@@ -3100,8 +3855,8 @@ std::any Jsonata::applyProcedure(const std::any& _proc,
                         }
 
                         if (delete_expr) {
-                            auto deletions = instance->evaluate(
-                                delete_expr, match, environment);
+                            auto deletions =
+                                evaluate(delete_expr, match, environment);
                             if (deletions.has_value()) {
                                 auto val = deletions;
                                 if (!Utils::isArray(deletions)) {
@@ -3138,46 +3893,34 @@ std::any Jsonata::applyProcedure(const std::any& _proc,
         try {
             auto symbolEnv =
                 std::any_cast<std::shared_ptr<Frame>>(symbol->environment);
-            auto instance = getCurrentInstance();
-            env = instance ? instance->createFrame(symbolEnv)
-                           : std::make_shared<Frame>();
+            env = createFrame(symbolEnv);
         } catch (const std::bad_any_cast&) {
             // Fallback if environment is not a Frame - this shouldn't normally
             // happen
-            auto instance = getCurrentInstance();
-            env = instance ? instance->createFrame(instance->getEnvironment())
-                           : std::make_shared<Frame>();
+            env = createFrame(environment_);
         }
 
         // Java lines 1888-1891: bind arguments to parameter names
         for (size_t i = 0; i < symbol->arguments.size() && i < args.size();
              ++i) {
-            if (symbol->arguments[i] &&
-                symbol->arguments[i]->value.has_value()) {
-                try {
-                    auto paramName =
-                        std::any_cast<std::string>(symbol->arguments[i]->value);
-                    env->bind(paramName, args[i]);
-                } catch (const std::bad_any_cast&) {
-                    // Skip if not a string value
+            if (symbol->arguments[i]) {
+                // Skip if not a string value
+                Frame::Slot slot = symbol->arguments[i]->variableSlot();
+                if (slot != Frame::kNoSlot) {
+                    env->bind(slot, args[i]);
                 }
             }
         }
 
         // Java lines 1892-1894: evaluate the body
+        // The captured input is read in place; copying it on every call
+        // made $map and friends quadratic in the size of the input
+        if (symbol->program && env->getObserver() == nullptr) {
+            return vm::execute(symbol->program, symbol->entry, *this,
+                               symbol->input, env);
+        }
         if (symbol->body) {
-            std::any inputValue;
-            if (symbol->input.has_value()) {
-                inputValue = symbol->input;
-            } else {
-                inputValue = std::any{};
-            }
-            auto instance = getCurrentInstance();
-            if (!instance) {
-                throw JException("No current Jsonata instance available");
-            }
-            auto result = instance->evaluate(symbol->body, inputValue, env);
-            return result;
+            return evaluate(symbol->body, symbol->input, env);
         }
 
         return std::any{};
@@ -3189,14 +3932,15 @@ std::any Jsonata::applyProcedure(const std::any& _proc,
 // Java reference lines 383-400: evaluateStages implementation
 std::any Jsonata::evaluateStages(
     const std::vector<std::shared_ptr<Parser::Symbol>>& stages,
-    const std::any& input, std::shared_ptr<Frame> environment) {
-    std::any result = input;
+    std::any input, std::shared_ptr<Frame> environment, size_t first) {
+    std::any result = std::move(input);
 
     // Java lines 384-399: process each stage by type
-    for (const auto& stage : stages) {
+    for (size_t i = first; i < stages.size(); ++i) {
+        const auto& stage = stages[i];
         if (!stage) continue;
 
-        if (stage->type == "filter") {
+        if (stage->nodeType() == Parser::NodeType::Filter) {
             // Java line 389: result = /* await */ evaluateFilter(stage.expr,
             // result, environment);
             if (stage->expr.has_value()) {
@@ -3204,51 +3948,24 @@ std::any Jsonata::evaluateStages(
                     auto filterExpr =
                         std::any_cast<std::shared_ptr<Parser::Symbol>>(
                             stage->expr);
-                    result = evaluateFilter(filterExpr, result, environment);
+                    result = evaluateFilter(filterExpr, result, environment,
+                                            filterStop(stages, i));
                 } catch (const std::bad_any_cast&) {
                     // Skip invalid filter expression
                 }
             }
-        } else if (stage->type == "index") {
-            // Java lines 391-396: handle index stage for tuple streams
-            try {
-                // Handle tuple stream: vector<map<string, any>>
-                if (result.type() == typeid(Utils::JList)) {
-                    auto tupleList = std::any_cast<Utils::JList>(result);
-                    for (size_t ee = 0; ee < tupleList.size(); ee++) {
-                        if (stage->value.has_value()) {
-                            std::string stageValue =
-                                std::any_cast<std::string>(stage->value);
-                            auto tuple = std::any_cast<
-                                nlohmann::ordered_map<std::string, std::any>>(
-                                tupleList[ee]);
-                            tuple[stageValue] = static_cast<int64_t>(ee);
-                            tupleList[ee] = std::any(tuple);
-                        }
-                    }
-                    result = tupleList;
-                } else {
-                    // Handle regular list: vector<any>
-                    auto resultList = Utils::arrayify(result);
-                    for (size_t ee = 0; ee < resultList.size(); ee++) {
-                        if (resultList[ee].type() ==
-                            typeid(
-                                nlohmann::ordered_map<std::string, std::any>)) {
-                            auto tuple = std::any_cast<
-                                nlohmann::ordered_map<std::string, std::any>>(
-                                resultList[ee]);
-                            if (stage->value.has_value()) {
-                                std::string stageValue =
-                                    std::any_cast<std::string>(stage->value);
-                                tuple[stageValue] = static_cast<int64_t>(ee);
-                                resultList[ee] = tuple;
-                            }
-                        }
+        } else if (stage->nodeType() == Parser::NodeType::Index) {
+            // Java lines 391-396: bind the index variable of each tuple in
+            // the stream, which is updated in place
+            auto* tuples = std::any_cast<Utils::JList>(&result);
+            if (tuples != nullptr && stage->indexSlot != Frame::kNoSlot) {
+                for (size_t ee = 0; ee < tuples->size(); ee++) {
+                    if (auto* tuple = std::any_cast<Tuple>(&(*tuples)[ee])) {
+                        tuple->bind(stage->indexSlot,
+                                    std::make_shared<std::any>(
+                                        static_cast<int64_t>(ee)));
                     }
-                    result = resultList;
                 }
-            } catch (const std::bad_any_cast&) {
-                // Skip if not the expected format
             }
         }
     }
@@ -3257,22 +3974,15 @@ std::any Jsonata::evaluateStages(
 }
 
 std::any Jsonata::evaluateStep(std::shared_ptr<Parser::Symbol> expr,
-                               const std::any& input,
+                               const Utils::JList& input,
                                std::shared_ptr<Frame> environment,
                                bool lastStep) {
-    if (!expr || !input.has_value()) return std::any{};
-
-    // Convert input to vector if needed
-    Utils::JList inputSequence;
-    if (Utils::isArray(input)) {
-        inputSequence = Utils::arrayify(input);
-    } else {
-        inputSequence.push_back(input);
-    }
+    if (!expr) return std::any{};
 
     // Java reference lines 342-347: handle sort expressions specially
-    if (expr->type == "sort") {
-        auto result = evaluateSort(expr, input, environment);
+    if (expr->nodeType() == Parser::NodeType::Sort) {
+        auto result = evaluateSort(expr, std::any(input), environment,
+                                   sortLimit(expr->stages));
         if (!expr->stages.empty()) {
             result = evaluateStages(expr->stages, result, environment);
         }
@@ -3281,69 +3991,528 @@ std::any Jsonata::evaluateStep(std::shared_ptr<Parser::Symbol> expr,
 
     // Java reference lines 350-362: evaluate expression for each item
     Utils::JList result = Utils::createSequence();
-    for (const auto& item : inputSequence) {
-        auto res = evaluate(expr, item, environment);
+    for (const auto& item : input) {
+        auto res = evaluateStepItem(expr, item, environment);
+        if (res.has_value()) {
+            result.push_back(std::move(res));
+        }
+    }
 
-        // Apply stages (predicates) - Java lines 354-358
-        if (!expr->stages.empty()) {
-            for (const auto& stage : expr->stages) {
-                if (stage && stage->expr.has_value()) {
-                    try {
-                        auto stageExpr =
-                            std::any_cast<std::shared_ptr<Parser::Symbol>>(
-                                stage->expr);
-                        res = evaluateFilter(stageExpr, res, environment);
-                    } catch (const std::bad_any_cast&) {
-                        // Skip invalid stage
+    // Java reference lines 364-378: flatten the results
+    return flattenStepResults(std::move(result), lastStep);
+}
+
+std::any Jsonata::evaluateStepItem(const std::shared_ptr<Parser::Symbol>& step,
+                                   const std::any& item,
+                                   const std::shared_ptr<Frame>& environment) {
+    std::any res;
+    if (evaluateIndexedField(step, item, environment, res)) {
+        return evaluateStages(step->stages, std::move(res), environment, 1);
+    }
+    res = evaluate(step, item, environment);
+
+    // Apply stages (predicates) - Java lines 354-358
+    return evaluateStages(step->stages, std::move(res), environment);
+}
+
+bool Jsonata::evaluateIndexedField(const std::shared_ptr<Parser::Symbol>& step,
+                                   const std::any& item,
+                                   const std::shared_ptr<Frame>& environment,
+                                   std::any& result) {
+    using ObjectMap = nlohmann::ordered_map<std::string, std::any>;
+    // Only a plain name whose first stage is a constant index; an observer
+    // must see the name evaluated
+    if (step->nodeType() != Parser::NodeType::Name || step->stages.empty() ||
+        !step->predicate.empty() || step->group || step->keepArray ||
+        step->value.type() != typeid(std::string) ||
+        item.type() != typeid(ObjectMap) ||
+        environment->getObserver() != nullptr) {
+        return false;
+    }
+    const auto& stage = step->stages[0];
+    if (!stage || stage->nodeType() != Parser::NodeType::Filter ||
+        stage->expr.type() != typeid(std::shared_ptr<Parser::Symbol>)) {
+        return false;
+    }
+    const auto& index = std::any_cast<const std::shared_ptr<Parser::Symbol>&>(
+        stage->expr);
+    if (!index || index->nodeType() != Parser::NodeType::Number) {
+        return false;
+    }
+
+    const auto& object = std::any_cast<const ObjectMap&>(item);
+    auto it = object.find(std::any_cast<const std::string&>(step->value));
+    if (it == object.end()) {
+        result = evaluateFilter(index, std::any{}, environment);
+        return true;
+    }
+    // evaluate() would hand finishResult's unwrapped value to the filter;
+    // only values it leaves alone are read in place
+    if (!it->second.has_value() || Utils::isSequence(it->second)) {
+        return false;
+    }
+    result = evaluateFilter(index, it->second, environment);
+    return true;
+}
+
+namespace {
+
+// A scalar as compared by Jsonata::deepEquals: int64_t, uint64_t and double
+// numbers by value, strings, booleans and null
+struct JoinKey {
+    enum class Kind : uint8_t { Number, String, Boolean, Null };
+    Kind kind = Kind::Null;
+    double number = 0;
+    std::string text;
+
+    bool operator==(const JoinKey& other) const {
+        return kind == other.kind && number == other.number &&
+               text == other.text;
+    }
+
+    // No key for values deepEquals never finds equal to a scalar, or (NaN)
+    // to anything
+    static std::optional<JoinKey> of(const std::any& value) {
+        JoinKey key;
+        if (Utils::isNullValue(value)) {
+            key.kind = Kind::Null;
+        } else if (value.type() == typeid(std::string)) {
+            key.kind = Kind::String;
+            key.text = std::any_cast<const std::string&>(value);
+        } else if (value.type() == typeid(bool)) {
+            key.kind = Kind::Boolean;
+            key.number = std::any_cast<bool>(value) ? 1 : 0;
+        } else if (value.type() == typeid(double) ||
+                   value.type() == typeid(int64_t) ||
+                   value.type() == typeid(uint64_t)) {
+            key.kind = Kind::Number;
+            // -0.0 and 0.0 are equal and must hash alike
+            key.number = Utils::toDouble(value) + 0.0;
+            if (std::isnan(key.number)) {
+                return std::nullopt;
+            }
+        } else {
+            return std::nullopt;
+        }
+        return key;
+    }
+};
+
+struct JoinKeyHash {
+    size_t operator()(const JoinKey& key) const {
+        return key.kind == JoinKey::Kind::String
+                   ? std::hash<std::string>()(key.text)
+                   : std::hash<double>()(key.number) ^
+                         static_cast<size_t>(key.kind);
+    }
+};
+
+// The items a hash join filters, with the positions of each field value
+struct JoinIndex {
+    // False when an item or its parent is an array, which the step would
+    // flatten differently from the index
+    bool usable = true;
+    std::vector<std::any> items;
+    std::unordered_map<JoinKey, std::vector<size_t>, JoinKeyHash> positions;
+};
+
+}  // namespace
+
+bool Jsonata::evaluateHashJoin(const std::shared_ptr<Parser::Symbol>& path,
+                               const std::any& input,
+                               const std::shared_ptr<Frame>& environment,
+                               std::any& result) {
+    const auto& join = *path->join;
+    // An observer must see the filter evaluated for every item
+    auto* invariants = environment->getInvariants();
+    if (invariants == nullptr || environment->getObserver() != nullptr) {
+        return false;
+    }
+    for (const auto& procedure : join.calls) {
+        if (!callsBuiltin(procedure, environment)) {
+            return false;
+        }
+    }
+
+    std::shared_ptr<JoinIndex> index;
+    auto found = invariants->find(path);
+    if (found != invariants->end()) {
+        index = std::any_cast<const std::shared_ptr<JoinIndex>&>(found->second);
+    } else {
+        // The items are the filter's input for each item of the source,
+        // i.e. what the filtered step yields before its filter
+        index = std::make_shared<JoinIndex>();
+        std::any source = evaluate(join.source, input, environment);
+        Utils::JList parents;
+        if (source.type() == typeid(Utils::JList) &&
+            std::any_cast<const Utils::JList&>(source).cons) {
+            index->usable = false;
+        } else if (Utils::isArray(source)) {
+            parents = Utils::arrayify(source);
+        } else if (source.has_value()) {
+            parents.push_back(std::move(source));
+        }
+        for (size_t p = 0; index->usable && p < parents.size(); p++) {
+            if (Utils::isArray(parents[p])) {
+                index->usable = false;
+                break;
+            }
+            std::any value = evaluate(join.step, parents[p], environment);
+            if (!value.has_value()) {
+                continue;
+            }
+            Utils::JList items = Utils::isArray(value)
+                                     ? Utils::arrayify(value)
+                                     : Utils::createSequence(value);
+            for (auto& item : items) {
+                if (Utils::isArray(item)) {
+                    index->usable = false;
+                    break;
+                }
+                auto key =
+                    JoinKey::of(evaluate(join.field, item, environment));
+                if (key) {
+                    index->positions[*key].push_back(index->items.size());
+                }
+                index->items.push_back(std::move(item));
+            }
+        }
+        invariants->emplace(path, index);
+    }
+    if (!index->usable) {
+        return false;
+    }
+
+    // The key is only read when the filter would have read it
+    if (index->items.empty()) {
+        result = std::any{};
+        return true;
+    }
+    std::any value = evaluate(join.key, index->items[0], environment);
+    if (!value.has_value()) {
+        result = std::any{};
+        return true;
+    }
+    auto key = JoinKey::of(value);
+    if (!key) {
+        // Arrays and objects are compared deeply; NaN matches nothing
+        if (!Utils::isNumber(value)) {
+            return false;
+        }
+        result = std::any{};
+        return true;
+    }
+    auto matches = index->positions.find(*key);
+    if (matches == index->positions.end()) {
+        result = std::any{};
+        return true;
+    }
+    Utils::JList sequence = Utils::createSequence();
+    for (size_t position : matches->second) {
+        sequence.push_back(index->items[position]);
+    }
+    result = std::move(sequence);
+    return true;
+}
+
+/* static */ bool Jsonata::isStreamableStep(
+    const std::shared_ptr<Parser::Symbol>& step) {
+    // Sort steps need the whole sequence; tuple steps carry bindings
+    return step && !step->tuple.has_value() && !step->focus.has_value() &&
+           step->nodeType() != Parser::NodeType::Sort;
+}
+
+std::any Jsonata::evaluateSteps(const std::shared_ptr<Parser::Symbol>& path,
+                                size_t begin, size_t end,
+                                const std::any* items, size_t count,
+                                const std::shared_ptr<Frame>& environment) {
+    // Each step only depends on one item of its input (predicates filter the
+    // result of a single item), so the items can go through the steps one at
+    // a time. Only the last step's results are collected and flattened, which
+    // is what evaluateStep() would have produced for the same steps
+    Utils::JList results = Utils::createSequence();
+    const bool lastStep = end == path->steps.size();
+    for (size_t i = 0; i < count; i++) {
+        streamStep(path, begin, end, items[i], environment, results);
+        // A $exists argument is settled by its first item
+        if (lastStep && path->firstMatch && hasItems(results)) {
+            break;
+        }
+    }
+    return flattenStepResults(std::move(results), lastStep);
+}
+
+std::any Jsonata::evaluateSteps(const std::shared_ptr<Parser::Symbol>& path,
+                                size_t begin, size_t end,
+                                const Utils::JList& range,
+                                const std::shared_ptr<Frame>& environment) {
+    Utils::JList results = Utils::createSequence();
+    const bool lastStep = end == path->steps.size();
+    for (size_t i = 0; i < range.size(); i++) {
+        streamStep(path, begin, end, range[i], environment, results);
+        if (lastStep && path->firstMatch && hasItems(results)) {
+            break;
+        }
+    }
+    return flattenStepResults(std::move(results), lastStep);
+}
+
+void Jsonata::streamStep(const std::shared_ptr<Parser::Symbol>& path,
+                         size_t index, size_t end, const std::any& item,
+                         const std::shared_ptr<Frame>& environment,
+                         Utils::JList& results) {
+    auto res = evaluateStepItem(path->steps[index], item, environment);
+    if (!res.has_value()) {
+        return;
+    }
+    if (index + 1 == end) {
+        results.push_back(std::move(res));
+        return;
+    }
+
+    // Hand on the items flattenStepResults() would have put in the sequence
+    if (!Utils::isArray(res)) {
+        streamStep(path, index + 1, end, res, environment, results);
+    } else if (res.type() == typeid(Utils::JList)) {
+        const auto& jlist = std::any_cast<const Utils::JList&>(res);
+        if (jlist.cons) {
+            streamStep(path, index + 1, end, res, environment, results);
+        } else {
+            for (const auto& next : jlist) {
+                streamStep(path, index + 1, end, next, environment, results);
+            }
+        }
+    } else {
+        Utils::forEachItem(res, [&](const std::any& next) {
+            streamStep(path, index + 1, end, next, environment, results);
+        });
+    }
+}
+
+namespace {
+
+// Runs the name steps of a field path the way Jsonata::streamStep runs them
+// through Functions::lookup, but on references into the input. Values are
+// only copied when they are collected into the result, or when a lookup has
+// to build a value (ranges, sequences that finishResult would unwrap)
+class FieldWalker {
+  public:
+    explicit FieldWalker(const std::vector<std::string>& fields)
+        : fields_(fields) {}
+
+    // One item of step index's input
+    void walk(const std::any& item, size_t index) {
+        using ObjectMap = nlohmann::ordered_map<std::string, std::any>;
+        const std::string& field = fields_[index];
+        if (item.type() == typeid(ObjectMap)) {
+            const auto& object = std::any_cast<const ObjectMap&>(item);
+            auto it = object.find(field);
+            if (it != object.end()) {
+                handOn(it->second.has_value() ? it->second : Utils::NULL_VALUE,
+                       index, true);
+            }
+        } else if (Utils::isArray(item)) {
+            // Functions::lookup collects the matches of every element,
+            // spreading array values into the sequence
+            std::vector<const std::any*> matches;
+            collect(elements(item), field, matches);
+            if (matches.size() == 1) {
+                handOn(*matches[0], index, false);
+            } else if (matches.size() > 1) {
+                if (index + 1 == fields_.size()) {
+                    Utils::JList sequence = Utils::createSequence();
+                    sequence.reserve(matches.size());
+                    for (const auto* match : matches) {
+                        sequence.push_back(*match);
+                    }
+                    owned_.emplace_back(std::move(sequence));
+                    leaves_.push_back(&owned_.back());
+                } else {
+                    for (const auto* match : matches) {
+                        walk(*match, index + 1);
                     }
                 }
             }
         }
+    }
 
-        if (res.has_value()) {
-            result.push_back(res);
+    // Jsonata::flattenStepResults over the collected values
+    std::any result() const {
+        Utils::JList resultSequence = Utils::createSequence();
+        if (leaves_.size() == 1 && Utils::isArray(*leaves_[0]) &&
+            !Utils::isSequence(*leaves_[0])) {
+            resultSequence = Utils::arrayify(*leaves_[0]);
+        } else {
+            for (const auto* leaf : leaves_) {
+                if (!Utils::isArray(*leaf)) {
+                    resultSequence.push_back(*leaf);
+                } else if (leaf->type() == typeid(Utils::JList)) {
+                    const auto& list = std::any_cast<const Utils::JList&>(*leaf);
+                    if (list.cons) {
+                        resultSequence.push_back(*leaf);
+                    } else {
+                        resultSequence.insert(resultSequence.end(),
+                                              list.begin(), list.end());
+                    }
+                } else {
+                    auto list = Utils::arrayify(*leaf);
+                    resultSequence.insert(resultSequence.end(), list.begin(),
+                                          list.end());
+                }
+            }
         }
+        return resultSequence.empty() ? std::any{} : std::any(resultSequence);
     }
 
-    // Java reference lines 364-378: flatten the results
+    // The elements of an array value as a JList that can be iterated by
+    // reference (ranges and std::vector values are materialized)
+    const Utils::JList& elements(const std::any& array) {
+        if (array.type() == typeid(Utils::JList)) {
+            const auto& list = std::any_cast<const Utils::JList&>(array);
+            if (!list.isRange()) {
+                return list;
+            }
+        }
+        owned_.emplace_back(Utils::arrayify(array));
+        return std::any_cast<const Utils::JList&>(owned_.back());
+    }
+
+  private:
+    const std::vector<std::string>& fields_;
+    std::vector<const std::any*> leaves_;
+    // Values built during the walk; a deque keeps references to them valid
+    std::deque<std::any> owned_;
+
+    void collect(const Utils::JList& array, const std::string& field,
+                 std::vector<const std::any*>& matches) {
+        using ObjectMap = nlohmann::ordered_map<std::string, std::any>;
+        for (const auto& element : array) {
+            if (element.type() == typeid(ObjectMap)) {
+                const auto& object = std::any_cast<const ObjectMap&>(element);
+                auto it = object.find(field);
+                if (it == object.end()) {
+                    continue;
+                }
+                if (!it->second.has_value()) {
+                    matches.push_back(&Utils::NULL_VALUE);
+                } else if (Utils::isArray(it->second)) {
+                    for (const auto& value : elements(it->second)) {
+                        matches.push_back(&value);
+                    }
+                } else {
+                    matches.push_back(&it->second);
+                }
+            } else if (Utils::isArray(element)) {
+                collect(elements(element), field, matches);
+            }
+        }
+    }
+
+    // A step's result for one item: kept when it is the last step, otherwise
+    // passed on item by item as Jsonata::streamStep does. A field value
+    // still goes through the finishResult every evaluated node gets; the
+    // matches over an array are a sequence that already has
+    void handOn(const std::any& value, size_t index, bool finish) {
+        const std::any* result = &value;
+        if (finish && Utils::isSequence(value)) {
+            // Singleton and empty sequences are unwrapped
+            owned_.push_back(Jsonata::finishResult(value, false));
+            if (!owned_.back().has_value()) {
+                return;
+            }
+            result = &owned_.back();
+        }
+        if (index + 1 == fields_.size()) {
+            leaves_.push_back(result);
+        } else if (!Utils::isArray(*result) ||
+                   (result->type() == typeid(Utils::JList) &&
+                    std::any_cast<const Utils::JList&>(*result).cons)) {
+            walk(*result, index + 1);
+        } else {
+            for (const auto& next : elements(*result)) {
+                walk(next, index + 1);
+            }
+        }
+    }
+};
+
+}  // namespace
+
+/* static */ std::any Jsonata::evaluateFieldPath(const Parser::Symbol& path,
+                                                 const std::any& input) {
+    if (!input.has_value()) {
+        return std::any{};
+    }
+    FieldWalker walker(path.fields);
+    if (Utils::isArray(input)) {
+        // Each element of an input array is an item of the first step
+        for (const auto& item : walker.elements(input)) {
+            walker.walk(item, 0);
+        }
+    } else {
+        walker.walk(input, 0);
+    }
+    return walker.result();
+}
+
+/* static */ bool Jsonata::hasItems(const Utils::JList& results) {
+    for (const auto& res : results) {
+        if (!isEmptyArray(res)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* static */ std::any Jsonata::flattenStepResults(Utils::JList&& result,
+                                                  bool lastStep) {
     Utils::JList resultSequence = Utils::createSequence();
     // Java reference line 365: if(lastStep && ((List)result).size()==1 &&
     // (((List)result).get(0) instanceof List) &&
     // !Utils.isSequence(((List)result).get(0)))
-    if (lastStep && result.size() == 1 && Utils::isArray(result[0]) &&
-        !Utils::isSequence(result[0])) {
+    auto& items = static_cast<Utils::ItemVector&>(result);
+    if (lastStep && items.size() == 1 && Utils::isArray(items[0]) &&
+        !Utils::isSequence(items[0])) {
         // Special case for last step with single array result
-        auto vec = Utils::arrayify(result[0]);
-        resultSequence = vec;
+        resultSequence = Utils::arrayify(std::move(items[0]));
     } else {
-        // Flatten the sequence
-        for (const auto& res : result) {
+        // Flatten the sequence; the results are owned, so items are moved
+        resultSequence.reserve(items.size());
+        for (auto& res : items) {
             // Java reference line 370: if (!(res instanceof List) || (res
             // instanceof JList && ((JList)res).cons))
             if (!Utils::isArray(res)) {
                 // it's not an array - just push into the result sequence
-                resultSequence.push_back(res);
+                resultSequence.push_back(std::move(res));
             } else if (res.type() == typeid(Utils::JList)) {
-                auto jlist = std::any_cast<Utils::JList>(res);
+                auto& jlist = *std::any_cast<Utils::JList>(&res);
                 if (jlist.cons) {
                     // res is a JList with cons - push the whole JList
-                    resultSequence.push_back(jlist);
+                    resultSequence.push_back(std::move(res));
+                } else if (jlist.isRange()) {
+                    Utils::forEachItem(res, [&](const std::any& item) {
+                        resultSequence.push_back(item);
+                    });
                 } else {
                     // res is a JList without cons - flatten it into the parent
                     // sequence
-                    resultSequence.insert(resultSequence.end(), jlist.begin(),
-                                          jlist.end());
+                    for (auto& item : static_cast<Utils::ItemVector&>(jlist)) {
+                        resultSequence.push_back(std::move(item));
+                    }
                 }
             } else {
                 // res is a sequence - flatten it into the parent sequence
-                auto nestedVec = Utils::arrayify(res);
-                resultSequence.insert(resultSequence.end(), nestedVec.begin(),
-                                      nestedVec.end());
+                Utils::forEachItem(res, [&](const std::any& item) {
+                    resultSequence.push_back(item);
+                });
             }
         }
     }
 
-    return resultSequence.empty() ? std::any{} : std::any(resultSequence);
+    if (resultSequence.empty()) {
+        return std::any{};
+    }
+    return resultSequence;
 }
 
 std::any Jsonata::evaluateTupleStep(
@@ -3354,14 +4523,14 @@ std::any Jsonata::evaluateTupleStep(
 
     Utils::JList result;
     // Java reference lines 411-429: handle sort expressions
-    if (expr->type == "sort") {
+    if (expr->nodeType() == Parser::NodeType::Sort) {
         if (tupleBindings.has_value()) {
             // Java line 414: sort existing tuple bindings
             std::any tupleBindingsAny = *tupleBindings;
             auto sortResult = evaluateSort(expr, tupleBindingsAny, environment);
             if (sortResult.has_value() &&
                 sortResult.type() == typeid(Utils::JList)) {
-                result = std::any_cast<Utils::JList>(sortResult);
+                result = std::any_cast<Utils::JList>(std::move(sortResult));
             }
         } else {
             // Java lines 416-424: sort input and create tuples with index
@@ -3371,20 +4540,18 @@ std::any Jsonata::evaluateTupleStep(
             result.sequence = true;
             result.tupleStream = true;
             if (sorted.has_value() && Utils::isArray(sorted)) {
-                auto sortedVec = Utils::arrayify(sorted);
+                auto sortedVec = Utils::arrayify(std::move(sorted));
+                result.reserve(sortedVec.size());
                 for (size_t i = 0; i < sortedVec.size(); ++i) {
-                    nlohmann::ordered_map<std::string, std::any> tuple;
-                    tuple["@"] = sortedVec[i];
-                    if (expr->index.has_value()) {
-                        try {
-                            std::string indexVar =
-                                std::any_cast<std::string>(expr->index);
-                            tuple[indexVar] = static_cast<int64_t>(i);
-                        } catch (...) {
-                            // Invalid index variable
-                        }
+                    Tuple tuple;
+                    tuple.context =
+                        std::make_shared<std::any>(std::move(sortedVec[i]));
+                    if (expr->indexSlot != Frame::kNoSlot) {
+                        tuple.bind(expr->indexSlot,
+                                   std::make_shared<std::any>(
+                                       static_cast<int64_t>(i)));
                     }
-                    result.push_back(std::any(tuple));
+                    result.push_back(std::move(tuple));
                 }
             }
         }
@@ -3392,10 +4559,12 @@ std::any Jsonata::evaluateTupleStep(
         // Java lines 425-428: handle stages
         if (!expr->stages.empty()) {
             auto stagesResult =
-                evaluateStages(expr->stages, result, environment);
+                evaluateStages(expr->stages, std::move(result), environment);
             if (stagesResult.has_value() &&
                 stagesResult.type() == typeid(Utils::JList)) {
-                result = std::any_cast<Utils::JList>(stagesResult);
+                result = std::any_cast<Utils::JList>(std::move(stagesResult));
+            } else {
+                result = Utils::JList{};
             }
         }
 
@@ -3406,102 +4575,93 @@ std::any Jsonata::evaluateTupleStep(
     result.sequence = true;
     result.tupleStream = true;
 
-    // Use existing tuple bindings or create from input
-    auto bindings = tupleBindings.value_or(Utils::JList{});
-    if (!tupleBindings.has_value() && !input.empty()) {
-        // Java line 435: create initial tuple bindings (only when tupleBindings
-        // is null, not just empty)
+    // Use existing tuple bindings or create them from the input (only when
+    // tupleBindings is null, not just empty - Java line 435)
+    Utils::JList initial;
+    if (!tupleBindings.has_value()) {
+        initial.reserve(input.size());
         for (const auto& item : input) {
-            nlohmann::ordered_map<std::string, std::any> tuple;
-            tuple["@"] = item;
-            bindings.push_back(std::any(tuple));
+            Tuple tuple;
+            tuple.context = std::make_shared<std::any>(item);
+            initial.push_back(std::move(tuple));
         }
     }
+    const Utils::JList& bindings = tupleBindings ? *tupleBindings : initial;
 
-    // Java reference lines 438-472: process each tuple binding
+    // Java reference lines 438-472: process each tuple binding. The tuple's
+    // variables are read in place by a frame reused across the tuples
+    TupleFrame tupleFrame(*this, environment);
     for (const auto& bindingAny : bindings) {
-        auto binding =
-            std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                bindingAny);
-        // Create frame from tuple - Java line 439
-        auto stepEnv = createFrameFromTuple(environment, bindingAny);
+        const auto& binding = std::any_cast<const Tuple&>(bindingAny);
 
-        // Evaluate expression with tuple's @ value - Java line 440
-        auto atIt = binding.find("@");
-        if (atIt == binding.end()) continue;
+        // Evaluate expression with tuple's @ value - Java lines 439-440
+        auto res = evaluate(expr, *binding.context, tupleFrame.enter(binding));
+        tupleFrame.leave();
+        if (!res.has_value()) {
+            continue;
+        }
 
-        auto res = evaluate(expr, atIt->second, stepEnv);
+        // Convert res to a list if not already
+        Utils::JList resVec;
+        if (!Utils::isArray(res)) {
+            resVec.push_back(std::move(res));
+        } else if (res.type() == typeid(Utils::JList)) {
+            resVec = std::any_cast<Utils::JList>(std::move(res));
+        } else {
+            resVec = Utils::arrayify(res);
+        }
 
-        if (res.has_value()) {
-            // Convert res to vector if not already
-            Utils::JList resVec;
-            if (!Utils::isArray(res)) {
-                resVec.push_back(res);
-            } else if (res.type() == typeid(Utils::JList)) {
-                resVec = std::any_cast<Utils::JList>(res);
+        // Java lines 449-469: create output tuples, each sharing the
+        // binding's values
+        for (size_t i = 0; i < resVec.size(); ++i) {
+            Tuple tuple(binding);
+
+            auto* resTuple =
+                resVec.tupleStream ? std::any_cast<Tuple>(&resVec[i]) : nullptr;
+            if (resTuple != nullptr) {
+                // The inner tuple's bindings overwrite existing ones (match
+                // Java Map.putAll semantics)
+                tuple.context = std::move(resTuple->context);
+                for (auto& [slot, value] : resTuple->bindings) {
+                    tuple.bind(slot, std::move(value));
+                }
             } else {
-                resVec = Utils::arrayify(res);
-            }
-
-            // Java lines 449-469: create output tuples
-            for (size_t i = 0; i < resVec.size(); ++i) {
-                nlohmann::ordered_map<std::string, std::any> tuple(
-                    binding);  // Copy existing bindings
-
-                if (resVec.tupleStream) {
-                    // cast resVec[i] to a map and overwrite existing keys
-                    // (match Java Map.putAll semantics)
-                    auto resTuple = std::any_cast<
-                        nlohmann::ordered_map<std::string, std::any>>(
-                        resVec[i]);
-                    for (const auto& kv : resTuple) {
-                        tuple[kv.first] = kv.second;
-                    }
+                if (expr->focusSlot != Frame::kNoSlot) {
+                    // Java lines 456-458: bind focus variable, keeping @
+                    tuple.bind(expr->focusSlot, std::make_shared<std::any>(
+                                                    std::move(resVec[i])));
                 } else {
-                    if (expr->focus.has_value()) {
-                        // Java lines 456-458: bind focus variable
-                        try {
-                            std::string focusVar =
-                                std::any_cast<std::string>(expr->focus);
-                            tuple[focusVar] = resVec[i];
-                            tuple["@"] = binding.at("@");  // Keep original @
-                        } catch (...) {
-                            // Invalid focus variable
-                        }
-                    } else {
-                        // Java line 460: update @ value
-                        tuple["@"] = resVec[i];
-                    }
-
-                    if (expr->index.has_value()) {
-                        // Java line 463: bind index variable
-                        try {
-                            std::string indexVar =
-                                std::any_cast<std::string>(expr->index);
-                            tuple[indexVar] = static_cast<int64_t>(i);
-                        } catch (...) {
-                            // Invalid index variable
-                        }
-                    }
+                    // Java line 460: update @ value
+                    tuple.context =
+                        std::make_shared<std::any>(std::move(resVec[i]));
+                }
 
-                    // Java line 465-467: bind ancestor context - CRITICAL FOR
-                    // PARENT OPERATOR
-                    if (expr->ancestor) {
-                        tuple[expr->ancestor->label] = binding.at("@");
-                    }
+                if (expr->indexSlot != Frame::kNoSlot) {
+                    // Java line 463: bind index variable
+                    tuple.bind(expr->indexSlot, std::make_shared<std::any>(
+                                                    static_cast<int64_t>(i)));
                 }
 
-                result.push_back(tuple);
+                // Java line 465-467: bind ancestor context - CRITICAL FOR
+                // PARENT OPERATOR
+                if (expr->ancestorSlot != Frame::kNoSlot) {
+                    tuple.bind(expr->ancestorSlot, binding.context);
+                }
             }
+
+            result.push_back(std::move(tuple));
         }
     }
 
     // Java lines 474-476: handle stages
     if (!expr->stages.empty()) {
-        auto stagesResult = evaluateStages(expr->stages, result, environment);
+        auto stagesResult =
+            evaluateStages(expr->stages, std::move(result), environment);
         if (stagesResult.has_value() &&
             stagesResult.type() == typeid(Utils::JList)) {
-            result = std::any_cast<Utils::JList>(stagesResult);
+            result = std::any_cast<Utils::JList>(std::move(stagesResult));
+        } else {
+            result = Utils::JList{};
         }
     }
 
@@ -3516,20 +4676,25 @@ std::any Jsonata::evaluateGroupExpression(std::shared_ptr<Parser::Symbol> expr,
     // Port exact Java implementation: Jsonata.java lines 1051-1134
     nlohmann::ordered_map<std::string, std::any> result;
 
-    // C++ equivalent of Java's LinkedHashMap<Object,GroupEntry>
+    // C++ equivalent of Java's LinkedHashMap<Object,GroupEntry>: the groups
+    // in the order their keys first appear, found through a hash index
     struct GroupEntry {
+        std::string key;
         std::any data;
         int64_t exprIndex;
+        // data is a list made by Functions::append, which later items are
+        // appended to in place instead of copying it again
+        bool owned = false;
     };
-    nlohmann::ordered_map<std::string, GroupEntry> groups;
+    std::vector<GroupEntry> groups;
+    std::unordered_map<std::string, size_t> groupIndex;
 
     // Java line 1054: var reduce = (_input instanceof JList) &&
     // ((JList)_input).tupleStream ? true : false; For now, simplify this - the
     // main case is non-tuple streams
     bool reduce = false;
     if (input.type() == typeid(Utils::JList)) {
-        auto jlist = std::any_cast<Utils::JList>(input);
-        reduce = jlist.tupleStream;
+        reduce = std::any_cast<const Utils::JList&>(input).tupleStream;
     }
 
     // Java lines 1056-1059: group the input sequence by "key" expression
@@ -3549,35 +4714,39 @@ std::any Jsonata::evaluateGroupExpression(std::shared_ptr<Parser::Symbol> expr,
         inputVec.push_back(std::any{});
     }
 
-    // Java lines 1066-1103: Process each item and each key-value pair
+    // An observer must see every value expression evaluated
+    if (expr->aggregates && !reduce && environment->getObserver() == nullptr) {
+        std::any aggregated;
+        if (evaluateGroupAggregates(expr, inputVec, environment, aggregated)) {
+            return aggregated;
+        }
+    }
+
+    // Java lines 1066-1103: Process each item and each key-value pair. The
+    // tuple a group reduces to is declared first, as frames may borrow it
+    Tuple reduced;
+    TupleFrame tupleFrame(*this, environment);
     for (size_t itemIndex = 0; itemIndex < inputVec.size(); itemIndex++) {
-        auto item = inputVec[itemIndex];
+        const std::any& item =
+            static_cast<const Utils::ItemVector&>(inputVec)[itemIndex];
         // Java line 1068: var env = reduce ? createFrameFromTuple(environment,
         // (Map)item) : environment;
-        auto env =
-            reduce
-                ? createFrameFromTuple(
-                      environment,
-                      std::any_cast<
-                          nlohmann::ordered_map<std::string, std::any>>(item))
-                : environment;
+        static const std::any undefined;
+        const std::any* keyContext = &item;
+        const std::shared_ptr<Frame>* env = &environment;
+        const auto* tuple = reduce ? std::any_cast<Tuple>(&item) : nullptr;
+        if (tuple != nullptr) {
+            keyContext = tuple->context ? tuple->context.get() : &undefined;
+            env = &tupleFrame.enter(*tuple);
+        }
 
         for (size_t pairIndex = 0; pairIndex < expr->lhsObject.size();
              pairIndex++) {
-            auto pair = expr->lhsObject[pairIndex];
+            const auto& pair = expr->lhsObject[pairIndex];
 
             // Java line 1071: var key = evaluate(pair[0], reduce ?
             // ((Map)item).get("@") : item, env);
-            std::any keyContext = item;
-            if (reduce) {
-                auto itemMap =
-                    std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                        item);
-                auto atIt = itemMap.find("@");
-                keyContext =
-                    (atIt != itemMap.end()) ? atIt->second : std::any{};
-            }
-            auto key = evaluate(pair.first, keyContext, env);
+            auto key = evaluate(pair.first, *keyContext, *env);
 
             // Java lines 1072-1079: key has to be a string - T1003 validation
             // Java: if (key!=null && !(key instanceof String)) throw
@@ -3595,17 +4764,18 @@ std::any Jsonata::evaluateGroupExpression(std::shared_ptr<Parser::Symbol> expr,
             }
 
             // Key is validated to be a string at this point
-            std::string keyStr = std::any_cast<std::string>(key);
+            auto& keyStr = std::any_cast<std::string&>(key);
 
             // Java lines 1081-1101: Process non-null keys
-            GroupEntry entry;
-            entry.data = item;
-            entry.exprIndex = static_cast<int64_t>(pairIndex);
-
-            auto groupsIt = groups.find(keyStr);
-            if (groupsIt != groups.end()) {
+            auto [indexIt, inserted] =
+                groupIndex.try_emplace(keyStr, groups.size());
+            if (inserted) {
+                groups.push_back(GroupEntry{std::move(keyStr), item,
+                                            static_cast<int64_t>(pairIndex)});
+            } else {
+                auto& group = groups[indexIt->second];
                 // Java lines 1084-1094: a value already exists in this slot
-                if (groupsIt->second.exprIndex != static_cast<int64_t>(pairIndex)) {
+                if (group.exprIndex != static_cast<int64_t>(pairIndex)) {
                     // Java lines 1086-1093: this key has been generated by
                     // another expression in this group when multiple key
                     // expressions evaluate to the same key, then error D1009
@@ -3616,47 +4786,65 @@ std::any Jsonata::evaluateGroupExpression(std::shared_ptr<Parser::Symbol> expr,
                 }
 
                 // Java line 1097: append it as an array
-                Utils::JList appendArgs = {groupsIt->second.data, item};
-                groupsIt->second.data = Functions::append(appendArgs);
-            } else {
-                groups[keyStr] = entry;
+                if (!item.has_value()) {
+                    continue;
+                }
+                if (group.owned) {
+                    auto& list = std::any_cast<Utils::JList&>(group.data);
+                    // An empty list may still give way to a range
+                    if (!list.empty()) {
+                        if (Utils::isArray(item)) {
+                            auto items = Utils::arrayify(item);
+                            list.insert(list.end(), items.begin(), items.end());
+                        } else {
+                            list.push_back(item);
+                        }
+                        continue;
+                    }
+                }
+                const bool copies = group.data.has_value();
+                Utils::JList appendArgs = {std::move(group.data), item};
+                group.data = Functions::append(appendArgs);
+                group.owned = copies &&
+                              group.data.type() == typeid(Utils::JList) &&
+                              !std::any_cast<const Utils::JList&>(group.data)
+                                   .isRange();
             }
         }
+        tupleFrame.leave();
     }
 
     // Java lines 1105-1125: iterate over the groups to evaluate the "value"
     // expression
     int64_t idx = 0;
-    for (const auto& kvp : groups) {
-        const auto& keyStr = kvp.first;
-        const auto& entry = kvp.second;
-        auto context = entry.data;
-        auto env = environment;
+    result.reserve(groups.size());
+    for (auto& entry : groups) {
+        static const std::any undefined;
+        const std::any* context = &entry.data;
+        const std::shared_ptr<Frame>* env = &environment;
 
         // Java lines 1112-1117: if (reduce) handle tuple reduction and create
-        // frame
+        // frame; the context (@) is not one of the tuple's variables
         if (reduce) {
-            auto tuple = reduceTupleStream(entry.data);
-            auto tupleMap =
-                std::any_cast<nlohmann::ordered_map<std::string, std::any>>(
-                    tuple);
-            auto atIt = tupleMap.find("@");
-            context = (atIt != tupleMap.end()) ? atIt->second : std::any{};
-            tupleMap.erase("@");  // Java line 1115: ((Map)tuple).remove("@");
-            env = createFrameFromTuple(environment, tupleMap);
+            reduced = reduceTupleStream(entry.data);
+            context = reduced.context ? reduced.context.get() : &undefined;
+            env = &tupleFrame.enter(reduced);
         }
 
         // Java line 1118: env.isParallelCall = idx > 0;
-        env->isParallelCall = (idx > 0);
+        (*env)->isParallelCall = (idx > 0);
 
         // Java line 1120: Object res =
         // evaluate(expr.lhsObject.get(entry.exprIndex)[1], context, env);
         auto res =
-            evaluate(expr->lhsObject[entry.exprIndex].second, context, env);
+            evaluate(expr->lhsObject[entry.exprIndex].second, *context, *env);
+        tupleFrame.leave();
 
         // Java lines 1121-1122: if (res!=null) result.put(e.getKey(), res);
+        // Group keys are distinct, so the entry is added without a lookup
         if (res.has_value()) {
-            result[keyStr] = res;
+            result.Container::emplace_back(std::move(entry.key),
+                                           std::move(res));
         }
 
         idx++;
@@ -3665,6 +4853,140 @@ std::any Jsonata::evaluateGroupExpression(std::shared_ptr<Parser::Symbol> expr,
     return result;
 }
 
+bool Jsonata::evaluateGroupAggregates(
+    const std::shared_ptr<Parser::Symbol>& expr, const Utils::JList& items,
+    const std::shared_ptr<Frame>& environment, std::any& result) {
+    enum class Fold { Sum, Count, Max, Min, Average };
+    std::vector<Fold> folds;
+    for (const auto& pair : expr->lhsObject) {
+        const auto& procedure = pair.second->procedure;
+        if (!callsBuiltin(procedure, environment)) {
+            return false;
+        }
+        const auto& name = std::any_cast<const std::string&>(procedure->value);
+        folds.push_back(name == "sum"     ? Fold::Sum
+                        : name == "count" ? Fold::Count
+                        : name == "max"   ? Fold::Max
+                        : name == "min"   ? Fold::Min
+                                          : Fold::Average);
+    }
+
+    // What the aggregate would compute over the group's collected items:
+    // the numbers (elements for $count) of each item's value, in order
+    struct Group {
+        std::string key;
+        int64_t exprIndex;
+        double sum = 0;
+        double best = 0;
+        int64_t count = 0;
+    };
+    std::vector<Group> groups;
+    std::unordered_map<std::string, size_t> groupIndex;
+    auto addNumber = [](Fold fold, Group& group, const std::any& value) {
+        if (value.type() != typeid(double) && value.type() != typeid(int64_t) &&
+            value.type() != typeid(uint64_t)) {
+            return false;
+        }
+        const double number = Utils::toDouble(value);
+        if (group.count == 0 || (fold == Fold::Max && number > group.best) ||
+            (fold == Fold::Min && number < group.best)) {
+            group.best = number;
+        }
+        group.sum += number;
+        group.count++;
+        return true;
+    };
+    // False for values whose flattening or type checks only the collected
+    // items get right: nested arrays, and non-numbers for numeric folds
+    auto add = [&addNumber](Fold fold, Group& group, const std::any& value) {
+        if (!value.has_value()) {
+            return true;
+        }
+        if (!Utils::isArray(value)) {
+            if (fold == Fold::Count) {
+                group.count++;
+                return true;
+            }
+            return addNumber(fold, group, value);
+        }
+        for (const auto& element : Utils::arrayify(value)) {
+            if (fold == Fold::Count ? Utils::isArray(element)
+                                    : !addNumber(fold, group, element)) {
+                return false;
+            }
+            if (fold == Fold::Count) {
+                group.count++;
+            }
+        }
+        return true;
+    };
+
+    for (const auto& item : items) {
+        // Functions::append would spread an array item into the group
+        if (Utils::isArray(item)) {
+            return false;
+        }
+        for (size_t pairIndex = 0; pairIndex < expr->lhsObject.size();
+             pairIndex++) {
+            const auto& pair = expr->lhsObject[pairIndex];
+            auto key = evaluate(pair.first, item, environment);
+            if (key.has_value() && key.type() != typeid(std::string)) {
+                throw JException(
+                    "T1003", expr->position,
+                    "Key in object structure must evaluate to a string");
+            }
+            if (!key.has_value()) {
+                continue;
+            }
+            auto& keyStr = std::any_cast<std::string&>(key);
+            auto [indexIt, inserted] =
+                groupIndex.try_emplace(keyStr, groups.size());
+            if (inserted) {
+                groups.push_back(Group{std::move(keyStr),
+                                       static_cast<int64_t>(pairIndex)});
+            } else if (groups[indexIt->second].exprIndex !=
+                       static_cast<int64_t>(pairIndex)) {
+                throw JException(
+                    "D1009", expr->position,
+                    "Multiple key definitions evaluate to same key");
+            }
+            auto& group = groups[indexIt->second];
+            if (!add(folds[pairIndex], group,
+                     evaluate(pair.second->arguments[0], item, environment))) {
+                return false;
+            }
+        }
+    }
+
+    nlohmann::ordered_map<std::string, std::any> object;
+    object.reserve(groups.size());
+    for (auto& group : groups) {
+        std::any value;
+        switch (folds[group.exprIndex]) {
+            case Fold::Count:
+                value = group.count;
+                break;
+            case Fold::Sum:
+                value = group.sum;
+                break;
+            case Fold::Average:
+                value = group.sum / static_cast<double>(group.count);
+                break;
+            case Fold::Max:
+            case Fold::Min:
+                value = group.best;
+                break;
+        }
+        // Numeric folds over no numbers are undefined
+        if (folds[group.exprIndex] == Fold::Count || group.count > 0) {
+            object.Container::emplace_back(std::move(group.key),
+                                           std::move(value));
+        }
+    }
+    result = std::move(object);
+    return true;
+}
+
 std::any Jsonata::evaluateTransformExpression(
     std::shared_ptr<Parser::Symbol> expr, const std::any& input,
     std::shared_ptr<Frame> environment) {
@@ -3704,7 +5026,7 @@ std::any Jsonata::evaluateApplyExpression(std::shared_ptr<Parser::Symbol> expr,
 
     auto lhs = evaluate(expr->lhs, input, environment);
 
-    if (expr->rhs->type == "function") {
+    if (expr->rhs->nodeType() == Parser::NodeType::Function) {
         // This is a function invocation; invoke it with lhs expression as the
         // first argument
         return evaluateFunctionWithContext(expr->rhs, input, environment, lhs);
@@ -3754,7 +5076,7 @@ std::any Jsonata::evaluatePartialApplication(
     Utils::JList evaluatedArgs;
     for (size_t ii = 0; ii < expr->arguments.size(); ii++) {
         auto arg = expr->arguments[ii];
-        if (arg && arg->type == "operator" &&
+        if (arg && arg->nodeType() == Parser::NodeType::Operator &&
             std::any_cast<std::string>(arg->value) == "?") {
             // Keep placeholder arguments as-is (Java line 1828)
             evaluatedArgs.push_back(arg);
@@ -3769,7 +5091,8 @@ std::any Jsonata::evaluatePartialApplication(
 
     // Check if procedure exists and handle error cases (Java lines 1835-1841)
     if (!proc.has_value() && expr->procedure &&
-        expr->procedure->type == "path" && !expr->procedure->steps.empty() &&
+        expr->procedure->nodeType() == Parser::NodeType::Path &&
+        !expr->procedure->steps.empty() &&
         environment
             ->lookup(
                 std::any_cast<std::string>(expr->procedure->steps[0]->value))
@@ -3791,7 +5114,8 @@ std::any Jsonata::evaluatePartialApplication(
         // Java line 1845: partialApplyNativeFunction
         // Get function name from the procedure expression
         std::string functionName;
-        if (expr->procedure && expr->procedure->type == "path" &&
+        if (expr->procedure &&
+            expr->procedure->nodeType() == Parser::NodeType::Path &&
             !expr->procedure->steps.empty()) {
             functionName =
                 std::any_cast<std::string>(expr->procedure->steps[0]->value);
@@ -3802,7 +5126,8 @@ std::any Jsonata::evaluatePartialApplication(
     } else {
         // Java lines 1849-1854
         std::string procName = "unknown";
-        if (expr->procedure && expr->procedure->type == "path" &&
+        if (expr->procedure &&
+            expr->procedure->nodeType() == Parser::NodeType::Path &&
             !expr->procedure->steps.empty()) {
             procName =
                 std::any_cast<std::string>(expr->procedure->steps[0]->value);
@@ -3838,7 +5163,8 @@ std::any Jsonata::partialApplyProcedure(std::shared_ptr<Parser::Symbol> proc,
         } else if (arg.type() == typeid(std::shared_ptr<Parser::Symbol>)) {
             auto argSymbol =
                 std::any_cast<std::shared_ptr<Parser::Symbol>>(arg);
-            if (argSymbol && argSymbol->type == "operator" &&
+            if (argSymbol &&
+                argSymbol->nodeType() == Parser::NodeType::Operator &&
                 std::any_cast<std::string>(argSymbol->value) == "?") {
                 isPlaceholder = true;
             }
@@ -3847,7 +5173,11 @@ std::any Jsonata::partialApplyProcedure(std::shared_ptr<Parser::Symbol> proc,
         if (isPlaceholder) {
             unboundArgs.push_back(param);
         } else {
-            env->bind(std::any_cast<std::string>(param->value), arg);
+            Frame::Slot slot = param->variableSlot();
+            if (slot == Frame::kNoSlot) {
+                throw std::bad_any_cast();
+            }
+            env->bind(slot, arg);
         }
         index++;
     }
@@ -3859,6 +5189,8 @@ std::any Jsonata::partialApplyProcedure(std::shared_ptr<Parser::Symbol> proc,
     procedure->environment = env;
     procedure->arguments = unboundArgs;
     procedure->body = proc->body;
+    procedure->program = proc->program;
+    procedure->entry = proc->entry;
 
     // Copy signature from original procedure to maintain signature validation
     // This is critical for partial application to work correctly with
@@ -3877,7 +5209,7 @@ std::any Jsonata::partialApplyNativeFunction(const std::any& native,
     // Get the number of arguments for this function from its signature
     int64_t numberOfArgs = 2;  // Default for most functions
     if (native.type() == typeid(JFunction)) {
-        auto jfunc = std::any_cast<JFunction>(native);
+        const auto& jfunc = std::any_cast<const JFunction&>(native);
         if (jfunc.signature) {
             numberOfArgs = jfunc.signature->getNumberOfArgs();
         }
@@ -3896,7 +5228,8 @@ std::any Jsonata::partialApplyNativeFunction(const std::any& native,
             if (args[i].type() == typeid(std::shared_ptr<Parser::Symbol>)) {
                 auto argSymbol =
                     std::any_cast<std::shared_ptr<Parser::Symbol>>(args[i]);
-                if (argSymbol && argSymbol->type == "operator" &&
+                if (argSymbol &&
+                    argSymbol->nodeType() == Parser::NodeType::Operator &&
                     std::any_cast<std::string>(argSymbol->value) == "?") {
                     callArgs.push_back(argName);  // Use parameter name
                 } else {
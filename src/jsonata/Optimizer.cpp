@@ -0,0 +1,889 @@
+/**
+ * jsonata-cpp is the JSONata C++ reference port
+ *
+ * Copyright Dashjoin GmbH. https://dashjoin.com
+ * Copyright Robert Yokota
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "jsonata/Optimizer.h"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "jsonata/JException.h"
+#include "jsonata/Jsonata.h"
+#include "jsonata/Utils.h"
+#include "jsonata/utils/Signature.h"
+
+namespace jsonata {
+
+namespace {
+
+using Symbol = Parser::Symbol;
+using NodeType = Parser::NodeType;
+using OpCode = Parser::OpCode;
+
+// Builtins whose result depends only on their arguments
+const std::unordered_set<std::string>& pureBuiltins() {
+    static const std::unordered_set<std::string> names = {
+        "sum", "count", "max", "min", "average", "string", "substring",
+        "substringBefore", "substringAfter", "uppercase", "lowercase",
+        "length", "trim", "pad", "contains", "split", "join", "number",
+        "floor", "ceil", "round", "abs", "sqrt", "power", "boolean", "not",
+        "keys", "lookup", "append", "exists", "spread", "merge", "reverse",
+        "type", "distinct", "zip", "base64encode", "base64decode",
+        "encodeUrlComponent", "encodeUrl", "decodeUrlComponent", "decodeUrl",
+        "formatNumber", "formatBase", "formatInteger", "parseInteger"};
+    return names;
+}
+
+class Optimizer {
+  public:
+    explicit Optimizer(Jsonata& instance) : instance_(instance) {}
+
+    std::shared_ptr<Symbol> run(const std::shared_ptr<Symbol>& ast) {
+        if (!ast) {
+            return ast;
+        }
+        scan(ast);
+        auto result = visit(ast);
+        markInvariants(result, false);
+        return result;
+    }
+
+  private:
+    Jsonata& instance_;
+    // Names bound by the expression itself ($x := ..., lambda parameters,
+    // @$x and #$i)
+    std::unordered_set<std::string> boundNames_;
+    // Nodes taking part in the parent operator (%): the ones whose subtree
+    // contains it, and the steps it climbs back to. They are kept as they
+    // are, since the evaluator resolves % through them
+    std::unordered_set<const Symbol*> parentNodes_;
+
+    template <class F>
+    static void forEachChild(const std::shared_ptr<Symbol>& node, F&& f) {
+        f(node->lhs);
+        f(node->rhs);
+        f(node->expression);
+        f(node->condition);
+        f(node->then_expr);
+        f(node->else_expr);
+        f(node->body);
+        f(node->procedure);
+        f(node->group);
+        f(node->pattern);
+        f(node->update);
+        f(node->delete_);
+        for (auto* list : {&node->expressions, &node->arguments, &node->steps,
+                           &node->terms}) {
+            for (auto& child : *list) {
+                f(child);
+            }
+        }
+        for (auto* pairs : {&node->lhsObject, &node->rhsObject}) {
+            for (auto& [key, value] : *pairs) {
+                f(key);
+                f(value);
+            }
+        }
+        // Predicates and stages hold their expression in Symbol::expr
+        for (auto* filters : {&node->predicate, &node->stages}) {
+            for (auto& filter : *filters) {
+                if (filter &&
+                    filter->expr.type() == typeid(std::shared_ptr<Symbol>)) {
+                    f(*std::any_cast<std::shared_ptr<Symbol>>(&filter->expr));
+                }
+            }
+        }
+    }
+
+    // Collects boundNames_ and parentNodes_; true when node is one of the
+    // latter
+    bool scan(const std::shared_ptr<Symbol>& node) {
+        if (!node) {
+            return false;
+        }
+        bool parent = !node->seekingParentList.empty() || node->ancestor ||
+                      !node->label.empty();
+        switch (node->nodeType()) {
+            case NodeType::Parent:
+                parent = true;
+                break;
+            case NodeType::Bind:
+                if (node->lhs && node->lhs->value.type() == typeid(std::string)) {
+                    boundNames_.insert(
+                        std::any_cast<const std::string&>(node->lhs->value));
+                }
+                break;
+            case NodeType::Lambda:
+                for (const auto& param : node->arguments) {
+                    if (param && param->value.type() == typeid(std::string)) {
+                        boundNames_.insert(
+                            std::any_cast<const std::string&>(param->value));
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        for (const auto* name : {&node->focus, &node->index}) {
+            if (name->type() == typeid(std::string)) {
+                boundNames_.insert(std::any_cast<const std::string&>(*name));
+            }
+        }
+        forEachChild(node, [this, &parent](const std::shared_ptr<Symbol>& child) {
+            parent = scan(child) || parent;
+        });
+        if (parent) {
+            parentNodes_.insert(node.get());
+        }
+        return parent;
+    }
+
+    // True when nothing is applied around the node's own value
+    static bool isPlain(const std::shared_ptr<Symbol>& node) {
+        return node->predicate.empty() && node->stages.empty() &&
+               !node->group && !node->keepArray && !node->focus.has_value() &&
+               !node->index.has_value() && !node->tuple.has_value();
+    }
+
+    static bool isLiteral(const std::shared_ptr<Symbol>& node) {
+        if (!node || !isPlain(node)) {
+            return false;
+        }
+        auto type = node->nodeType();
+        return type == NodeType::String || type == NodeType::Number ||
+               type == NodeType::Value;
+    }
+
+    static bool isArrayConstructor(const std::shared_ptr<Symbol>& node) {
+        return node && node->nodeType() == NodeType::Unary &&
+               node->opCode() == OpCode::ArrayConstructor;
+    }
+
+    // A literal, or an array constructor of constants kept unfolded because
+    // it is an element of another array constructor
+    static bool isConstant(const std::shared_ptr<Symbol>& node) {
+        if (isLiteral(node)) {
+            return true;
+        }
+        if (!isArrayConstructor(node) || !isPlain(node)) {
+            return false;
+        }
+        for (const auto& item : node->expressions) {
+            if (!isConstant(item)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Binds in the same scope as the node; nested blocks and lambdas have
+    // their own frame
+    static bool bindsInScope(const std::shared_ptr<Symbol>& node) {
+        if (!node) {
+            return false;
+        }
+        auto type = node->nodeType();
+        if (type == NodeType::Bind) {
+            return true;
+        }
+        if (type == NodeType::Block || type == NodeType::Lambda) {
+            return false;
+        }
+        bool binds = false;
+        forEachChild(node, [&binds](const std::shared_ptr<Symbol>& child) {
+            binds = binds || bindsInScope(child);
+        });
+        return binds;
+    }
+
+    bool isFoldable(const std::shared_ptr<Symbol>& node) {
+        if (!isPlain(node)) {
+            return false;
+        }
+        switch (node->nodeType()) {
+            case NodeType::Binary:
+                return isConstant(node->lhs) && isConstant(node->rhs);
+            case NodeType::Unary:
+                if (node->opCode() == OpCode::ArrayConstructor) {
+                    for (const auto& item : node->expressions) {
+                        if (!isConstant(item)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                if (node->opCode() == OpCode::ObjectConstructor) {
+                    for (const auto& [key, value] : node->lhsObject) {
+                        if (!isConstant(key) || !isConstant(value)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                return node->opCode() == OpCode::Negate &&
+                       isConstant(node->expression);
+            case NodeType::Function: {
+                const auto& procedure = node->procedure;
+                if (!procedure ||
+                    procedure->nodeType() != NodeType::Variable ||
+                    procedure->value.type() != typeid(std::string)) {
+                    return false;
+                }
+                const auto& name =
+                    std::any_cast<const std::string&>(procedure->value);
+                if (!pureBuiltins().count(name) || boundNames_.count(name)) {
+                    return false;
+                }
+                for (const auto& arg : node->arguments) {
+                    if (!isConstant(arg)) {
+                        return false;
+                    }
+                }
+                return !usesContext(name, node->arguments);
+            }
+            default:
+                return false;
+        }
+    }
+
+    // True when the builtin would take an argument from the context instead
+    // (e.g. $string() or $substring(1, 2)), checked by validating the
+    // constant arguments against its signature with a marker context
+    bool usesContext(const std::string& name,
+                     const std::vector<std::shared_ptr<Symbol>>& arguments) {
+        auto function = instance_.getEnvironment()->lookup(name);
+        if (function.type() != typeid(JFunction)) {
+            return true;
+        }
+        const auto& signature =
+            std::any_cast<const JFunction&>(function).signature;
+        if (!signature) {
+            return false;
+        }
+        static const std::string marker = "\x01context\x01";
+        try {
+            Utils::JList args;
+            for (const auto& arg : arguments) {
+                args.push_back(instance_.evaluate(arg, std::any{},
+                                                  instance_.getEnvironment()));
+            }
+            for (const auto& arg : signature->validate(args, marker)) {
+                if (arg.type() == typeid(std::string) &&
+                    std::any_cast<const std::string&>(arg) == marker) {
+                    return true;
+                }
+            }
+        } catch (const std::exception&) {
+            return true;
+        }
+        return false;
+    }
+
+    // Variables of the builtins called within a constant subtree
+    static void collectBuiltins(const std::shared_ptr<Symbol>& node,
+                                std::vector<std::shared_ptr<Symbol>>& out) {
+        if (!node) {
+            return;
+        }
+        auto add = [&out](const std::shared_ptr<Symbol>& procedure) {
+            for (const auto& known : out) {
+                if (known->variableSlot() == procedure->variableSlot()) {
+                    return;
+                }
+            }
+            out.push_back(procedure);
+        };
+        if (isLiteral(node)) {
+            for (const auto& procedure : node->arguments) {
+                add(procedure);
+            }
+            return;
+        }
+        if (node->nodeType() == NodeType::Function) {
+            add(node->procedure);
+        }
+        forEachChild(node, [&out](const std::shared_ptr<Symbol>& child) {
+            collectBuiltins(child, out);
+        });
+    }
+
+    // Evaluates a foldable node into a literal; nullptr when it fails or
+    // yields no value
+    std::shared_ptr<Symbol> fold(const std::shared_ptr<Symbol>& node) {
+        std::any value;
+        try {
+            auto frame = instance_.createFrame(instance_.getEnvironment());
+            value = instance_.evaluate(node, std::any{}, frame);
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+        if (!value.has_value() || Utils::isFunction(value)) {
+            return nullptr;
+        }
+
+        auto literal = std::make_shared<Symbol>();
+        literal->position = node->position;
+        literal->consarray = node->consarray;
+
+        // A value computed by builtins keeps their variables and the subtree
+        // it replaces, so the evaluator can fall back to the subtree if a
+        // builtin is rebound. It is typed "value" so that nothing reads it
+        // without going through evaluation (e.g. as a numeric filter index)
+        std::vector<std::shared_ptr<Symbol>> builtins;
+        collectBuiltins(node, builtins);
+        if (!builtins.empty()) {
+            literal->type = "value";
+            literal->arguments = std::move(builtins);
+            literal->body = node;
+            literal->value = std::move(value);
+        } else if (value.type() == typeid(std::string)) {
+            literal->type = "string";
+            literal->value = std::move(value);
+        } else if (Utils::isNumber(value)) {
+            literal->type = "number";
+            literal->value = std::move(value);
+        } else {
+            // true/false/null, arrays and objects; a null literal has no value
+            literal->type = "value";
+            if (!Utils::isNullValue(value)) {
+                literal->value = std::move(value);
+            }
+        }
+        // Resolved here rather than lazily on first evaluation, when
+        // concurrent evaluations of the optimized tree would race to write
+        // the node's cached type
+        literal->resolveType();
+        return literal;
+    }
+
+    std::shared_ptr<Symbol> visit(const std::shared_ptr<Symbol>& node) {
+        if (!node) {
+            return node;
+        }
+        const auto type = node->nodeType();
+
+        // A tail-call thunk must keep its call node; only its arguments are
+        // simplified
+        if (type == NodeType::Lambda && node->thunk && node->body) {
+            for (auto& arg : node->body->arguments) {
+                arg = visit(arg);
+            }
+            return node;
+        }
+
+        // The call on the right of ~> receives the left side as its first
+        // argument, so it is never complete on its own
+        const bool applyCall = type == NodeType::Apply && node->rhs &&
+                               node->rhs->nodeType() == NodeType::Function;
+        if (applyCall) {
+            for (auto& arg : node->rhs->arguments) {
+                arg = visit(arg);
+            }
+        }
+        forEachChild(node, [this, &node, applyCall](std::shared_ptr<Symbol>& child) {
+            if (!(applyCall && &child == &node->rhs)) {
+                child = visit(child);
+            }
+        });
+
+        // An array element that is itself an array constructor is added as
+        // one item instead of being appended, so that property must survive
+        if (isArrayConstructor(node)) {
+            for (auto& item : node->expressions) {
+                auto it = item ? original_.find(item.get()) : original_.end();
+                if (it != original_.end() &&
+                    isArrayConstructor(item) != isArrayConstructor(it->second)) {
+                    item = it->second;
+                }
+            }
+        }
+
+        std::shared_ptr<Symbol> result = node;
+        if (parentNodes_.count(node.get())) {
+            return result;
+        }
+        if (isFoldable(node)) {
+            if (auto literal = fold(node)) {
+                result = literal;
+            }
+        } else if (type == NodeType::Condition && isPlain(node) &&
+                   isLiteral(node->condition) &&
+                   node->condition->arguments.empty()) {
+            result = simplifyCondition(node);
+        } else if (type == NodeType::Block && isPlain(node)) {
+            result = simplifyBlock(node);
+        } else if (type == NodeType::Function) {
+            addFirstMatchArgument(node);
+        }
+        if (result != node) {
+            original_[result.get()] = node;
+        }
+        return result;
+    }
+
+    // $exists(items[type = 'x']) only needs to know whether anything
+    // matches; the call keeps a copy of its argument whose last filter, and
+    // whose path, stop at the first match
+    void addFirstMatchArgument(const std::shared_ptr<Symbol>& node) {
+        const auto& procedure = node->procedure;
+        if (node->body || node->arguments.size() != 1 || !node->arguments[0] ||
+            !procedure || procedure->nodeType() != NodeType::Variable ||
+            procedure->value.type() != typeid(std::string) ||
+            std::any_cast<const std::string&>(procedure->value) != "exists" ||
+            boundNames_.count("exists")) {
+            return;
+        }
+        const auto& arg = node->arguments[0];
+        auto copy = std::make_shared<Symbol>(*arg);
+        if (!arg->predicate.empty()) {
+            copy->predicate.back() = firstMatchFilter(arg->predicate.back());
+        } else if (arg->nodeType() == NodeType::Path && !arg->steps.empty() &&
+                   !arg->group && !arg->keepSingletonArray) {
+            copy->firstMatch = stepsNeverThrow(arg);
+            const auto& last = arg->steps.back();
+            if (last && !last->stages.empty() &&
+                last->stages.back()->nodeType() == NodeType::Filter) {
+                auto step = std::make_shared<Symbol>(*last);
+                step->stages.back() = firstMatchFilter(last->stages.back());
+                copy->steps.back() = step;
+            }
+        } else {
+            return;
+        }
+        node->body = copy;
+    }
+
+    // A path stopped at its first match skips the later items, which is
+    // only unobservable when no step could have raised an error on them
+    static bool stepsNeverThrow(const std::shared_ptr<Symbol>& path) {
+        for (const auto& step : path->steps) {
+            if (!step || step->nodeType() != NodeType::Name ||
+                !step->predicate.empty() || step->group ||
+                step->tuple.has_value()) {
+                return false;
+            }
+            for (const auto& stage : step->stages) {
+                if (!stage || stage->nodeType() != NodeType::Filter ||
+                    stage->expr.type() != typeid(std::shared_ptr<Symbol>) ||
+                    !Jsonata::neverThrows(
+                        std::any_cast<const std::shared_ptr<Symbol>&>(
+                            stage->expr))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static std::shared_ptr<Symbol> firstMatchFilter(
+        const std::shared_ptr<Symbol>& filter) {
+        auto copy = std::make_shared<Symbol>(*filter);
+        copy->firstMatch = true;
+        return copy;
+    }
+
+    std::shared_ptr<Symbol> simplifyCondition(
+        const std::shared_ptr<Symbol>& node) {
+        std::any test;
+        try {
+            test = instance_.evaluate(node->condition, std::any{},
+                                      instance_.getEnvironment());
+        } catch (const std::exception&) {
+            return node;
+        }
+        if (Jsonata::boolize(test)) {
+            return node->then_expr ? node->then_expr : node;
+        }
+        return node->else_expr ? node->else_expr : node;
+    }
+
+    std::shared_ptr<Symbol> simplifyBlock(const std::shared_ptr<Symbol>& node) {
+        auto& expressions = node->expressions;
+        // Literals other than the block's value have no effect
+        for (size_t i = 0; i + 1 < expressions.size();) {
+            if (isLiteral(expressions[i]) && expressions[i]->arguments.empty()) {
+                expressions.erase(expressions.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        if (expressions.size() != 1) {
+            return node;
+        }
+        const auto& inner = expressions[0];
+        // The block's frame only matters if something binds into it; its
+        // consarray flag (taken from the inner expression) must still hold
+        if (!inner || bindsInScope(inner) ||
+            inner->consarray != node->consarray) {
+            return node;
+        }
+        return inner;
+    }
+
+    // Marks the largest invariant subtrees inside the parts of the tree that
+    // run repeatedly (path steps, filters, lambda bodies, group-by, sort
+    // terms and transforms); literals and variables are left as they are
+    void markInvariants(const std::shared_ptr<Symbol>& node, bool repeated) {
+        if (!node) {
+            return;
+        }
+        const auto type = node->nodeType();
+        if (repeated && type != NodeType::Variable && !isLiteral(node) &&
+            type != NodeType::Regex && isInvariant(node)) {
+            node->invariant = true;
+            collectBuiltins(node, node->invariantCalls);
+            return;
+        }
+        if (repeated && type == NodeType::Path) {
+            planHashJoin(node);
+        }
+        if (node->group) {
+            planAggregates(node->group);
+        }
+        std::unordered_set<const Symbol*> loops;
+        for (const auto& step : node->steps) {
+            loops.insert(step.get());
+        }
+        for (const auto& term : node->terms) {
+            loops.insert(term.get());
+        }
+        for (auto* filters : {&node->predicate, &node->stages}) {
+            for (const auto& filter : *filters) {
+                if (filter &&
+                    filter->expr.type() == typeid(std::shared_ptr<Symbol>)) {
+                    loops.insert(
+                        std::any_cast<const std::shared_ptr<Symbol>&>(
+                            filter->expr)
+                            .get());
+                }
+            }
+        }
+        if (type == NodeType::Lambda) {
+            loops.insert(node->body.get());
+        }
+        loops.insert(node->group.get());
+        loops.insert(node->update.get());
+        loops.insert(node->delete_.get());
+        forEachChild(node, [this, repeated,
+                            &loops](const std::shared_ptr<Symbol>& child) {
+            if (child) {
+                markInvariants(child, repeated || loops.count(child.get()));
+            }
+        });
+    }
+
+    // A path such as $$.customers[id = $order.customerId].name, evaluated
+    // for many orders, looks the customers up by id instead of scanning them
+    void planHashJoin(const std::shared_ptr<Symbol>& node) {
+        if (node->join || !isPlain(node) || node->keepSingletonArray ||
+            parentNodes_.count(node.get())) {
+            return;
+        }
+        for (size_t length = 2; length <= node->steps.size(); length++) {
+            if (auto join = hashJoin(node, length)) {
+                node->join = join;
+                return;
+            }
+        }
+    }
+
+    // A join of the first `length` steps of the path, the last of them
+    // filtered by field = key; nullptr when they are not of that form
+    std::shared_ptr<Symbol::HashJoin> hashJoin(
+        const std::shared_ptr<Symbol>& node, size_t length) {
+        const auto& last = node->steps[length - 1];
+        if (!last || last->nodeType() != NodeType::Name ||
+            last->value.type() != typeid(std::string) ||
+            last->stages.size() != 1 || !last->stages[0] ||
+            last->stages[0]->nodeType() != NodeType::Filter ||
+            last->stages[0]->expr.type() != typeid(std::shared_ptr<Symbol>)) {
+            return nullptr;
+        }
+        auto join = std::make_shared<Symbol::HashJoin>();
+        join->length = length;
+        join->step = std::make_shared<Symbol>(*last);
+        join->step->stages.clear();
+        if (!isPlain(join->step)) {
+            return nullptr;
+        }
+        const auto& test = std::any_cast<const std::shared_ptr<Symbol>&>(
+            last->stages[0]->expr);
+        if (!test || !isPlain(test) || test->nodeType() != NodeType::Binary ||
+            test->opCode() != OpCode::Equal) {
+            return nullptr;
+        }
+        if (isItemField(test->lhs) && isContextFree(test->rhs, true)) {
+            join->field = test->lhs;
+            join->key = test->rhs;
+        } else if (isItemField(test->rhs) && isContextFree(test->lhs, true)) {
+            join->field = test->rhs;
+            join->key = test->lhs;
+        } else {
+            return nullptr;
+        }
+
+        if (length == 2) {
+            join->source = node->steps[0];
+            if (join->source->nodeType() != NodeType::Variable &&
+                !join->source->consarray) {
+                return nullptr;
+            }
+        } else {
+            join->source = std::make_shared<Symbol>(*node);
+            join->source->steps.resize(length - 1);
+            join->source->firstMatch = false;
+        }
+        if (!isInvariant(join->source)) {
+            return nullptr;
+        }
+        collectBuiltins(join->source, join->calls);
+        return join;
+    }
+
+    // {category: $sum(price)} can keep a running sum per category instead of
+    // collecting each category's items first. The keys must be pure, since
+    // the evaluator computes them again if it has to collect the items
+    // after all
+    void planAggregates(const std::shared_ptr<Symbol>& group) {
+        static const std::unordered_set<std::string> aggregates = {
+            "sum", "count", "max", "min", "average"};
+        if (group->lhsObject.empty()) {
+            return;
+        }
+        for (const auto& [key, value] : group->lhsObject) {
+            if (!isPure(key) || !value || !isPlain(value) ||
+                value->nodeType() != NodeType::Function ||
+                !callsPureBuiltin(value) || value->arguments.size() != 1 ||
+                !aggregates.count(std::any_cast<const std::string&>(
+                    value->procedure->value))) {
+                return;
+            }
+            const auto& arg = value->arguments[0];
+            if (!(arg && isPlain(arg) &&
+                  arg->nodeType() == NodeType::Variable &&
+                  isContextVariable(arg)) &&
+                !isItemField(arg)) {
+                return;
+            }
+        }
+        group->aggregates = true;
+    }
+
+    // A field of the context item: a name, or a path of names
+    static bool isItemField(const std::shared_ptr<Symbol>& node) {
+        return node && isPlain(node) &&
+               ((node->nodeType() == NodeType::Name &&
+                 node->value.type() == typeid(std::string)) ||
+                (node->nodeType() == NodeType::Path && !node->fields.empty()));
+    }
+
+    // True when the node has the same value wherever it is evaluated during
+    // one evaluation: it reads no context and no variable the expression
+    // binds, and calls only pure builtins with all their arguments given
+    bool isInvariant(const std::shared_ptr<Symbol>& node) {
+        return isContextFree(node, false);
+    }
+
+    // Like isInvariant, but with bound set the node may also read variables
+    // the expression binds, so it is only independent of the context item
+    bool isContextFree(const std::shared_ptr<Symbol>& node, bool bound) {
+        if (!node) {
+            return true;
+        }
+        if (parentNodes_.count(node.get()) || !isPure(node->group) ||
+            !filtersArePure(node)) {
+            return false;
+        }
+        switch (node->nodeType()) {
+            case NodeType::String:
+            case NodeType::Number:
+            case NodeType::Value:
+            case NodeType::Regex:
+                return true;
+            case NodeType::Variable:
+                return bound ? !isContextVariable(node) : isGlobal(node);
+            case NodeType::Unary:
+                if (node->opCode() == OpCode::Negate) {
+                    return isContextFree(node->expression, bound);
+                }
+                if (node->opCode() == OpCode::ArrayConstructor) {
+                    return allContextFree(node->expressions, bound);
+                }
+                if (node->opCode() == OpCode::ObjectConstructor) {
+                    for (const auto& [key, value] : node->lhsObject) {
+                        if (!isContextFree(key, bound) ||
+                            !isContextFree(value, bound)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                return false;
+            case NodeType::Binary:
+                return node->opCode() != OpCode::None &&
+                       node->opCode() != OpCode::Other &&
+                       isContextFree(node->lhs, bound) &&
+                       isContextFree(node->rhs, bound);
+            case NodeType::Condition:
+                return isContextFree(node->condition, bound) &&
+                       isContextFree(node->then_expr, bound) &&
+                       isContextFree(node->else_expr, bound);
+            case NodeType::Block:
+                return allContextFree(node->expressions, bound);
+            case NodeType::Function:
+                return callsPureBuiltin(node) &&
+                       allContextFree(node->arguments, bound) &&
+                       !takesContext(node);
+            case NodeType::Path: {
+                // The first step gives the input of the others; it is
+                // evaluated once only if it is a variable or an array
+                // constructor, otherwise once per item of an array context
+                if (node->steps.empty() || node->tuple.has_value() ||
+                    !(node->steps[0]->nodeType() == NodeType::Variable ||
+                      node->steps[0]->consarray) ||
+                    !isContextFree(node->steps[0], bound)) {
+                    return false;
+                }
+                for (size_t i = 1; i < node->steps.size(); i++) {
+                    if (!isPure(node->steps[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    bool allContextFree(const std::vector<std::shared_ptr<Symbol>>& nodes,
+                        bool bound) {
+        for (const auto& node : nodes) {
+            if (!isContextFree(node, bound)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // True when the node's value depends only on its context item: it binds
+    // nothing, reads no variable the expression binds, and calls only pure
+    // builtins
+    bool isPure(const std::shared_ptr<Symbol>& node) {
+        if (!node) {
+            return true;
+        }
+        if (parentNodes_.count(node.get())) {
+            return false;
+        }
+        switch (node->nodeType()) {
+            case NodeType::Bind:
+            case NodeType::Lambda:
+            case NodeType::Partial:
+            case NodeType::Apply:
+            case NodeType::Transform:
+            case NodeType::Parent:
+                return false;
+            case NodeType::Variable:
+                if (!isGlobal(node) && !isContextVariable(node)) {
+                    return false;
+                }
+                break;
+            case NodeType::Function:
+                if (!callsPureBuiltin(node)) {
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+        bool pure = true;
+        forEachChild(node, [this, &pure](const std::shared_ptr<Symbol>& child) {
+            pure = pure && isPure(child);
+        });
+        return pure;
+    }
+
+    bool filtersArePure(const std::shared_ptr<Symbol>& node) {
+        for (auto* filters : {&node->predicate, &node->stages}) {
+            for (const auto& filter : *filters) {
+                if (filter &&
+                    filter->expr.type() == typeid(std::shared_ptr<Symbol>) &&
+                    !isPure(std::any_cast<const std::shared_ptr<Symbol>&>(
+                        filter->expr))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // A named variable the expression never binds, such as $$, an
+    // evaluation binding or a builtin
+    bool isGlobal(const std::shared_ptr<Symbol>& node) const {
+        if (node->value.type() != typeid(std::string)) {
+            return false;
+        }
+        const auto& name = std::any_cast<const std::string&>(node->value);
+        return !name.empty() && !boundNames_.count(name);
+    }
+
+    // $ on its own
+    static bool isContextVariable(const std::shared_ptr<Symbol>& node) {
+        return node->value.type() == typeid(std::string) &&
+               std::any_cast<const std::string&>(node->value).empty();
+    }
+
+    bool callsPureBuiltin(const std::shared_ptr<Symbol>& node) const {
+        const auto& procedure = node->procedure;
+        if (!procedure || procedure->nodeType() != NodeType::Variable ||
+            procedure->value.type() != typeid(std::string)) {
+            return false;
+        }
+        const auto& name = std::any_cast<const std::string&>(procedure->value);
+        return pureBuiltins().count(name) && !boundNames_.count(name);
+    }
+
+    // True when the call may take an argument from the context, i.e. it
+    // leaves out a parameter the builtin's signature marks with '-'
+    bool takesContext(const std::shared_ptr<Symbol>& node) {
+        auto function = instance_.getEnvironment()->lookup(
+            std::any_cast<const std::string&>(node->procedure->value));
+        if (function.type() != typeid(JFunction)) {
+            return true;
+        }
+        const auto& signature =
+            std::any_cast<const JFunction&>(function).signature;
+        return signature && signature->hasContextParam() &&
+               node->arguments.size() <
+                   static_cast<size_t>(signature->getNumberOfArgs());
+    }
+
+    // Node each replacement stands for, to undo replacements that would
+    // change how an enclosing array constructor treats the element
+    std::unordered_map<const Symbol*, std::shared_ptr<Symbol>> original_;
+};
+
+}  // namespace
+
+std::shared_ptr<Parser::Symbol> optimize(
+    const std::shared_ptr<Parser::Symbol>& ast, Jsonata& instance) {
+    return Optimizer(instance).run(ast);
+}
+
+}  // namespace jsonata
@@ -18,9 +18,12 @@
  */
 #include "jsonata/Parser.h"
 
+#include <atomic>
 #include <iostream>
 #include <sstream>
+#include <unordered_set>
 
+#include "jsonata/Jsonata.h"
 #include "jsonata/Utils.h"
 
 namespace jsonata {
@@ -121,6 +124,138 @@ std::string Parser::Symbol::toString() const {
     return oss.str();
 }
 
+void Parser::Symbol::resolveType() {
+    kind = nodeTypeOf(type);
+    op = opCodeOf(kind, value);
+    if (kind == NodeType::Variable && value.type() == typeid(std::string)) {
+        varSlot = Frame::slotOf(std::any_cast<const std::string&>(value));
+    }
+    if (focus.type() == typeid(std::string)) {
+        focusSlot = Frame::slotOf(std::any_cast<const std::string&>(focus));
+    }
+    if (index.type() == typeid(std::string)) {
+        indexSlot = Frame::slotOf(std::any_cast<const std::string&>(index));
+    } else if (kind == NodeType::Index && value.type() == typeid(std::string)) {
+        indexSlot = Frame::slotOf(std::any_cast<const std::string&>(value));
+    }
+    // Labels are final once the parser has processed the AST
+    const Symbol* labelled = ancestor.get();
+    if (kind == NodeType::Parent &&
+        slot.type() == typeid(std::shared_ptr<Symbol>)) {
+        labelled = std::any_cast<const std::shared_ptr<Symbol>&>(slot).get();
+    }
+    if (labelled != nullptr && !labelled->label.empty()) {
+        ancestorSlot = Frame::slotOf(labelled->label);
+    }
+}
+
+/* static */ Parser::NodeType Parser::nodeTypeOf(const std::string& type) {
+    static const std::unordered_map<std::string, NodeType> types = {
+        {"string", NodeType::String},
+        {"number", NodeType::Number},
+        {"value", NodeType::Value},
+        {"name", NodeType::Name},
+        {"variable", NodeType::Variable},
+        {"binary", NodeType::Binary},
+        {"unary", NodeType::Unary},
+        {"function", NodeType::Function},
+        {"partial", NodeType::Partial},
+        {"regex", NodeType::Regex},
+        {"wildcard", NodeType::Wildcard},
+        {"path", NodeType::Path},
+        {"condition", NodeType::Condition},
+        {"descendant", NodeType::Descendant},
+        {"apply", NodeType::Apply},
+        {"bind", NodeType::Bind},
+        {"lambda", NodeType::Lambda},
+        {"transform", NodeType::Transform},
+        {"parent", NodeType::Parent},
+        {"block", NodeType::Block},
+        {"sort", NodeType::Sort},
+        {"filter", NodeType::Filter},
+        {"index", NodeType::Index},
+        {"operator", NodeType::Operator},
+    };
+    auto it = types.find(type);
+    return it != types.end() ? it->second : NodeType::Other;
+}
+
+/* static */ Parser::OpCode Parser::opCodeOf(NodeType type,
+                                             const std::any& value) {
+    if (type != NodeType::Binary && type != NodeType::Unary) {
+        return OpCode::None;
+    }
+    if (!value.has_value() || value.type() != typeid(std::string)) {
+        return OpCode::Other;
+    }
+    const auto& op = std::any_cast<const std::string&>(value);
+    if (type == NodeType::Unary) {
+        if (op == "[") return OpCode::ArrayConstructor;
+        if (op == "{") return OpCode::ObjectConstructor;
+        if (op == "-") return OpCode::Negate;
+        if (op == "!") return OpCode::Not;
+        return OpCode::Other;
+    }
+    static const std::unordered_map<std::string, OpCode> binaryOps = {
+        {"+", OpCode::Add},          {"-", OpCode::Subtract},
+        {"*", OpCode::Multiply},     {"/", OpCode::Divide},
+        {"%", OpCode::Modulo},       {"=", OpCode::Equal},
+        {"!=", OpCode::NotEqual},    {"<", OpCode::Less},
+        {"<=", OpCode::LessEqual},   {">", OpCode::Greater},
+        {">=", OpCode::GreaterEqual}, {"&", OpCode::Concat},
+        {"..", OpCode::Range},       {"in", OpCode::In},
+        {"and", OpCode::And},        {"or", OpCode::Or},
+    };
+    auto it = binaryOps.find(op);
+    return it != binaryOps.end() ? it->second : OpCode::Other;
+}
+
+/* static */ const char* Parser::opName(OpCode op) {
+    switch (op) {
+        case OpCode::Add:
+            return "+";
+        case OpCode::Subtract:
+        case OpCode::Negate:
+            return "-";
+        case OpCode::Multiply:
+            return "*";
+        case OpCode::Divide:
+            return "/";
+        case OpCode::Modulo:
+            return "%";
+        case OpCode::Equal:
+            return "=";
+        case OpCode::NotEqual:
+            return "!=";
+        case OpCode::Less:
+            return "<";
+        case OpCode::LessEqual:
+            return "<=";
+        case OpCode::Greater:
+            return ">";
+        case OpCode::GreaterEqual:
+            return ">=";
+        case OpCode::Concat:
+            return "&";
+        case OpCode::Range:
+            return "..";
+        case OpCode::In:
+            return "in";
+        case OpCode::And:
+            return "and";
+        case OpCode::Or:
+            return "or";
+        case OpCode::ArrayConstructor:
+            return "[";
+        case OpCode::ObjectConstructor:
+            return "{";
+        case OpCode::Not:
+            return "!";
+        default:
+            return "";
+    }
+}
+
 // Terminal implementation
 Parser::Terminal::Terminal(const std::string& id) : Symbol(id, 0) {}
 
@@ -1328,6 +1463,9 @@ std::shared_ptr<Parser::Symbol> Parser::parse(const std::string& source,
         throw JException("S0217", expr->position, expr->type);
     }
 
+    resolveNodeTypes(expr);
+    markScope(expr);
+
     if (!errors_.empty()) {
         // Store errors in the expression
         // expr->errors = errors_; // Would need to implement errors storage
@@ -1643,6 +1781,142 @@ void Parser::resolveAncestry(std::shared_ptr<Symbol> path) {
     }
 }
 
+void Parser::resolveNodeTypes(const std::shared_ptr<Symbol>& node) {
+    // Pre-order walk; a node that is already resolved has had its subtree
+    // visited (shared subtrees are only walked once)
+    if (!node || node->kind != NodeType::Unresolved) return;
+    node->resolveType();
+
+    auto exprOf = [](const std::shared_ptr<Symbol>& s) {
+        if (s && s->expr.has_value() &&
+            s->expr.type() == typeid(std::shared_ptr<Symbol>)) {
+            resolveNodeTypes(std::any_cast<std::shared_ptr<Symbol>>(s->expr));
+        }
+    };
+
+    for (const auto* child :
+         {&node->lhs, &node->rhs, &node->expression, &node->condition,
+          &node->then_expr, &node->else_expr, &node->body, &node->procedure,
+          &node->group, &node->pattern, &node->update, &node->delete_}) {
+        resolveNodeTypes(*child);
+    }
+    for (const auto* list :
+         {&node->expressions, &node->arguments, &node->steps, &node->terms,
+          &node->predicate, &node->stages}) {
+        for (const auto& child : *list) {
+            resolveNodeTypes(child);
+            exprOf(child);
+        }
+    }
+    for (const auto& pair : node->lhsObject) {
+        resolveNodeTypes(pair.first);
+        resolveNodeTypes(pair.second);
+    }
+    if (node->kind == NodeType::Path) {
+        markFieldPath(node);
+    }
+}
+
+namespace {
+
+// Calls f on each distinct node of the tree, parents first
+template <class F>
+void forEachNode(const std::shared_ptr<Parser::Symbol>& root, F&& f) {
+    using Symbol = Parser::Symbol;
+    std::unordered_set<const Symbol*> seen;
+    std::vector<const std::shared_ptr<Symbol>*> pending = {&root};
+    while (!pending.empty()) {
+        const auto& node = *pending.back();
+        pending.pop_back();
+        if (!node || !seen.insert(node.get()).second) {
+            continue;
+        }
+        f(node);
+        for (const auto* child :
+             {&node->lhs, &node->rhs, &node->expression, &node->condition,
+              &node->then_expr, &node->else_expr, &node->body,
+              &node->procedure, &node->group, &node->pattern, &node->update,
+              &node->delete_}) {
+            pending.push_back(child);
+        }
+        for (const auto* list :
+             {&node->expressions, &node->arguments, &node->steps,
+              &node->terms, &node->predicate, &node->stages}) {
+            for (const auto& child : *list) {
+                pending.push_back(&child);
+                if (child && child->expr.type() == typeid(std::shared_ptr<Symbol>)) {
+                    pending.push_back(
+                        std::any_cast<std::shared_ptr<Symbol>>(&child->expr));
+                }
+            }
+        }
+        for (const auto& pair : node->lhsObject) {
+            pending.push_back(&pair.first);
+            pending.push_back(&pair.second);
+        }
+    }
+}
+
+}  // namespace
+
+void Parser::markScope(const std::shared_ptr<Symbol>& expr) {
+    static std::atomic<uint32_t> lastScope{0};
+    const uint32_t scope = ++lastScope;
+
+    // Names bound anywhere in the expression: := targets, lambda
+    // parameters, and the @$v / #$i variables of tuple steps
+    std::unordered_set<std::string> bound;
+    auto addName = [&bound](const std::any& name) {
+        if (name.type() == typeid(std::string)) {
+            bound.insert(std::any_cast<const std::string&>(name));
+        }
+    };
+    forEachNode(expr, [&](const std::shared_ptr<Symbol>& node) {
+        node->scope = scope;
+        if (node->kind == NodeType::Bind && node->lhs) {
+            addName(node->lhs->value);
+        } else if (node->kind == NodeType::Lambda) {
+            for (const auto& param : node->arguments) {
+                if (param) addName(param->value);
+            }
+        }
+        addName(node->focus);
+        addName(node->index);
+        if (node->kind == NodeType::Index) {
+            addName(node->value);
+        }
+    });
+    forEachNode(expr, [&](const std::shared_ptr<Symbol>& node) {
+        node->freeVariable = node->kind == NodeType::Variable &&
+                             node->value.type() == typeid(std::string) &&
+                             !bound.count(std::any_cast<const std::string&>(
+                                 node->value));
+    });
+}
+
+void Parser::markFieldPath(const std::shared_ptr<Symbol>& path) {
+    // Only paths like a.b.c qualify: no predicates, focus (@), index (#),
+    // ancestry, group-by or [] anywhere along the path
+    if (path->steps.empty() || path->tuple.has_value() ||
+        path->keepSingletonArray || path->group) {
+        return;
+    }
+    std::vector<std::string> fields;
+    fields.reserve(path->steps.size());
+    for (const auto& step : path->steps) {
+        if (!step || step->kind != NodeType::Name ||
+            step->value.type() != typeid(std::string) ||
+            !step->predicate.empty() || !step->stages.empty() ||
+            step->group || step->focus.has_value() ||
+            step->index.has_value() || step->tuple.has_value() ||
+            step->keepArray) {
+            return;
+        }
+        fields.push_back(std::any_cast<const std::string&>(step->value));
+    }
+    path->fields = std::move(fields);
+}
+
 std::shared_ptr<Parser::Symbol> Parser::processAST(
     std::shared_ptr<Symbol> expr) {
     if (!expr) return nullptr;
@@ -35,30 +35,26 @@ Timebox::Timebox(Frame& expr, int64_t timeout, int64_t maxDepth)
 }
 
 void Timebox::initialize(Frame& expr) {
-    // Register callbacks with the Frame using environment lookup (Java
-    // reference: same logic as Timebox.java lines 51-60) Store the callbacks in
-    // the frame's environment for lookup during evaluation
-    EntryCallback entryCallback = [this](std::shared_ptr<Parser::Symbol> exp,
-                                         const std::any& input,
-                                         std::shared_ptr<Frame> env) {
-        // Java reference: if (_env.isParallelCall) return; (Timebox.java line
-        // 52)
-        if (env->isParallelCall) return;
-        this->onEvaluateEntry();
-    };
+    // Observe every node evaluated under this frame (Java reference:
+    // Timebox.java lines 51-60 register entry/exit callbacks)
+    expr.addObserver(this);
+}
 
-    ExitCallback exitCallback =
-        [this](std::shared_ptr<Parser::Symbol> exp, const std::any& input,
-               std::shared_ptr<Frame> env, const std::any& result) {
-            // Java reference: if (_env.isParallelCall) return; (Timebox.java
-            // line 57)
-            if (env->isParallelCall) return;
-            this->onEvaluateExit();
-        };
+void Timebox::onEvaluateEntry(const std::shared_ptr<Parser::Symbol>& expr,
+                              const std::any& input,
+                              const std::shared_ptr<Frame>& environment) {
+    // Java reference: if (_env.isParallelCall) return; (Timebox.java line 52)
+    if (environment->isParallelCall) return;
+    onEvaluateEntry();
+}
 
-    // Store callbacks in the environment for lookup during evaluation
-    expr.bind("__evaluate_entry", entryCallback);
-    expr.bind("__evaluate_exit", exitCallback);
+void Timebox::onEvaluateExit(const std::shared_ptr<Parser::Symbol>& expr,
+                             const std::any& input,
+                             const std::shared_ptr<Frame>& environment,
+                             const std::any& result) {
+    // Java reference: if (_env.isParallelCall) return; (Timebox.java line 57)
+    if (environment->isParallelCall) return;
+    onEvaluateExit();
 }
 
 void Timebox::onEvaluateEntry() {
@@ -18,7 +18,9 @@
  */
 #include "jsonata/Utils.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
 #include "jsonata/Functions.h"  // For Functions::isLambda in Utils::type
@@ -364,6 +366,179 @@ Utils::JList Utils::arrayify(const std::any& value) {
     return result;
 }
 
+Utils::JList Utils::arrayify(std::any&& value) {
+    if (value.type() == typeid(JList)) {
+        auto* jlist = std::any_cast<JList>(&value);
+        if (!jlist->isRange()) {
+            return std::move(*jlist);
+        }
+    }
+    return arrayify(static_cast<const std::any&>(value));
+}
+
+namespace {
+
+// Spreads the bits of a value (splitmix64 finalizer)
+uint64_t mixHash(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+template <typename Items>
+bool hashItems(const Items& items, uint64_t& h) {
+    for (const auto& item : items) {
+        auto itemHash = Utils::structuralHash(item);
+        if (!itemHash) {
+            return false;
+        }
+        h = mixHash(h ^ *itemHash);
+    }
+    return true;
+}
+
+}  // namespace
+
+std::optional<uint64_t> Utils::structuralHash(const std::any& value) {
+    // Each kind starts from its own seed so that, say, "1" and 1 differ
+    if (!value.has_value()) {
+        return mixHash(1);
+    }
+    if (isNullValue(value)) {
+        return mixHash(2);
+    }
+    if (value.type() == typeid(std::string)) {
+        return mixHash(3 ^ std::hash<std::string>()(
+                                std::any_cast<const std::string&>(value)));
+    }
+    if (value.type() == typeid(bool)) {
+        return mixHash(std::any_cast<bool>(value) ? 4 : 5);
+    }
+    if (value.type() == typeid(double) || isNumeric(value)) {
+        // Integers hash by their double value, as deepEquals compares them;
+        // -0.0 and 0.0 are equal and NaN is never equal to anything
+        double d = toDouble(value) + 0.0;
+        if (std::isinf(d)) {
+            return std::nullopt;
+        }
+        uint64_t bits = 0;
+        if (!std::isnan(d)) {
+            std::memcpy(&bits, &d, sizeof bits);
+        }
+        return mixHash(6 ^ mixHash(bits));
+    }
+    if (value.type() == typeid(JList)) {
+        const auto& list = std::any_cast<const JList&>(value);
+        uint64_t h = mixHash(7 ^ list.size());
+        if (list.isRange()) {
+            for (size_t i = 0; i < list.size(); i++) {
+                h = mixHash(h ^ *structuralHash(list[i]));
+            }
+        } else if (!hashItems(list, h)) {
+            return std::nullopt;
+        }
+        return h;
+    }
+    if (value.type() == typeid(std::vector<std::any>)) {
+        const auto& items = std::any_cast<const std::vector<std::any>&>(value);
+        uint64_t h = mixHash(7 ^ items.size());
+        if (!hashItems(items, h)) {
+            return std::nullopt;
+        }
+        return h;
+    }
+    if (value.type() == typeid(nlohmann::ordered_map<std::string, std::any>)) {
+        // Entries are combined by addition, which ignores their order
+        const auto& object =
+            std::any_cast<const nlohmann::ordered_map<std::string, std::any>&>(
+                value);
+        uint64_t h = mixHash(8 ^ object.size());
+        for (const auto& [key, item] : object) {
+            auto itemHash = structuralHash(item);
+            if (!itemHash) {
+                return std::nullopt;
+            }
+            h += mixHash(std::hash<std::string>()(key) ^ mixHash(*itemHash));
+        }
+        return h;
+    }
+    // Functions and other values are never equal to anything
+    return mixHash(9);
+}
+
+Utils::OrderKey Utils::orderKey(const std::any& value) {
+    OrderKey key;
+    if (!value.has_value()) {
+        return key;
+    }
+    const std::type_info& type = value.type();
+    if (type == typeid(std::string)) {
+        key.kind = OrderKey::Kind::String;
+        key.text = *std::any_cast<std::string>(&value);
+    } else if (type == typeid(double)) {
+        double d = std::any_cast<double>(value);
+        if (std::isinf(d)) {
+            throw JException("D1001", 0, value);
+        }
+        if (!std::isnan(d)) {
+            key.kind = OrderKey::Kind::Double;
+            key.number = d;
+        }
+    } else if (type == typeid(int64_t)) {
+        key.kind = OrderKey::Kind::Integer;
+        key.integer = std::any_cast<int64_t>(value);
+    } else if (type == typeid(uint64_t) &&
+               std::any_cast<uint64_t>(value) >
+                   static_cast<uint64_t>(
+                       std::numeric_limits<int64_t>::max())) {
+        key.kind = OrderKey::Kind::Double;
+        key.number = static_cast<double>(std::any_cast<uint64_t>(value));
+    } else if (isNumeric(value)) {
+        key.kind = OrderKey::Kind::Integer;
+        key.integer = toLong(value);
+    }
+    return key;
+}
+
+namespace {
+
+// Three-way comparison of an integer with a (non-NaN) double, without
+// rounding the integer
+int compareIntegerDouble(int64_t i, double d) {
+    // 2^63 is exact as a double; every int64 is below it
+    constexpr double kLimit = 9223372036854775808.0;
+    if (d >= kLimit) return -1;
+    if (d < -kLimit) return 1;
+    // d now lies in int64's range, so truncating it is exact
+    auto whole = static_cast<int64_t>(d);
+    if (i != whole) return i < whole ? -1 : 1;
+    double fraction = d - static_cast<double>(whole);
+    return fraction > 0 ? -1 : (fraction < 0 ? 1 : 0);
+}
+
+}  // namespace
+
+int Utils::compareOrderKeys(const OrderKey& a, const OrderKey& b) {
+    using Kind = OrderKey::Kind;
+    if (a.kind == Kind::String) {
+        int c = a.text.compare(b.text);
+        return c == 0 ? 0 : (c < 0 ? -1 : 1);
+    }
+    if (a.kind == Kind::Integer) {
+        if (b.kind == Kind::Integer) {
+            return a.integer == b.integer ? 0 : (a.integer < b.integer ? -1 : 1);
+        }
+        return compareIntegerDouble(a.integer, b.number);
+    }
+    if (b.kind == Kind::Integer) {
+        return -compareIntegerDouble(b.integer, a.number);
+    }
+    return a.number == b.number ? 0 : (a.number < b.number ? -1 : 1);
+}
+
 void Utils::checkUrl(const std::string& str) {
     bool isHigh = false;
     for (size_t i = 0; i < str.length(); i++) {
@@ -497,28 +672,221 @@ void Utils::quote(const std::string& string, std::ostringstream& w) {
     }
 }
 
+// EvaluationArena method implementations
+
+thread_local EvaluationArena* EvaluationArena::current_ = nullptr;
+
+std::shared_ptr<EvaluationArena> EvaluationArena::create() {
+    // The shared pointer owns the arena's first reference; item buffers
+    // take their own
+    return std::shared_ptr<EvaluationArena>(
+        new EvaluationArena(), [](EvaluationArena* arena) { arena->release(); });
+}
+
+// ItemVector method implementations
+
+Utils::ItemVector::ItemVector(size_t count, const std::any& value)
+    : data_(&inline_) {
+    reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        data_[i] = value;
+    }
+    size_ = static_cast<uint32_t>(count);
+}
+
+Utils::ItemVector::ItemVector(std::initializer_list<std::any> init)
+    : ItemVector(init.begin(), init.end()) {}
+
+Utils::ItemVector::ItemVector(const std::vector<std::any>& items)
+    : ItemVector(items.begin(), items.end()) {}
+
+Utils::ItemVector::ItemVector(std::vector<std::any>&& items)
+    : ItemVector(std::make_move_iterator(items.begin()),
+                 std::make_move_iterator(items.end())) {}
+
+Utils::ItemVector::ItemVector(const ItemVector& other)
+    : ItemVector(other.begin(), other.end()) {}
+
+Utils::ItemVector::ItemVector(ItemVector&& other) noexcept
+    : data_(&inline_) {
+    swap(other);
+}
+
+Utils::ItemVector& Utils::ItemVector::operator=(const ItemVector& other) {
+    if (this != &other) {
+        clear();
+        insert(end(), other.begin(), other.end());
+    }
+    return *this;
+}
+
+Utils::ItemVector& Utils::ItemVector::operator=(ItemVector&& other) noexcept {
+    if (this != &other) {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+void Utils::ItemVector::clear() noexcept {
+    for (uint32_t i = 0; i < size_; i++) {
+        data_[i].reset();
+    }
+    size_ = 0;
+}
+
+void Utils::ItemVector::resize(size_t count) {
+    reserve(count);
+    for (size_t i = count; i < size_; i++) {
+        data_[i].reset();
+    }
+    size_ = static_cast<uint32_t>(count);
+}
+
+void Utils::ItemVector::swap(ItemVector& other) noexcept {
+    if (this == &other) {
+        return;
+    }
+    const bool thisInline = data_ == &inline_;
+    const bool otherInline = other.data_ == &other.inline_;
+    // A heap buffer changes owner by pointer; the inline slots swap their
+    // contents
+    std::any* const thisData = data_;
+    data_ = otherInline ? &inline_ : other.data_;
+    other.data_ = thisInline ? &other.inline_ : thisData;
+    inline_.swap(other.inline_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(arena_, other.arena_);
+}
+
+std::any& Utils::ItemVector::at(size_t index) {
+    if (index >= size_) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    return data_[index];
+}
+
+const std::any& Utils::ItemVector::at(size_t index) const {
+    if (index >= size_) {
+        throw std::out_of_range("Index out of bounds");
+    }
+    return data_[index];
+}
+
+Utils::ItemVector::iterator Utils::ItemVector::insert(const_iterator pos,
+                                                      std::any value) {
+    iterator at = openGap(static_cast<size_t>(pos - data_), 1);
+    *at = std::move(value);
+    return at;
+}
+
+Utils::ItemVector::iterator Utils::ItemVector::erase(const_iterator first,
+                                                     const_iterator last) {
+    iterator from = data_ + (first - data_);
+    const size_t count = static_cast<size_t>(last - first);
+    if (count > 0) {
+        std::move(from + count, end(), from);
+        for (size_t i = size_ - count; i < size_; i++) {
+            data_[i].reset();
+        }
+        size_ -= static_cast<uint32_t>(count);
+    }
+    return from;
+}
+
+void Utils::ItemVector::grow(size_t capacity) {
+    if (capacity > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Sequence too large");
+    }
+    reallocate(std::max<size_t>(capacity, 2), EvaluationArena::current());
+}
+
+void Utils::ItemVector::reallocate(size_t capacity, EvaluationArena* arena) {
+    std::any* items;
+    if (arena != nullptr) {
+        items = static_cast<std::any*>(
+            arena->allocate(capacity * sizeof(std::any), alignof(std::any)));
+        std::uninitialized_value_construct_n(items, capacity);
+        arena->retain();
+    } else {
+        items = new std::any[capacity];
+    }
+    std::move(data_, data_ + size_, items);
+    if (data_ != &inline_) {
+        freeBuffer();
+    } else {
+        inline_.reset();
+    }
+    data_ = items;
+    capacity_ = static_cast<uint32_t>(capacity);
+    arena_ = arena;
+}
+
+void Utils::ItemVector::freeBuffer() noexcept {
+    if (arena_ != nullptr) {
+        std::destroy_n(data_, capacity_);
+        arena_->deallocate(data_, capacity_ * sizeof(std::any),
+                           alignof(std::any));
+        arena_->release();
+    } else {
+        delete[] data_;
+    }
+}
+
+Utils::ItemVector::iterator Utils::ItemVector::openGap(size_t index,
+                                                       size_t count) {
+    if (size_ + count > capacity_) {
+        grow(std::max<size_t>(size_ + count, size_t{capacity_} * 2));
+    }
+    std::move_backward(data_ + index, data_ + size_, data_ + size_ + count);
+    size_ += static_cast<uint32_t>(count);
+    return data_ + index;
+}
+
 // JList method implementations
 
 // Copy constructor
 Utils::JList::JList(const JList& other)
-    : std::vector<std::any>(other),
+    : ItemVector(other),
       range_start_(other.range_start_),
-      range_end_(other.range_end_),
-      is_range_(other.is_range_) {
-    // Copy JSONata-specific flags
-    sequence = other.sequence;
-    outerWrapper = other.outerWrapper;
-    tupleStream = other.tupleStream;
-    keepSingleton = other.keepSingleton;
-    cons = other.cons;
+      range_end_(other.range_end_) {
+    copyFlags(other);
+}
+
+// Move constructor
+Utils::JList::JList(JList&& other) noexcept
+    : ItemVector(std::move(other)),
+      range_start_(other.range_start_),
+      range_end_(other.range_end_) {
+    copyFlags(other);
+}
+
+Utils::JList& Utils::JList::operator=(const JList& other) {
+    if (this != &other) {
+        ItemVector::operator=(other);
+        range_start_ = other.range_start_;
+        range_end_ = other.range_end_;
+        copyFlags(other);
+    }
+    return *this;
+}
+
+Utils::JList& Utils::JList::operator=(JList&& other) noexcept {
+    if (this != &other) {
+        ItemVector::operator=(std::move(other));
+        range_start_ = other.range_start_;
+        range_end_ = other.range_end_;
+        copyFlags(other);
+    }
+    return *this;
 }
 
 // Range constructor
 Utils::JList::JList(int64_t start, int64_t end)
-    : std::vector<std::any>(),
-      range_start_(start),
-      range_end_(end),
-      is_range_(true) {
+    : range_start_(start), range_end_(end) {
+    clearFlags();
+    is_range_ = true;
     if (start > end) {
         throw std::invalid_argument("Range start must be <= end");
     }
@@ -532,7 +900,7 @@ size_t Utils::JList::size() const {
     if (is_range_) {
         return static_cast<size_t>(range_end_ - range_start_ + 1);
     }
-    return std::vector<std::any>::size();
+    return ItemVector::size();
 }
 
 // Override operator[] for ranges (const)
@@ -544,14 +912,14 @@ std::any Utils::JList::operator[](size_t index) const {
         int64_t value = range_start_ + static_cast<int64_t>(index);
         return Utils::convertNumber(std::any(static_cast<double>(value)));
     }
-    return std::vector<std::any>::operator[](index);
+    return ItemVector::operator[](index);
 }
 
 // Provide non-const operator[] so assignments work; materialize ranges on
 // demand
 std::any& Utils::JList::operator[](size_t index) {
     materializeRangeIfNeeded();
-    return std::vector<std::any>::operator[](index);
+    return ItemVector::operator[](index);
 }
 
 // Override at() for ranges (const)
@@ -563,13 +931,13 @@ std::any Utils::JList::at(size_t index) const {
         int64_t value = range_start_ + static_cast<int64_t>(index);
         return Utils::convertNumber(std::any(static_cast<double>(value)));
     }
-    return std::vector<std::any>::at(index);
+    return ItemVector::at(index);
 }
 
 // Provide non-const at() so assignments work; materialize ranges on demand
 std::any& Utils::JList::at(size_t index) {
     materializeRangeIfNeeded();
-    return std::vector<std::any>::at(index);
+    return ItemVector::at(index);
 }
 
 // Override empty() for ranges
@@ -577,7 +945,7 @@ bool Utils::JList::empty() const {
     if (is_range_) {
         return size() == 0;
     }
-    return std::vector<std::any>::empty();
+    return ItemVector::empty();
 }
 
 // Range iterator operator*
@@ -632,13 +1000,13 @@ void Utils::JList::materializeRangeIfNeeded() {
 Utils::JList::base_iterator Utils::JList::begin() {
     // Materialize range if needed for iteration
     const_cast<JList*>(this)->materializeRangeIfNeeded();
-    return std::vector<std::any>::begin();
+    return ItemVector::begin();
 }
 
 Utils::JList::base_iterator Utils::JList::end() {
     // Materialize range if needed for iteration
     const_cast<JList*>(this)->materializeRangeIfNeeded();
-    return std::vector<std::any>::end();
+    return ItemVector::end();
 }
 
 Utils::JList::base_const_iterator Utils::JList::begin() const {
@@ -649,7 +1017,7 @@ Utils::JList::base_const_iterator Utils::JList::begin() const {
         // contents don't change, just the internal representation
         const_cast<JList*>(this)->materializeRangeIfNeeded();
     }
-    return std::vector<std::any>::begin();
+    return ItemVector::begin();
 }
 
 Utils::JList::base_const_iterator Utils::JList::end() const {
@@ -659,7 +1027,7 @@ Utils::JList::base_const_iterator Utils::JList::end() const {
         // contents don't change, just the internal representation
         const_cast<JList*>(this)->materializeRangeIfNeeded();
     }
-    return std::vector<std::any>::end();
+    return ItemVector::end();
 }
 
 Utils::JList::base_const_iterator Utils::JList::cbegin() const {
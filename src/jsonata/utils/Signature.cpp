@@ -334,6 +334,11 @@ void Signature::throwValidationError(const Utils::JList &badArgs,
 
 Utils::JList Signature::validate(const Utils::JList &args,
                                  const std::any &context) {
+    return validate(Utils::JList(args), context);
+}
+
+Utils::JList Signature::validate(Utils::JList &&args,
+                                 const std::any &context) {
     Utils::JList result;
 
     std::string suppliedSig = "";
@@ -347,11 +352,13 @@ Utils::JList Signature::validate(const Utils::JList &args,
     std::smatch isValid;
     if (std::regex_match(suppliedSig, isValid, regex_)) {
         Utils::JList validatedArgs;
+        auto &items = static_cast<Utils::ItemVector &>(args);
         size_t argIndex = 0;
 
         for (size_t index = 0; index < params_.size(); index++) {
             const Param &param = params_[index];
-            std::any arg = argIndex < args.size() ? args[argIndex] : std::any{};
+            // Each argument is moved out of args into validatedArgs
+            std::any arg;
             std::string match = isValid[index + 1].str();
 
             if (match.empty()) {
@@ -365,14 +372,14 @@ Utils::JList Signature::validate(const Utils::JList &args,
                     if (std::regex_match(contextType, paramRegex)) {
                         // If context is a JList with outerWrapper, unwrap it
                         // for function arguments
-                        std::any contextArg = context;
-                        if (context.type() == typeid(Utils::JList)) {
-                            auto jlist = std::any_cast<Utils::JList>(context);
-                            if (jlist.outerWrapper && !jlist.empty()) {
-                                contextArg = jlist[0];
-                            }
+                        const auto *jlist =
+                            std::any_cast<Utils::JList>(&context);
+                        if (jlist != nullptr && jlist->outerWrapper &&
+                            !jlist->empty()) {
+                            validatedArgs.push_back((*jlist)[0]);
+                        } else {
+                            validatedArgs.push_back(context);
                         }
-                        validatedArgs.push_back(contextArg);
                     } else {
                         // context value not compatible with this argument
                         throw JException("T0411", -1,
@@ -390,7 +397,10 @@ Utils::JList Signature::validate(const Utils::JList &args,
                         wrappedMissing.push_back(std::any{});
                         validatedArgs.push_back(wrappedMissing);
                     } else {
-                        validatedArgs.push_back(arg);
+                        if (argIndex < items.size()) {
+                            arg = std::move(items[argIndex]);
+                        }
+                        validatedArgs.push_back(std::move(arg));
                     }
                     argIndex++;
                 }
@@ -414,8 +424,9 @@ Utils::JList Signature::validate(const Utils::JList &args,
                                 arg = std::any{};
                             }
                         } else {
-                            arg = argIndex < args.size() ? args[argIndex]
-                                                         : std::any{};
+                            arg = argIndex < items.size()
+                                      ? std::move(items[argIndex])
+                                      : std::any{};
                             bool arrayOK = true;
                             // is there type information on the contents of the
                             // array?
@@ -427,66 +438,35 @@ Utils::JList Signature::validate(const Utils::JList &args,
                                     arrayOK = false;
                                 } else if (single == 'a') {
                                     // Java reference: lines 355-369 - handle
-                                    // List (both vector and RangeList)
-                                    try {
-                                        // Try std::vector first (most common
-                                        // case)
-                                        auto argArr =
-                                            std::any_cast<Utils::JList>(arg);
-                                        if (!argArr.empty()) {
-                                            std::string itemType =
-                                                getSymbol(argArr[0]);
-                                            if (itemType !=
-                                                std::string(1,
-                                                            param.subtype[0])) {
-                                                arrayOK = false;
-                                            } else {
-                                                // make sure every item in the
-                                                // array is this type
-                                                for (const auto &item :
-                                                     argArr) {
-                                                    if (getSymbol(item) !=
-                                                        itemType) {
-                                                        arrayOK = false;
-                                                        break;
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    } catch (const std::bad_any_cast &) {
-                                        try {
-                                            // Java reference: exact same logic
-                                            // for RangeList as List
-                                            auto rangeList =
-                                                std::any_cast<Utils::RangeList>(
-                                                    arg);
-                                            if (rangeList.size() > 0) {
-                                                std::any firstItem =
-                                                    rangeList[0];
-                                                std::string itemType =
-                                                    getSymbol(firstItem);
-                                                if (itemType !=
-                                                    std::string(
-                                                        1, param.subtype[0])) {
+                                    // List (both vector and RangeList). The
+                                    // items are read in place; a range holds
+                                    // only numbers, so it is not scanned
+                                    const auto *argArr =
+                                        std::any_cast<Utils::JList>(&arg);
+                                    if (argArr == nullptr) {
+                                        arrayOK = false;
+                                    } else if (argArr->isRange()) {
+                                        arrayOK = argArr->empty() ||
+                                                  param.subtype[0] == 'n';
+                                    } else if (!argArr->empty()) {
+                                        const auto &items =
+                                            static_cast<const Utils::ItemVector &>(
+                                                *argArr);
+                                        std::string itemType =
+                                            getSymbol(items[0]);
+                                        if (itemType !=
+                                            std::string(1, param.subtype[0])) {
+                                            arrayOK = false;
+                                        } else {
+                                            // make sure every item in the
+                                            // array is this type
+                                            for (const auto &item : items) {
+                                                if (getSymbol(item) !=
+                                                    itemType) {
                                                     arrayOK = false;
-                                                } else {
-                                                    // make sure every item in
-                                                    // the array is this type
-                                                    for (size_t i = 0;
-                                                         i < rangeList.size();
-                                                         ++i) {
-                                                        std::any item =
-                                                            rangeList[i];
-                                                        if (getSymbol(item) !=
-                                                            itemType) {
-                                                            arrayOK = false;
-                                                            break;
-                                                        }
-                                                    }
+                                                    break;
                                                 }
                                             }
-                                        } catch (const std::bad_any_cast &) {
-                                            arrayOK = false;
                                         }
                                     }
                                 }
@@ -502,16 +482,17 @@ Utils::JList Signature::validate(const Utils::JList &args,
                             // the function expects an array. If it's not one,
                             // make it so
                             if (single != 'a') {
-                                Utils::JList wrappedArg = {arg};
-                                arg = wrappedArg;
+                                Utils::JList wrappedArg = {std::move(arg)};
+                                arg = std::move(wrappedArg);
                             }
                         }
-                        validatedArgs.push_back(arg);
+                        validatedArgs.push_back(std::move(arg));
                         argIndex++;
                     } else {
-                        arg = argIndex < args.size() ? args[argIndex]
-                                                     : std::any{};
-                        validatedArgs.push_back(arg);
+                        arg = argIndex < items.size()
+                                  ? std::move(items[argIndex])
+                                  : std::any{};
+                        validatedArgs.push_back(std::move(arg));
                         argIndex++;
                     }
                 }
@@ -527,6 +508,15 @@ int64_t Signature::getNumberOfArgs() const {
     return static_cast<int64_t>(params_.size());
 }
 
+bool Signature::hasContextParam() const {
+    for (const auto &p : params_) {
+        if (p.context) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int64_t Signature::getMinNumberOfArgs() const {
     int64_t res = 0;
     for (const auto &p : params_) {
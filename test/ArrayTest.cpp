@@ -2,6 +2,10 @@
 #include <jsonata/Jsonata.h>
 #include <nlohmann/json.hpp>
 #include <jsonata/JException.h>
+#include <jsonata/Functions.h>
+#include <jsonata/utils/Signature.h>
+
+#include <algorithm>
 
 namespace jsonata {
 
@@ -14,6 +18,45 @@ protected:
     void TearDown() override {
         // Cleanup code if needed
     }
+
+    // Evaluates expression against data and compares with the JSON text
+    static void expectResult(const std::string& expression,
+                             const nlohmann::ordered_json& data,
+                             const std::string& expected) {
+        Jsonata expr(expression);
+        EXPECT_EQ(expr.evaluate(data), nlohmann::ordered_json::parse(expected))
+            << expression;
+    }
+
+    // Evaluates expression, counting how often the field name is read
+    static nlohmann::ordered_json evaluateCounting(
+        const std::string& expression, const nlohmann::ordered_json& data,
+        const std::string& field, int& reads) {
+        Jsonata expr(expression);
+        auto bindings = expr.createFrame();
+        bindings->setEvaluateEntryCallback(
+            [&](std::shared_ptr<Parser::Symbol> node, const std::any&,
+                std::shared_ptr<Frame>) {
+                if (node->type == "name" &&
+                    node->value.type() == typeid(std::string) &&
+                    std::any_cast<const std::string&>(node->value) == field) {
+                    reads++;
+                }
+            });
+        reads = 0;
+        return expr.evaluate(data, bindings);
+    }
+
+    // The evaluator's result before it is converted to JSON
+    static std::any evaluateRaw(Jsonata& expr, const nlohmann::ordered_json& data) {
+        return expr.evaluate(expr.expression_, Jsonata::orderedJsonToAny(data),
+                             expr.createFrame(expr.getEnvironment()));
+    }
+
+    static bool isRange(const std::any& value) {
+        const auto* list = std::any_cast<Utils::JList>(&value);
+        return list != nullptr && list->isRange();
+    }
 };
 
 TEST_F(ArrayTest, testNegativeIndex) {
@@ -98,4 +141,387 @@ TEST_F(ArrayTest, testAssertCustomMessage) {
     }
 }
 
+TEST_F(ArrayTest, testArrayifyMovesList) {
+    Utils::JList list = Utils::createSequence();
+    list.push_back(std::any(int64_t(1)));
+    list.push_back(std::any(std::string("two")));
+    list.keepSingleton = true;
+
+    std::any value(std::move(list));
+    auto moved = Utils::arrayify(std::move(value));
+    ASSERT_EQ(moved.size(), 2u);
+    EXPECT_TRUE(moved.sequence);
+    EXPECT_TRUE(moved.keepSingleton);
+    EXPECT_EQ(std::any_cast<int64_t>(moved[0]), 1);
+    EXPECT_EQ(std::any_cast<std::string>(moved[1]), "two");
+
+    // Ranges are still materialized into a plain list
+    std::any range(Utils::JList(1, 3));
+    auto materialized = Utils::arrayify(std::move(range));
+    ASSERT_EQ(materialized.size(), 3u);
+    EXPECT_FALSE(materialized.isRange());
+    EXPECT_EQ(std::any_cast<int64_t>(materialized[2]), 3);
+}
+
+TEST_F(ArrayTest, testSingletonListsStayInline) {
+    Utils::JList list = Utils::createSequence(std::any(std::string("one")));
+    EXPECT_EQ(list.capacity(), 1u);
+    EXPECT_TRUE(list.sequence);
+
+    // Moving an inline item keeps it and leaves the source empty
+    Utils::JList moved(std::move(list));
+    ASSERT_EQ(moved.size(), 1u);
+    EXPECT_TRUE(moved.sequence);
+    EXPECT_EQ(std::any_cast<std::string>(moved[0]), "one");
+    EXPECT_TRUE(list.empty());
+
+    // Growing spills into a heap buffer; edits keep the item order
+    for (int64_t i = 0; i < 5; i++) {
+        moved.push_back(std::any(i));
+    }
+    moved.erase(moved.begin() + 1, moved.begin() + 3);
+    moved.insert(moved.begin(), std::any(int64_t(-1)));
+    ASSERT_EQ(moved.size(), 5u);
+    EXPECT_EQ(std::any_cast<int64_t>(moved[0]), -1);
+    EXPECT_EQ(std::any_cast<std::string>(moved[1]), "one");
+    EXPECT_EQ(std::any_cast<int64_t>(moved[2]), 2);
+    EXPECT_EQ(std::any_cast<int64_t>(moved[4]), 4);
+
+    Utils::JList copy = moved;
+    copy.swap(list);
+    EXPECT_TRUE(copy.empty());
+    EXPECT_EQ(list.size(), 5u);
+}
+
+TEST_F(ArrayTest, testPositionalFilterStopsEarly) {
+    auto data = nlohmann::ordered_json::parse(R"({"items": [
+        {"n": 1, "id": "a"}, {"n": 2, "id": "b"},
+        {"n": 3, "id": "c"}, {"n": 4, "id": "d"}]})");
+    int reads = 0;
+
+    // A constant index after a filter stops the scan at the selected match
+    EXPECT_EQ(evaluateCounting("items[n != 1][0].id", data, "n", reads), "b");
+    EXPECT_EQ(reads, 2);
+    EXPECT_EQ(evaluateCounting("items[n != 1][1].id", data, "n", reads), "c");
+    EXPECT_EQ(reads, 3);
+    EXPECT_EQ(evaluateCounting("items[n in [1, 2]][-1].id", data, "n", reads),
+              "b");
+    EXPECT_EQ(reads, 3);
+    EXPECT_EQ(evaluateCounting("items[n != 1].id", data, "n", reads),
+              nlohmann::ordered_json::parse(R"(["b", "c", "d"])"));
+    EXPECT_EQ(reads, 4);
+
+    // $exists stops at the first match
+    EXPECT_EQ(evaluateCounting("$exists(items[n = 2])", data, "n", reads), true);
+    EXPECT_EQ(reads, 2);
+    EXPECT_EQ(evaluateCounting("$exists(items[n = 9])", data, "n", reads), false);
+    EXPECT_EQ(reads, 4);
+
+    // A predicate that can fail on a later item scans every item, so the
+    // error is raised as without the index
+    EXPECT_EQ(evaluateCounting("items[n > 1][0].id", data, "n", reads), "b");
+    EXPECT_EQ(reads, 4);
+    auto mixed = nlohmann::ordered_json::parse(
+        R"({"a": [{"v": 1}, {"v": 2}, {"v": "x"}]})");
+    for (const auto* expression : {"a[v > 1][0]", "$exists(a[v > 1])"}) {
+        try {
+            Jsonata(expression).evaluate(mixed);
+            FAIL() << "expected T2009 from " << expression;
+        } catch (const JException& e) {
+            EXPECT_EQ(e.getError(), "T2009") << expression;
+        }
+    }
+
+    // A rebound $exists still gets the whole argument
+    Jsonata rebound("$exists(items[n > 1])");
+    rebound.registerFunction("exists", [](const Utils::JList& args) -> std::any {
+        return std::any(static_cast<int64_t>(Utils::arrayify(args[0]).size()));
+    });
+    EXPECT_EQ(rebound.evaluate(data), nlohmann::ordered_json(3));
+}
+
+TEST_F(ArrayTest, testGroupByKeepsKeyOrder) {
+    auto data = nlohmann::ordered_json::parse(R"({"items": [
+        {"c": "b", "n": 1}, {"c": "a", "n": [2, 3]}, {"c": "b", "n": 4},
+        {"c": "a", "n": []}, {"c": "b", "n": [5]}, {"c": "c", "n": 6}
+    ]})");
+    Jsonata groups("items{c: n}");
+    EXPECT_EQ(groups.evaluate(data), nlohmann::ordered_json::parse(
+                                         R"({"b": [1, 4, 5], "a": [2, 3], "c": 6})"));
+
+    Jsonata sums("items{c: $sum(n)}");
+    EXPECT_EQ(sums.evaluate(data),
+              nlohmann::ordered_json::parse(R"({"b": 10, "a": 5, "c": 6})"));
+
+    // Only groups of more than one item are lists
+    Jsonata lists("items{c: [n]}");
+    EXPECT_EQ(lists.evaluate(data), nlohmann::ordered_json::parse(
+                                        R"({"b": [1, 4, 5], "a": [2, 3], "c": [6]})"));
+
+    Jsonata clash("items{c: n, 'a': 0}");
+    try {
+        clash.evaluate(data);
+        FAIL() << "expected D1009";
+    } catch (const JException& e) {
+        EXPECT_EQ(e.getError(), "D1009");
+    }
+}
+
+TEST_F(ArrayTest, testSortIsStable) {
+    auto data = nlohmann::ordered_json::parse(R"({"items": [
+        {"id": 1, "g": "b", "s": 2}, {"id": 2, "g": "a"}, {"id": 3, "g": "b", "s": 1},
+        {"id": 4, "g": "a", "s": 2}, {"id": 5, "g": "b", "s": 2}, {"id": 6, "g": "a", "s": 1}
+    ]})");
+    int calls = 0;
+    auto countCalls = [&calls](const Utils::JList& args) -> std::any {
+        calls++;
+        return args[0];
+    };
+
+    // Each item's first key is evaluated once; ties keep input order
+    Jsonata byGroup("items^($key(g)).id");
+    byGroup.registerFunction("key", countCalls);
+    EXPECT_EQ(byGroup.evaluate(data), nlohmann::ordered_json::parse("[2, 4, 6, 1, 3, 5]"));
+    EXPECT_EQ(calls, 6);
+
+    Jsonata byScore("items^(>s).id");
+    EXPECT_EQ(byScore.evaluate(data), nlohmann::ordered_json::parse("[1, 4, 5, 3, 6, 2]"));
+
+    Jsonata twoTerms("items^(g, >s).id");
+    EXPECT_EQ(twoTerms.evaluate(data), nlohmann::ordered_json::parse("[4, 6, 2, 1, 5, 3]"));
+
+    Jsonata mixed("items^(id = 2 ? g : s).id");
+    try {
+        mixed.evaluate(data);
+        FAIL() << "expected T2007";
+    } catch (const JException& e) {
+        EXPECT_EQ(e.getError(), "T2007");
+    }
+
+    // A large sort with many ties (parallel sorting, which is opt-in, is
+    // covered by ThreadTest)
+    std::vector<int64_t> values;
+    for (int64_t i = 0; i < 70000; i++) {
+        values.push_back((i * 7919) % 70001);
+    }
+    auto expected = values;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](int64_t a, int64_t b) { return a % 10 > b % 10; });
+    Jsonata sortLarge("$^(>($ % 10))");
+    EXPECT_EQ(sortLarge.evaluate(nlohmann::ordered_json(values)),
+              nlohmann::ordered_json(expected));
+}
+
+TEST_F(ArrayTest, testSortedPrefix) {
+    auto data = nlohmann::ordered_json::parse(R"({"items": [
+        {"id": 1, "s": 2}, {"id": 2}, {"id": 3, "s": 1}, {"id": 4, "s": 2},
+        {"id": 5, "s": 3}, {"id": 6, "s": 1}
+    ], "mixed": [{"s": 1}, {"s": "a"}, {"s": 2}], "values": [3, 1, 2, 1, 5]})");
+
+    // A constant index after a sort bounds how many items are ordered
+    Jsonata first("items^(>s)[0].id");
+    EXPECT_EQ(Jsonata::sortLimit(first.expression_->steps[1]->stages), 1u);
+    EXPECT_EQ(first.evaluate(data), nlohmann::ordered_json(5));
+    Jsonata leading("items^(>s)[[0..2]].id");
+    EXPECT_EQ(Jsonata::sortLimit(leading.expression_->steps[1]->stages), 3u);
+    EXPECT_EQ(leading.evaluate(data), nlohmann::ordered_json::parse("[5, 1, 4]"));
+    Jsonata filtered("items^(s)[id > 3].id");
+    EXPECT_EQ(Jsonata::sortLimit(filtered.expression_->steps[1]->stages), 0u);
+    EXPECT_EQ(filtered.evaluate(data), nlohmann::ordered_json::parse("[6, 4, 5]"));
+
+    // Ties keep input order
+    expectResult("items^(>s)[[3, 1]].id", data, "[1, 3]");
+    expectResult("items^(s)[[0..9]].id", data, "[3, 6, 1, 4, 5, 2]");
+    expectResult("items^(s)[-1].id", data, "2");
+
+    // A function call learns the limit from its predicate
+    size_t limit = 0;
+    JFunction sorted;
+    sorted.implementation = [&limit](const Utils::JList& args,
+                                     const EvalContext& context) -> std::any {
+        limit = context.limit;
+        return Functions::sortWithContext(args, context);
+    };
+    Jsonata pair("$sorted(values)[[1, 2]]");
+    pair.registerFunction("sorted", sorted);
+    EXPECT_EQ(pair.evaluate(data), nlohmann::ordered_json::parse("[1, 2]"));
+    EXPECT_EQ(limit, 3u);
+    expectResult("$sort(values)[0]", data, "1");
+    expectResult("values ~> $sort()", data, "[1, 1, 2, 3, 5]");
+
+    // Keys that cannot be compared are still reported
+    for (const char* expression : {"mixed^(s)[0]", "$sort(mixed.s)[0]"}) {
+        Jsonata expr(expression);
+        EXPECT_THROW(expr.evaluate(data), JException) << expression;
+    }
+}
+
+TEST_F(ArrayTest, testDistinctKeepsFirstOccurrences) {
+    auto data = nlohmann::ordered_json::parse(R"({"values": [
+        1, 1.0, "1", 1, {"a": 1, "b": [2]}, {"b": [2], "a": 1}, {"a": 1, "b": 2},
+        {"b": 2, "a": 1}, [1], [1], null, null, true, true, -0.0, 0.0, "1"
+    ]})");
+    Jsonata distinct("$distinct(values)");
+    EXPECT_EQ(distinct.evaluate(data), nlohmann::ordered_json::parse(R"([
+        1, 1.0, "1", {"a": 1, "b": [2]}, {"b": [2], "a": 1}, {"a": 1, "b": 2},
+        [1], [1], null, true, -0.0
+    ])"));
+
+    auto tags = nlohmann::ordered_json::array();
+    for (int i = 0; i < 20000; i++) {
+        tags.push_back("t" + std::to_string(i % 1000));
+    }
+    Jsonata count("$count($distinct($))");
+    EXPECT_EQ(count.evaluate(tags), nlohmann::ordered_json(1000));
+}
+
+TEST_F(ArrayTest, testWildcardFlattensInOrder) {
+    auto data = nlohmann::ordered_json::parse(R"({
+        "a": [1, [2, [3, 4]]], "b": {"c": [5, 6], "d": 7}, "e": [],
+        "orders": [{"items": [{"n": "x"}, {"n": "y"}]}, {"items": [{"n": "z"}]}]
+    })");
+    expectResult("*", data, R"([1, 2, 3, 4, {"c": [5, 6], "d": 7},
+        {"items": [{"n": "x"}, {"n": "y"}]}, {"items": [{"n": "z"}]}])");
+    expectResult("b.*", data, "[5, 6, 7]");
+    expectResult("**.n", data, R"(["x", "y", "z"])");
+    expectResult("orders#$i.items.{'i': $i, 'n': n}", data,
+                 R"([{"i": 0, "n": "x"}, {"i": 0, "n": "y"}, {"i": 1, "n": "z"}])");
+    expectResult("$append([], [1..3])", data, "[1, 2, 3]");
+    expectResult("$append(a, b.c)", data, "[1, [2, [3, 4]], 5, 6]");
+
+    // Appending and flattening extend the target list where it is
+    Utils::JList items;
+    items.reserve(8);
+    items.push_back(std::any(int64_t(1)));
+    std::any target(std::move(items));
+    const auto* list = std::any_cast<Utils::JList>(&target);
+    const std::any* storage = list->data();
+    Functions::appendTo(target, std::any(Utils::JList{std::any(int64_t(2)),
+                                                      std::any(int64_t(3))}));
+    ASSERT_EQ(std::any_cast<Utils::JList>(&target), list);
+    EXPECT_EQ(list->data(), storage);
+    EXPECT_EQ(list->size(), 3u);
+
+    Jsonata expr("*");
+    Utils::JList flattened;
+    flattened.reserve(8);
+    flattened.push_back(std::any(int64_t(0)));
+    storage = flattened.data();
+    expr.flatten(Jsonata::orderedJsonToAny(data["a"]), flattened);
+    EXPECT_EQ(flattened.data(), storage);
+    ASSERT_EQ(flattened.size(), 5u);
+    EXPECT_EQ(std::any_cast<int64_t>(flattened[4]), 4);
+
+    auto wide = nlohmann::ordered_json::object();
+    for (int i = 0; i < 20000; i++) {
+        wide["k" + std::to_string(i)] = {i, i + 1};
+    }
+    expectResult("$count(*)", wide, "40000");
+}
+
+TEST_F(ArrayTest, testRangesStayLazy) {
+    auto data = nlohmann::ordered_json::parse(R"({"n": 5000000})");
+
+    // Ranges are returned and bound as ranges
+    Jsonata range("[1..n]");
+    EXPECT_TRUE(isRange(evaluateRaw(range, data)));
+    Jsonata bound("($r := [1..n]; $r)");
+    EXPECT_TRUE(isRange(evaluateRaw(bound, data)));
+
+    // They reach functions, through signature validation, lambdas and path
+    // steps, without being materialized
+    JFunction probe;
+    probe.signature = std::make_shared<utils::Signature>("<a<n>:b>", "probe");
+    probe.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
+        std::any arg = args[0];
+        return std::any(isRange(arg));
+    };
+    auto probed = [&](const char* expression) {
+        Jsonata expr(expression);
+        expr.registerFunction("probe", probe);
+        return expr.evaluate(data);
+    };
+    EXPECT_EQ(probed("$probe([1..n])"), true);
+    EXPECT_EQ(probed("$map([1..3], function($v, $i, $a){ $probe($a) })"),
+              nlohmann::ordered_json::parse("[true, true, true]"));
+    EXPECT_EQ(probed("[1..3].$probe([1..$])"),
+              nlohmann::ordered_json::parse("[true, true, true]"));
+
+    // Aggregates and higher-order functions read them in place
+    expectResult("$sum([1..n])", data, "12500002500000");
+    expectResult("$count([1..n])", data, "5000000");
+    expectResult("$max([1..n])", data, "5000000");
+    expectResult("$min([-3..n])", data, "-3");
+    expectResult("$average([1..n])", data, "2500000.5");
+    expectResult("$map([1..5], function($v, $i, $a){$v * $i + $count($a)})", data,
+                 "[5, 7, 11, 17, 25]");
+    expectResult("$filter([1..10], function($v){$v % 3 = 0})", data, "[3, 6, 9]");
+    expectResult("$reduce([1..5], function($a, $b){$a + $b})", data, "15");
+    expectResult("$reduce([1..5], function($a, $b, $i){$a + $b * $i}, 100)", data,
+                 "140");
+    expectResult("[1..5].($ * 2)", data, "[2, 4, 6, 8, 10]");
+    expectResult("[1..3].[1..$]", data, "[[1], [1, 2], [1, 2, 3]]");
+
+    auto items = nlohmann::ordered_json::array();
+    for (int i = 0; i < 20000; i++) {
+        items.push_back({{"v", i}});
+    }
+    expectResult("$count($map($, function($x){$x.v}))", items, "20000");
+}
+
+TEST_F(ArrayTest, testTupleStreamBindings) {
+    auto data = nlohmann::ordered_json::parse(R"({
+        "loans": [{"c": "x", "isbn": "2"}, {"c": "y", "isbn": "1"},
+                  {"c": "x", "isbn": "1"}],
+        "books": [{"isbn": "1", "t": "A", "p": 3}, {"isbn": "2", "t": "B", "p": 5}],
+        "orders": [{"id": "o1", "items": [{"n": "a"}, {"n": "b"}]},
+                   {"id": "o2", "items": [{"n": "c"}]}]
+    })");
+    expectResult("loans@$l.books@$b[$l.isbn=$b.isbn].{'c': $l.c, 't': $b.t}", data,
+                 R"([{"c": "x", "t": "B"}, {"c": "y", "t": "A"}, {"c": "x", "t": "A"}])");
+    expectResult("loans@$l.books@$b[$l.isbn=$b.isbn]^(>$b.p, $l.c).$l.c", data,
+                 R"(["x", "x", "y"])");
+    expectResult("loans@$l.books@$b[$l.isbn=$b.isbn]{$l.c: $sum($b.p)}", data,
+                 R"({"x": 8, "y": 3})");
+    expectResult("books#$i{isbn: $i}", data, R"({"1": 0, "2": 1})");
+    expectResult("orders.items#$i[$i=0].n", data, R"(["a", "c"])");
+    expectResult("orders.items.{'n': n, 'o': %.id}", data,
+                 R"([{"n": "a", "o": "o1"}, {"n": "b", "o": "o1"}, {"n": "c", "o": "o2"}])");
+    // Closures made for each tuple keep their own bindings
+    expectResult("($fs := books#$i.function(){ $i }; $map($fs, function($f){ $f() }))",
+                 data, "[0, 1]");
+
+    // A frame reads a tuple's bindings in place until it adopts them
+    Tuple tuple;
+    tuple.context = std::make_shared<std::any>(int64_t(0));
+    tuple.bind(Frame::slotOf("l"), std::make_shared<std::any>(std::string("x")));
+    auto frame = std::make_shared<Frame>(nullptr);
+    frame->borrowTuple(&tuple);
+    EXPECT_TRUE(frame->getSlots().empty());
+    *tuple.bindings[0].second = std::string("y");
+    EXPECT_EQ(std::any_cast<std::string>(frame->lookup("l")), "y");
+    frame->adoptTuple();
+    *tuple.bindings[0].second = std::string("z");
+    EXPECT_EQ(std::any_cast<std::string>(frame->lookup("l")), "y");
+    EXPECT_EQ(frame->getSlots().size(), 1u);
+
+    // A tuple derived from another shares its values
+    Tuple derived = tuple;
+    derived.bind(Frame::slotOf("b"), std::make_shared<std::any>(int64_t(1)));
+    EXPECT_EQ(derived.bindings[0].second, tuple.bindings[0].second);
+    EXPECT_EQ(derived.find(Frame::slotOf("l")), tuple.find(Frame::slotOf("l")));
+
+    auto big = nlohmann::ordered_json::object();
+    for (int i = 0; i < 300; i++) {
+        big["loans"].push_back({{"isbn", i}});
+        big["books"].push_back({{"isbn", i % 50}});
+    }
+    expectResult("$count(loans@$l.books@$b[$l.isbn=$b.isbn])", big, "300");
+    auto items = nlohmann::ordered_json::array();
+    for (int i = 0; i < 20000; i++) {
+        items.push_back({{"v", i}});
+    }
+    expectResult("$count($#$i[$i%2=0])", items, "10000");
+}
+
 } // namespace jsonata
@@ -0,0 +1,214 @@
+#include <gtest/gtest.h>
+#include <jsonata/Jsonata.h>
+#include <jsonata/JException.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace jsonata {
+
+class CompileTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static nlohmann::ordered_json data() {
+        return nlohmann::ordered_json::parse(R"({
+            "order": {"items": [
+                {"name": "a", "price": 2, "qty": 3},
+                {"name": "b", "price": 5, "qty": 1},
+                {"name": "c", "price": 1.5, "qty": 4}
+            ]},
+            "status": "open"
+        })");
+    }
+
+    static bool uses(const CompiledExpression& compiled, vm::Op op) {
+        for (const auto& ins : compiled.getProgram().code) {
+            if (ins.op == op) return true;
+        }
+        return false;
+    }
+
+    // Compiled output must match the tree walker exactly
+    static void expectSame(const std::string& text) {
+        Jsonata expr(text);
+        auto expected = expr.evaluate(data());
+        auto compiled = expr.compile();
+        EXPECT_EQ(compiled.run(data()), expected) << text;
+        EXPECT_EQ(compiled.run(data()), expected) << text << " (rerun)";
+    }
+};
+
+TEST_F(CompileTest, testMatchesTreeWalker) {
+    const std::vector<std::string> expressions = {
+        "1 + 2 * 3",
+        "status = 'open' and $count(order.items) > 2",
+        "order.items.name",
+        "order.items[price > 1].name",
+        "$sum(order.items.(price * qty))",
+        "order.items[0].name & '-' & order.items[-1].name",
+        "status = 'closed' ? 'done' : -order.items[1].price",
+        "($total := $sum(order.items.price); $x := 2; $total * $x)",
+        "order.items^(>price).name",
+        "order.items{name: qty}",
+        "$map(order.items, function($i) { $i.price })",
+        "order.missing.field",
+        "order.items[price > 1][-1].name",
+        "order.items.[name, qty][1]",
+        "$.order.items[qty > 1].(price * qty)",
+        "[1..3]",
+        "$",
+        "order.items[[0, 2]].name",
+        "order.items[price > 1][0][0].name",
+        "order.items.name[$ != 'b']",
+        "order.items[qty].name",
+        "order.items[-1]",
+        "order.items.[name][]",
+        "[[1, 2], [3]].$[0]",
+        "[].missing",
+        "$.order.items[name = 'c'].qty",
+        "$exists(order.items[price > 100])",
+        "$filter(order.items, function($v, $i) { $i > 0 }).name",
+        "($add := function($a) { function($b) { $a + $b } }; $add(2)(3))",
+        "($inc := $map(?, function($v) { $v + 1 }); $inc([1, 2]))",
+    };
+    for (const auto& text : expressions) {
+        expectSame(text);
+    }
+}
+
+TEST_F(CompileTest, testLowersStepsFiltersAndLambdas) {
+    // None of these needs the tree walker
+    for (const char* text :
+         {"$count(order.items[qty > 1].price) + 1",
+          "order.items[price > 1][-1].(price * qty)",
+          "$map(order.items, function($i) { $i.price * $i.qty })",
+          "($f := function($n) { $n < 2 ? $n : $f($n - 1) + 1 }; $f(5))",
+          "[1, 2, 3].($ * 2)[$ > 2]", "order.items.name[]"}) {
+        Jsonata expr(text);
+        auto compiled = expr.compile();
+        EXPECT_FALSE(uses(compiled, vm::Op::Evaluate)) << text;
+        EXPECT_EQ(compiled.run(data()), expr.evaluate(data())) << text;
+    }
+    auto filtered = Jsonata("order.items[qty > 1].price").compile();
+    EXPECT_TRUE(uses(filtered, vm::Op::StepBegin));
+    EXPECT_TRUE(uses(filtered, vm::Op::FilterBegin));
+    EXPECT_TRUE(uses(Jsonata("function($x) { $x }").compile(), vm::Op::Lambda));
+}
+
+TEST_F(CompileTest, testCompiledClosuresRunAsBytecode) {
+    // A closure made by the program carries its body's entry point, also
+    // when a builtin calls it
+    Jsonata expr("$map(order.items, function($i) { $i.qty })");
+    auto compiled = expr.compile();
+    auto bindings = expr.createFrame();
+    EXPECT_EQ(compiled.run(data(), bindings),
+              nlohmann::ordered_json::parse("[3, 1, 4]"));
+
+    Jsonata probe("$probe(function($x) { $x + 1 })");
+    const vm::Program* seen = nullptr;
+    probe.registerFunction("probe", [&](const Utils::JList& args) -> std::any {
+        auto lambda = std::any_cast<std::shared_ptr<Parser::Symbol>>(args[0]);
+        seen = lambda->program.get();
+        return std::any(true);
+    });
+    auto program = probe.compile();
+    program.run(data());
+    EXPECT_EQ(seen, &program.getProgram());
+    seen = nullptr;
+    probe.evaluate(data());
+    EXPECT_EQ(seen, nullptr);
+}
+
+TEST_F(CompileTest, testLowersFieldPathsToOneInstruction) {
+    Jsonata expr("order.items.price");
+    EXPECT_EQ(expr.expression_->fields,
+              (std::vector<std::string>{"order", "items", "price"}));
+    auto compiled = expr.compile();
+    bool hasFieldPath = false;
+    for (const auto& ins : compiled.getProgram().code) {
+        hasFieldPath = hasFieldPath || ins.op == vm::Op::FieldPath;
+        EXPECT_NE(ins.op, vm::Op::Evaluate);
+    }
+    EXPECT_TRUE(hasFieldPath);
+    EXPECT_TRUE(Jsonata("order.items[0].price").expression_->fields.empty());
+}
+
+TEST_F(CompileTest, testFieldPathsMatchStepwiseEvaluation) {
+    // An observer keeps evaluatePath on the step-by-step route
+    auto input = nlohmann::ordered_json::parse(R"({
+        "a": [{"b": [[{"c": 1}, {"c": [2, 3]}]]}, {"b": {"c": null}},
+              {"b": [{"c": [[4]]}]}, {"x": 1}],
+        "s": {"t": [[5, 6]]},
+        "u": {"v": {"w": [7]}}
+    })");
+    for (const char* text : {"a.b.c", "a.b", "a.b.c.d", "s.t", "u.v.w",
+                             "u.v", "a", "missing.field"}) {
+        Jsonata expr(text);
+        auto bindings = expr.createFrame();
+        bindings->setEvaluateEntryCallback(
+            [](std::shared_ptr<Parser::Symbol>, const std::any&,
+               std::shared_ptr<Frame>) {});
+        auto expected = expr.evaluate(input, bindings);
+        EXPECT_EQ(expr.evaluate(input), expected) << text;
+        EXPECT_EQ(expr.compile().run(input), expected) << text;
+        auto array = nlohmann::ordered_json::array({input, input});
+        EXPECT_EQ(expr.evaluate(array), expr.evaluate(array, bindings))
+            << text;
+    }
+}
+
+TEST_F(CompileTest, testReportsRuntimeErrors) {
+    Jsonata expr("$undefinedFunction(1)");
+    auto compiled = expr.compile();
+    try {
+        compiled.run(data());
+        FAIL() << "expected T1006";
+    } catch (const JException& e) {
+        EXPECT_EQ(e.getError(), "T1006");
+    }
+}
+
+TEST_F(CompileTest, testSeesBindingsAndRegisteredFunctions) {
+    Jsonata expr("$double(n) + $offset");
+    auto compiled = expr.compile();
+    expr.registerFunction("double", [](const Utils::JList& args) -> std::any {
+        return std::any(Utils::toDouble(args[0]) * 2);
+    });
+    auto bindings = expr.createFrame();
+    bindings->bind("offset", std::any(int64_t(1)));
+    auto result = compiled.run(nlohmann::ordered_json::parse(R"({"n": 20})"),
+                               bindings);
+    EXPECT_EQ(result.get<int64_t>(), 41);
+}
+
+TEST_F(CompileTest, testObserversSeeEveryNode) {
+    Jsonata expr("order.items[price > 1].name");
+    auto compiled = expr.compile();
+    auto bindings = expr.createFrame();
+    int entries = 0;
+    int exits = 0;
+    bindings->setEvaluateEntryCallback(
+        [&](std::shared_ptr<Parser::Symbol>, const std::any&,
+            std::shared_ptr<Frame>) { entries++; });
+    bindings->setEvaluateExitCallback(
+        [&](std::shared_ptr<Parser::Symbol>, const std::any&,
+            std::shared_ptr<Frame>, const std::any&) { exits++; });
+    EXPECT_EQ(compiled.run(data(), bindings), expr.evaluate(data()));
+    EXPECT_GT(entries, 0);
+    EXPECT_EQ(entries, exits);
+
+    // A timebox installed next to the callbacks still bounds recursion
+    bindings->setRuntimeBounds(5000, 10);
+    Jsonata deep(
+        "($f := function($n) { $n = 0 ? 0 : 1 + $f($n - 1) }; $f(50))");
+    try {
+        deep.compile().run(data(), bindings);
+        FAIL() << "expected U1001";
+    } catch (const JException& e) {
+        EXPECT_EQ(e.getError(), "U1001");
+    }
+}
+
+}  // namespace jsonata
@@ -4,6 +4,7 @@
 #include <jsonata/JException.h>
 #include <jsonata/Functions.h>
 #include <vector>
+#include <map>
 #include <memory>
 #include <functional>
 
@@ -60,7 +61,7 @@ TEST_F(CustomFunctionTest, testTernary) {
     Jsonata expression("$abc(a,b,c)");
     JFunction abc;
     abc.signature = std::make_shared<utils::Signature>("<sss:s>", "abc");
-    abc.implementation = [](const Utils::JList& args, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    abc.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
         std::string a = std::any_cast<std::string>(args[0]);
         std::string b = std::any_cast<std::string>(args[1]);
         std::string c = std::any_cast<std::string>(args[2]);
@@ -78,7 +79,7 @@ TEST_F(CustomFunctionTest, testLambdaSignatureError) {
     Jsonata expression("$append(1, 2)");
     // Register JFunction without signature; inside will cast wrongly to force error
     JFunction append;
-    append.implementation = [](const Utils::JList& args, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    append.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
         int a = 0; bool b = false;
         if (!args.empty()) {
             if (args[0].type() == typeid(double)) a = static_cast<int>(std::any_cast<double>(args[0]));
@@ -98,7 +99,7 @@ TEST_F(CustomFunctionTest, testJFunctionSignatureError) {
     Jsonata expression("$append(1, 2)");
     JFunction append;
     append.signature = std::make_shared<utils::Signature>("<nb:s>", "append");
-    append.implementation = [](const Utils::JList& args, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    append.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
         return std::string();
     };
     expression.registerFunction("append", append);
@@ -116,4 +117,166 @@ TEST_F(CustomFunctionTest, testJFunctionSignatureError) {
     }
 }
 
+TEST_F(CustomFunctionTest, testCallSiteContext) {
+    // Functions see the input and bindings in scope where they are called
+    Jsonata expression("items.($x := name; $here())");
+    JFunction here;
+    here.implementation = [](const Utils::JList&, const EvalContext& context) -> std::any {
+        auto obj = std::any_cast<nlohmann::ordered_map<std::string, std::any>>(context.input);
+        return std::any_cast<std::string>(context.environment->lookup("x")) + "=" +
+               std::to_string(Utils::toLong(obj["n"]));
+    };
+    expression.registerFunction("here", here);
+
+    nlohmann::ordered_json data = nlohmann::ordered_json::parse(
+        R"({"items": [{"name": "a", "n": 1}, {"name": "b", "n": 2}]})");
+    auto result = expression.evaluate(data);
+    EXPECT_EQ(result, nlohmann::ordered_json::parse(R"(["a=1", "b=2"])"));
+
+    // $eval evaluates in the caller's context too
+    Jsonata eval("items.($y := n * 10; $eval('name & $y'))");
+    EXPECT_EQ(eval.evaluate(data),
+              nlohmann::ordered_json::parse(R"(["a10", "b20"])"));
+}
+
+TEST_F(CustomFunctionTest, testEscapedFrameOutlivesEvaluation) {
+    // Frames come from a per-evaluation arena; one that escapes the call
+    // keeps the arena alive
+    Jsonata expression("($x := 'kept'; $keep())");
+    std::shared_ptr<Frame> kept;
+    JFunction keep;
+    keep.implementation = [&kept](const Utils::JList&, const EvalContext& context) -> std::any {
+        kept = context.environment;
+        return std::any(true);
+    };
+    expression.registerFunction("keep", keep);
+
+    EXPECT_EQ(expression.evaluate(nullptr), nlohmann::ordered_json(true));
+    ASSERT_NE(kept, nullptr);
+    EXPECT_NE(kept->getArena(), nullptr);
+    EXPECT_EQ(std::any_cast<std::string>(kept->lookup("x")), "kept");
+}
+
+TEST_F(CustomFunctionTest, testEscapedSequenceOutlivesEvaluation) {
+    // Sequences grown during the evaluation come from its arena too; one
+    // that escapes the call keeps the arena alive after its frames are gone
+    Jsonata expression("$keep([1, 2, 3])");
+    std::any kept;
+    JFunction keep;
+    keep.implementation = [&kept](const Utils::JList& args, const EvalContext&) -> std::any {
+        kept = args[0];
+        return std::any(true);
+    };
+    expression.registerFunction("keep", keep);
+
+    EXPECT_EQ(expression.evaluate(nullptr), nlohmann::ordered_json(true));
+    const auto& list = std::any_cast<const Utils::JList&>(kept);
+    EXPECT_TRUE(list.inArena());
+    ASSERT_EQ(list.size(), 3u);
+    EXPECT_EQ(Utils::toLong(list[2]), 3);
+}
+
+TEST_F(CustomFunctionTest, testManyBindings) {
+    // Frames with many bindings index them by slot; rebinding replaces the
+    // value in place and lookups still see the latest one
+    std::string text = "$big0";
+    for (int i = 1; i < 12; i++) {
+        text += " + $big" + std::to_string(i);
+    }
+    Jsonata expression(text);
+    auto bindings = expression.createFrame();
+    for (int i = 0; i < 12; i++) {
+        bindings->bind("big" + std::to_string(i), std::any(int64_t(i)));
+    }
+    bindings->bind("big5", std::any(int64_t(500)));
+    EXPECT_EQ(bindings->getSlots().size(), 12u);
+    EXPECT_EQ(std::any_cast<int64_t>(bindings->lookup("big5")), 500);
+    EXPECT_EQ(expression.evaluate(nullptr, bindings),
+              nlohmann::ordered_json(561));
+    EXPECT_FALSE(bindings->lookup("big12").has_value());
+}
+
+TEST_F(CustomFunctionTest, testBindingsByName) {
+    // Names no expression uses are kept by name instead of being interned,
+    // and are still found once an expression ($eval) uses them
+    Jsonata expression("$eval('$hostOnly7f3a & \"!\"')");
+    auto bindings = expression.createFrame();
+    bindings->bind("hostOnly7f3a", std::any(std::string("kept")));
+    EXPECT_TRUE(bindings->getSlots().empty());
+    EXPECT_EQ(Frame::findSlot("hostOnly7f3a"), Frame::kNoSlot);
+    EXPECT_EQ(std::any_cast<std::string>(bindings->lookup("hostOnly7f3a")),
+              "kept");
+    EXPECT_EQ(bindings->getBindings().size(), 1u);
+    EXPECT_EQ(expression.evaluate(nullptr, bindings),
+              nlohmann::ordered_json("kept!"));
+
+    // Rebinding once the name is interned replaces the binding by name
+    bindings->bind("hostOnly7f3a", std::any(std::string("new")));
+    EXPECT_EQ(bindings->getBindings().size(), 1u);
+    EXPECT_EQ(std::any_cast<std::string>(bindings->lookup("hostOnly7f3a")),
+              "new");
+}
+
+TEST_F(CustomFunctionTest, testFreeVariables) {
+    // Variables the expression never binds are marked for lookup from the
+    // evaluation root; bound ones, including tuple variables, are not
+    Jsonata expression(
+        "($x := 1; $f := function($y) { $x + $y + $count($k) }; "
+        "a#$i.$f($i))");
+    std::map<std::string, bool> free;
+    std::vector<std::shared_ptr<Parser::Symbol>> pending = {expression.expression_};
+    while (!pending.empty()) {
+        auto node = pending.back();
+        pending.pop_back();
+        if (!node) continue;
+        if (node->nodeType() == Parser::NodeType::Variable) {
+            free[std::any_cast<std::string>(node->value)] = node->freeVariable;
+        }
+        for (const auto* list : {&node->expressions, &node->arguments,
+                                 &node->steps}) {
+            pending.insert(pending.end(), list->begin(), list->end());
+        }
+        for (const auto& child : {node->lhs, node->rhs, node->body,
+                                  node->procedure}) {
+            pending.push_back(child);
+        }
+    }
+    EXPECT_TRUE(free.at("count"));
+    EXPECT_TRUE(free.at("k"));
+    EXPECT_FALSE(free.at("x"));
+    EXPECT_FALSE(free.at("y"));
+    EXPECT_FALSE(free.at("f"));
+    EXPECT_FALSE(free.at("i"));
+
+    auto bindings = expression.createFrame();
+    bindings->bind("k", std::any(int64_t(5)));
+    auto data = nlohmann::ordered_json::parse(R"({"a": [{"v": 1}, {"v": 2}]})");
+    EXPECT_EQ(expression.evaluate(data, bindings),
+              nlohmann::ordered_json::parse("[2, 3]"));
+
+    // $eval'd expressions have their own scope and see the caller's frames
+    Jsonata shadowed("($count := function($a) { 'mine' }; $eval('$count([1])'))");
+    EXPECT_EQ(shadowed.evaluate(nullptr), nlohmann::ordered_json("mine"));
+}
+
+TEST_F(CustomFunctionTest, testRuntimeBoundsReplacedAfterChildFrame) {
+    // Child frames look up the observer of their parent on each evaluation,
+    // so replacing the parent's bounds neither leaves them pointing at the
+    // freed timebox nor hides the new bounds from them
+    Jsonata expression("1 + 1");
+    auto env = expression.createFrame();
+    env->setRuntimeBounds(1000, 10);
+    auto child = expression.createFrame(env);
+    env->setRuntimeBounds(2000, 20);
+    EXPECT_EQ(expression.evaluate(nullptr, child), nlohmann::ordered_json(2));
+
+    env->setRuntimeBounds(2000, 0);
+    try {
+        expression.evaluate(nullptr, child);
+        FAIL() << "Expected U1001";
+    } catch (const JException& e) {
+        EXPECT_EQ(e.getError(), "U1001");
+    }
+}
+
 } // namespace jsonata
@@ -29,6 +29,20 @@ bool JsonataTest::testExpr(const std::string& expr,
                           const std::optional<long>& timelimit,
                           const std::optional<int>& depth,
                           bool unordered) {
+    // Every case runs on the tree walker and again through compile()
+    bool walked = testExpr(expr, data, bindings, expected, code, timelimit, depth, unordered, false);
+    bool compiled = testExpr(expr, data, bindings, expected, code, timelimit, depth, unordered, true);
+    return walked && compiled;
+}
+
+bool JsonataTest::testExpr(const std::string& expr,
+                          const nlohmann::ordered_json& data,
+                          const std::map<std::string, nlohmann::ordered_json>& bindings,
+                          const nlohmann::ordered_json& expected,
+                          const std::optional<std::string>& code,
+                          const std::optional<long>& timelimit,
+                          const std::optional<int>& depth,
+                          bool unordered, bool compiled) {
     bool success = true;
     try {
 
@@ -65,7 +79,8 @@ bool JsonataTest::testExpr(const std::string& expr,
         // This allows performance tests to run without artificial limits, matching Java behavior
         
         // Use data directly as JsonValue for the evaluate call
-        auto result = jsonata.evaluate(data, bindingFrame);
+        auto result = compiled ? jsonata.compile().run(data, bindingFrame)
+                               : jsonata.evaluate(data, bindingFrame);
         
         if (code.has_value()) {
             success = false;  // Expected an error but didn't get one
@@ -110,7 +125,7 @@ bool JsonataTest::testExpr(const std::string& expr,
             std::cout << " ErrorCode=" << (code ? *code : "null") << std::endl;
             std::cout << "--Data=" << data.dump() << std::endl;
             std::cout << "--Result = " << result.dump() << std::endl;
-            std::cout << "WRONG RESULT" << std::endl;
+            std::cout << (compiled ? "WRONG RESULT (compiled)" : "WRONG RESULT") << std::endl;
         }
 
     } catch (const std::exception& e) {
@@ -127,7 +142,7 @@ bool JsonataTest::testExpr(const std::string& expr,
             }
 
             std::cout << "--ExpectedError = " << (code ? *code : "null") << " Expected=" << expected.dump() << std::endl;
-            std::cout << "WRONG RESULT (exception)" << std::endl;
+            std::cout << (compiled ? "WRONG RESULT (compiled, exception)" : "WRONG RESULT (exception)") << std::endl;
             success = false;
         }
         if (debug && success) {
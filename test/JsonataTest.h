@@ -42,6 +42,15 @@ private:
                   const std::optional<long>& timelimit = std::nullopt,
                   const std::optional<int>& depth = std::nullopt,
                   bool unordered = false);
+    // One run of a case, on the tree walker or on the compiled program
+    bool testExpr(const std::string& expr,
+                  const nlohmann::ordered_json& data,
+                  const std::map<std::string, nlohmann::ordered_json>& bindings,
+                  const nlohmann::ordered_json& expected,
+                  const std::optional<std::string>& code,
+                  const std::optional<long>& timelimit,
+                  const std::optional<int>& depth,
+                  bool unordered, bool compiled);
 
     nlohmann::ordered_json toJson(const std::string& jsonStr);
     nlohmann::ordered_json readJson(const std::string& name);
@@ -52,4 +52,21 @@ TEST_F(NumberTest, testConst) {
     EXPECT_EQ(static_cast<int>(res.get<double>()), 1);
 }
 
+TEST_F(NumberTest, testIntegersCompareExactly) {
+    // 2^53 + 1 has no double; it still orders above 2^53 and its neighbours
+    auto data = nlohmann::ordered_json::parse(
+        R"({"big": 9007199254740993, "near": 9007199254740992, "half": 2.5, "two": 2})");
+    EXPECT_EQ(Jsonata("big > near").evaluate(data), true);
+    EXPECT_EQ(Jsonata("near < big").evaluate(data), true);
+    EXPECT_EQ(Jsonata("big >= near and big <= near").evaluate(data), false);
+    EXPECT_EQ(Jsonata("two < half and half > two").evaluate(data), true);
+    EXPECT_EQ(Jsonata("two <= 2.0 and two >= 2.0").evaluate(data), true);
+
+    EXPECT_EQ(Jsonata("$sort([big, near, half, two])").evaluate(data),
+              nlohmann::ordered_json::parse("[2, 2.5, 9007199254740992, 9007199254740993]"));
+    EXPECT_EQ(Jsonata("[big, near, half, two]^($)").evaluate(data),
+              nlohmann::ordered_json::parse("[2, 2.5, 9007199254740992, 9007199254740993]"));
+    EXPECT_EQ(Jsonata("$sort([\"b\", \"a\", \"c\"])[0]").evaluate(data), "a");
+}
+
 } // namespace jsonata
@@ -0,0 +1,358 @@
+#include <gtest/gtest.h>
+#include <jsonata/Jsonata.h>
+#include <jsonata/JException.h>
+#include <nlohmann/json.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace jsonata {
+
+class OptimizerTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static nlohmann::ordered_json data() {
+        return nlohmann::ordered_json::parse(R"({
+            "code": "b",
+            "items": [{"n": 1}, {"n": 2}, {"n": 3}]
+        })");
+    }
+
+    using Mark = std::function<bool(Parser::Symbol&)>;
+
+    // True when node or a node beneath it (including filter and stage
+    // expressions) satisfies mark
+    static bool anyNode(const std::shared_ptr<Parser::Symbol>& node,
+                        const Mark& mark) {
+        if (!node) {
+            return false;
+        }
+        if (mark(*node)) {
+            return true;
+        }
+        for (const auto* child :
+             {&node->lhs, &node->rhs, &node->expression, &node->condition,
+              &node->then_expr, &node->else_expr, &node->body,
+              &node->procedure, &node->group}) {
+            if (anyNode(*child, mark)) {
+                return true;
+            }
+        }
+        for (const auto* list : {&node->expressions, &node->arguments,
+                                 &node->steps, &node->terms}) {
+            for (const auto& child : *list) {
+                if (anyNode(child, mark)) {
+                    return true;
+                }
+            }
+        }
+        for (const auto& [key, value] : node->lhsObject) {
+            if (anyNode(key, mark) || anyNode(value, mark)) {
+                return true;
+            }
+        }
+        for (const auto* filters : {&node->predicate, &node->stages}) {
+            for (const auto& filter : *filters) {
+                if (filter &&
+                    filter->expr.type() ==
+                        typeid(std::shared_ptr<Parser::Symbol>) &&
+                    anyNode(std::any_cast<std::shared_ptr<Parser::Symbol>>(
+                                filter->expr),
+                            mark)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static size_t countNodes(const std::shared_ptr<Parser::Symbol>& ast) {
+        size_t count = 0;
+        anyNode(ast, [&count](Parser::Symbol&) {
+            count++;
+            return false;
+        });
+        return count;
+    }
+
+    // The optimizer set mark somewhere in text's AST, which the unoptimized
+    // parse does not have
+    static void expectMarked(const std::string& text, const Mark& mark) {
+        EXPECT_TRUE(anyNode(Jsonata(text).expression_, mark)) << text;
+        EXPECT_FALSE(anyNode(Jsonata(text, false).expression_, mark)) << text;
+    }
+
+    // text gives the same value, or fails with the same error code, with
+    // and without the optimizer
+    static void expectSameAsUnoptimized(const std::string& text,
+                                        const nlohmann::ordered_json& input) {
+        nlohmann::ordered_json expected;
+        std::string expectedError;
+        try {
+            expected = Jsonata(text, false).evaluate(input);
+        } catch (const JException& e) {
+            expectedError = e.getError();
+        }
+        try {
+            auto actual = Jsonata(text).evaluate(input);
+            EXPECT_EQ(expectedError, "") << text;
+            EXPECT_EQ(actual, expected) << text;
+        } catch (const JException& e) {
+            EXPECT_EQ(e.getError(), expectedError) << text;
+        }
+    }
+
+    static bool isInvariant(Parser::Symbol& node) { return node.invariant; }
+};
+
+TEST_F(OptimizerTest, testFoldsConstantSubtrees) {
+    // Folded literals are typed up front: reading kind directly (not
+    // through nodeType()) must not find an unresolved node
+    auto unresolved = [](Parser::Symbol& node) {
+        return node.kind == Parser::NodeType::Unresolved;
+    };
+    Jsonata expr("60 * 60 * 1000");
+    EXPECT_FALSE(anyNode(expr.expression_, unresolved));
+    EXPECT_EQ(expr.expression_->nodeType(), Parser::NodeType::Number);
+    EXPECT_EQ(expr.evaluate(nullptr), nlohmann::ordered_json(3600000));
+
+    Jsonata lookup(R"($lookup({"a": "x" & "y", "b": $uppercase("z")}, code))");
+    EXPECT_FALSE(anyNode(lookup.expression_, unresolved));
+    EXPECT_EQ(lookup.evaluate(data()), nlohmann::ordered_json("Z"));
+
+    Jsonata unoptimized("60 * 60 * 1000", false);
+    EXPECT_EQ(unoptimized.expression_->nodeType(), Parser::NodeType::Binary);
+}
+
+TEST_F(OptimizerTest, testMatchesUnoptimized) {
+    // Folded: the optimized tree is smaller or has a literal at its root
+    const std::vector<std::string> folded = {
+        "[1, 2, [3, 4], [[5]]]",
+        "[[1, 2]]",
+        "[([1, 2]), 3]",
+        "([1, 2]).$string()",
+        "items[1 + 0].n",
+        "items.n[[0, 1]]",
+        "true ? items.n : 'no'",
+        "1 > 2 ? 'yes'",
+        "(1; 'a'; items[0].n)",
+        "(items.n)",
+        "($x := 5; $x * (2 + 3))",
+        "$substring('abcdef', 1 + 1, 2)",
+        "{'k': [1..3]}",
+        "-(2 * 3)",
+        "'a' & null",
+        "['x', 'y'] ~> $join(', ')",
+        "code ~> $append(['z'])",
+    };
+    for (const auto& text : folded) {
+        auto optimized = Jsonata(text).expression_;
+        auto unoptimized = Jsonata(text, false).expression_;
+        EXPECT_TRUE(countNodes(optimized) < countNodes(unoptimized) ||
+                    optimized->nodeType() != unoptimized->nodeType())
+            << text;
+        expectSameAsUnoptimized(text, data());
+    }
+
+    // Left alone: failing, impure or rebound calls and bound variables
+    const std::vector<std::string> unchanged = {
+        "$string()",
+        "items.$string()",
+        "($uppercase := function($s) { $s & '!' }; $uppercase('abc'))",
+        "1 / 0",
+        "$count($millis()) + 1",
+        "items[n > $x].n",
+        "($y := 1; items[n > $y + 1].n)",
+    };
+    for (const auto& text : unchanged) {
+        EXPECT_EQ(countNodes(Jsonata(text).expression_),
+                  countNodes(Jsonata(text, false).expression_))
+            << text;
+        EXPECT_FALSE(anyNode(Jsonata(text).expression_, isInvariant)) << text;
+        expectSameAsUnoptimized(text, data());
+    }
+
+    // Invariant subexpressions inside steps, filters and lambda bodies
+    const std::vector<std::string> invariant = {
+        "items[n >= $average($$.items.n)].n",
+        "items.(n + $count($$.items) * 2)",
+        "items.{'n': n, 'all': $sum($$.items.n)}",
+        "items.$map([1, 2], function($v) { $v + $count($$.items) })",
+        "items[$string() = $string($$.code)]",
+    };
+    for (const auto& text : invariant) {
+        expectMarked(text, isInvariant);
+        expectSameAsUnoptimized(text, data());
+    }
+}
+
+TEST_F(OptimizerTest, testOptimizesAroundParentAndTupleBindings) {
+    // Only the subtrees using % are left alone, and @$x / #$i bind
+    // variables like := does
+    const std::vector<std::string> invariant = {
+        "{'big': items[n >= $average($$.items.n)].n, 'codes': items.n.%.%.code}",
+        "items#$i[n >= $average($$.items.n)].($i)",
+        "items#$i.($i + $count($$.items))",
+        "items@$v.($v.n * $count($$.items))",
+        "items.{'n': n, 'up': %.code & $string($count($$.items))}",
+    };
+    for (const auto& text : invariant) {
+        expectMarked(text, isInvariant);
+        expectSameAsUnoptimized(text, data());
+    }
+
+    // Tuple variables are never invariant themselves
+    Jsonata indexed("items#$i.($i + $count($$.items))");
+    EXPECT_FALSE(anyNode(indexed.expression_, [](Parser::Symbol& node) {
+        return node.invariant && node.lhs &&
+               node.lhs->nodeType() == Parser::NodeType::Variable;
+    }));
+    // Nor is anything that reads the parent, though its other operand is
+    Jsonata parent("items.(%.code & $count($$.items))");
+    EXPECT_TRUE(anyNode(parent.expression_, isInvariant));
+    EXPECT_FALSE(anyNode(parent.expression_, [](Parser::Symbol& node) {
+        return node.invariant &&
+               node.nodeType() == Parser::NodeType::Binary;
+    }));
+    expectSameAsUnoptimized("items.(%.code & $count($$.items))", data());
+
+    auto orders = nlohmann::ordered_json::parse(R"({
+        "customers": [{"id": 1, "name": "a"}, {"id": 2, "name": "b"}],
+        "orders": [{"customerId": 2}, {"customerId": 1}, {"customerId": 3}]
+    })");
+    const std::string join =
+        "orders#$i.($o := $; $$.customers[id = $o.customerId].($i & name))";
+    expectMarked(join, [](Parser::Symbol& node) { return !!node.join; });
+    expectSameAsUnoptimized(join, orders);
+}
+
+TEST_F(OptimizerTest, testRebindingBuiltinsBypassesFoldedCalls) {
+    Jsonata expr("$uppercase('abc') & '!'");
+    EXPECT_EQ(expr.evaluate(nullptr), nlohmann::ordered_json("ABC!"));
+
+    JFunction same;
+    same.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
+        return args[0];
+    };
+    auto bindings = expr.createFrame();
+    bindings->bind("uppercase", std::any(same));
+    EXPECT_EQ(expr.evaluate(nullptr, bindings), nlohmann::ordered_json("abc!"));
+
+    expr.registerFunction("uppercase", same);
+    EXPECT_EQ(expr.evaluate(nullptr), nlohmann::ordered_json("abc!"));
+}
+
+TEST_F(OptimizerTest, testEvaluatesInvariantsOncePerEvaluation) {
+    Jsonata expr("items[n >= $average($$.items.n)].n");
+    auto bindings = expr.createFrame();
+    int invariantEntries = 0;
+    bindings->setEvaluateEntryCallback(
+        [&](std::shared_ptr<Parser::Symbol> node, const std::any&,
+            std::shared_ptr<Frame>) {
+            invariantEntries += node->invariant ? 1 : 0;
+        });
+    auto expected = nlohmann::ordered_json::parse("[2, 3]");
+    EXPECT_EQ(expr.evaluate(data(), bindings), expected);
+    EXPECT_EQ(invariantEntries, 1);
+    EXPECT_EQ(expr.evaluate(data(), bindings), expected);
+    EXPECT_EQ(invariantEntries, 2);
+
+    // A rebound builtin is called for every item again
+    JFunction first;
+    first.implementation = [](const Utils::JList& args,
+                              const EvalContext&) -> std::any {
+        return Utils::arrayify(args[0])[0];
+    };
+    bindings->bind("average", std::any(first));
+    invariantEntries = 0;
+    EXPECT_EQ(expr.evaluate(data(), bindings),
+              nlohmann::ordered_json::parse("[1, 2, 3]"));
+    EXPECT_EQ(invariantEntries, 3);
+}
+
+TEST_F(OptimizerTest, testJoinsOnFieldEquality) {
+    auto input = nlohmann::ordered_json::parse(R"({
+        "customers": [{"id": 1, "name": "a"}, {"id": 2.0, "name": "b"},
+                      {"id": "1", "name": "c"}, {"id": 2, "name": "d"},
+                      {"name": "e"}, [{"id": 1, "name": "f"}]],
+        "orders": [{"customerId": 2}, {"customerId": 1}, {"customerId": 3},
+                   {"customerId": "1"}, {"customerId": null}, {}]
+    })");
+    auto flat = input;
+    flat["customers"].erase(5);
+
+    const std::vector<std::string> expressions = {
+        "orders.($o := $; $$.customers[id = $o.customerId].name)",
+        "orders.($k := customerId; $$.customers[$k = id])",
+        "$map(orders, function($o) { $$.customers[id = $o.customerId].name })",
+        "orders.($o := $; $count($$.customers[id = $o.customerId]))",
+    };
+    // The join sits on a path inside the block of every order
+    for (const auto& text : expressions) {
+        expectMarked(text, [](Parser::Symbol& node) { return !!node.join; });
+        expectSameAsUnoptimized(text, input);
+        expectSameAsUnoptimized(text, flat);
+    }
+}
+
+TEST_F(OptimizerTest, testAccumulatesGroupAggregates) {
+    auto input = nlohmann::ordered_json::parse(R"({"events": [
+        {"c": "b", "n": 1}, {"c": "a", "n": [2, 3.5]}, {"c": "b", "n": 4},
+        {"c": "a"}, {"c": "d", "n": []}, {"c": "b", "n": -2}, {"n": 7}
+    ]})");
+    Jsonata sums("events{c: $sum(n)}");
+    ASSERT_TRUE(sums.expression_->group);
+    EXPECT_TRUE(sums.expression_->group->aggregates);
+    EXPECT_EQ(sums.evaluate(input),
+              nlohmann::ordered_json::parse(R"({"b": 3, "a": 5.5})"));
+
+    const std::vector<std::string> expressions = {
+        "events{c: $count($)}",
+        "events{c: $count(n)}",
+        "events{c: $max(n), 'all': $min(n)}",
+        "events{c: $average(n)}",
+        "events{c: $sum(n)}",
+        "events.n{'x': $sum($)}",
+        "events{c: $sum(c)}",
+        "events{c: $sum(n), 'a': $count($)}",
+        "[]{'x': $count($)}",
+        "[[1, 2], 3]{'x': $sum($)}",
+    };
+    for (const auto& text : expressions) {
+        expectMarked(text,
+                     [](Parser::Symbol& node) { return node.aggregates; });
+        expectSameAsUnoptimized(text, input);
+    }
+}
+
+TEST_F(OptimizerTest, testLooksUpIncludesInHashIndex) {
+    auto input = nlohmann::ordered_json::parse(R"({
+        "wanted": [1, 2.5, "b", null, true, {"x": 1, "y": [2]}, [3, 4], -0.0,
+                   "c", "d", "e", "f"],
+        "items": [1, 1.0, "1", 2.5, "b", null, false, true, {"y": [2], "x": 1},
+                  {"x": 1}, [3, 4], [4, 3], 0, "g"]
+    })");
+    // The right-hand side is invariant within the filter
+    Jsonata lookup("items[$ in $$.wanted]");
+    const auto& stages = lookup.expression_->steps[0]->stages;
+    ASSERT_EQ(stages.size(), 1u);
+    auto in = std::any_cast<std::shared_ptr<Parser::Symbol>>(stages[0]->expr);
+    EXPECT_TRUE(in->rhs->invariant);
+    EXPECT_EQ(lookup.evaluate(input),
+              Jsonata("items[$ in $$.wanted]", false).evaluate(input));
+
+    const std::vector<std::string> expressions = {
+        "items.($ in $$.wanted)",
+        "items.($ in $$.wanted[[0..1]])",
+        "items[$ in $$.wanted.y]",
+        "$map(items, function($v) { $v in $$.wanted })",
+    };
+    for (const auto& text : expressions) {
+        expectMarked(text, isInvariant);
+        expectSameAsUnoptimized(text, input);
+    }
+}
+
+}  // namespace jsonata
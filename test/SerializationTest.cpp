@@ -25,7 +25,7 @@ protected:
             expression = expr;
             jsonata = std::make_unique<Jsonata>(expr);
             JFunction hi;
-            hi.implementation = [](const Utils::JList&, const std::any&, std::shared_ptr<Frame>) -> std::any {
+            hi.implementation = [](const Utils::JList&, const EvalContext&) -> std::any {
                 return std::string("hello world");
             };
             jsonata->registerFunction("hi", hi);
@@ -39,7 +39,7 @@ protected:
 TEST_F(SerializationTest, testJFunction) {
     Jsonata expr("$foo");
     JFunction foo;
-    foo.implementation = [](const Utils::JList&, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    foo.implementation = [](const Utils::JList&, const EvalContext&) -> std::any {
         return std::any{};
     };
     expr.registerFunction("foo", foo);
@@ -25,7 +25,7 @@ TEST_F(SignatureTest, testParametersAreConvertedToArrays) {
 
     JFunction greetFn;
     greetFn.signature = std::make_shared<utils::Signature>("<a?a?a?a?>", "greet");
-    greetFn.implementation = [](const Utils::JList& args, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    greetFn.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
         auto formatOne = [](const std::any& a) -> std::string {
             if (a.type() == typeid(Utils::JList)) {
                 const auto& arr = std::any_cast<Utils::JList>(a);
@@ -61,7 +61,7 @@ TEST_F(SignatureTest, testError) {
 
     JFunction fooFn;
     fooFn.signature = std::make_shared<utils::Signature>("(sao)", "foo");
-    fooFn.implementation = [](const Utils::JList&, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    fooFn.implementation = [](const Utils::JList&, const EvalContext&) -> std::any {
         return std::any{};
     };
     expr.registerFunction("foo", fooFn);
@@ -75,7 +75,7 @@ TEST_F(SignatureTest, testVarArg) {
 
     JFunction sumFn;
     sumFn.signature = std::make_shared<utils::Signature>("<n+:n>", "sumvar");
-    sumFn.implementation = [](const Utils::JList& args, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    sumFn.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
         long long sum = 0;
         for (const auto& a : args) {
             if (!a.has_value()) continue;
@@ -98,7 +98,7 @@ TEST_F(SignatureTest, testVarArgMany) {
 
     JFunction customArgsFn;
     customArgsFn.signature = std::make_shared<utils::Signature>("<sa<n>n:s>", "customArgs");
-    customArgsFn.implementation = [](const Utils::JList& args, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    customArgsFn.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
         std::string out = "[";
         for (size_t i = 0; i < args.size(); ++i) {
             if (i > 0) out += ", ";
@@ -45,7 +45,7 @@ TEST_F(ThreadTest, testReuseWithVariable) {
     Jsonata expr("($x := a; $wait(a); $x)");
 
     JFunction waitFn;
-    waitFn.implementation = [](const Utils::JList& args, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    waitFn.implementation = [](const Utils::JList& args, const EvalContext&) -> std::any {
         int sleepMs = 0;
         if (!args.empty() && args[0].has_value()) {
             if (args[0].type() == typeid(double)) sleepMs = static_cast<int>(std::any_cast<double>(args[0]));
@@ -104,4 +104,54 @@ TEST_F(ThreadTest, testAddEnvAndInput) {
     EXPECT_EQ(sum, 2 * count);
 }
 
+TEST_F(ThreadTest, testParallelSortKeepsTies) {
+    // Enough items for the parallel branch, with few distinct keys so that
+    // most comparisons are ties, which must keep their input order
+    const int count = 70000;
+    nlohmann::ordered_json items = nlohmann::ordered_json::array();
+    for (int i = 0; i < count; i++) {
+        items.push_back({{"k", (i * 7919) % 5}, {"i", i}});
+    }
+    nlohmann::ordered_json data = {{"items", items}};
+
+    Jsonata expr("items^(k).i");
+    auto sequential = expr.evaluate(data);
+
+    std::atomic<int> batches{0};
+    std::atomic<int> tasks{0};
+    expr.setSortExecutor(
+        [&](const std::vector<std::function<void()>>& batch) {
+            batches++;
+            std::vector<std::thread> threads;
+            for (const auto& task : batch) {
+                tasks++;
+                threads.emplace_back(task);
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        },
+        4);
+    auto parallel = expr.evaluate(data);
+
+    // 4 chunk sorts, then merges of 2 and 1
+    EXPECT_EQ(batches.load(), 3);
+    EXPECT_EQ(tasks.load(), 7);
+    EXPECT_EQ(parallel, sequential);
+    ASSERT_EQ(parallel.size(), static_cast<size_t>(count));
+    for (size_t n = 1; n < parallel.size(); n++) {
+        int prev = parallel[n - 1].get<int>();
+        int cur = parallel[n].get<int>();
+        int prevKey = (prev * 7919) % 5;
+        int curKey = (cur * 7919) % 5;
+        ASSERT_TRUE(prevKey < curKey || (prevKey == curKey && prev < cur))
+            << "at " << n;
+    }
+
+    // Without workers every sort runs on the evaluating thread
+    expr.setSortExecutor(nullptr, 0);
+    EXPECT_EQ(expr.evaluate(data), sequential);
+    EXPECT_EQ(batches.load(), 3);
+}
+
 } // namespace jsonata
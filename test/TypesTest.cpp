@@ -139,7 +139,7 @@ TEST_F(TypesTest, testJacksonConversion) {
 TEST_F(TypesTest, testCustomFunction) {
     Jsonata fn("$foo()");
     JFunction jfn;
-    jfn.implementation = [](const Utils::JList&, const std::any&, std::shared_ptr<Frame>) -> std::any {
+    jfn.implementation = [](const Utils::JList&, const EvalContext&) -> std::any {
         nlohmann::ordered_json obj = {{"c", "c"}};
         return obj;
     };